@@ -0,0 +1,49 @@
+#include <cstdint>
+#include <mutex>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/adaptive_mutex.h>
+#include <csg/core/mcs_lock.h>
+
+using namespace csg;
+
+// Measures the throughput of critical sections of a few nanoseconds and of
+// about a hundred, under an adaptive_mutex, which spins while the owner runs
+// and sleeps otherwise, a std::mutex, which sleeps as soon as it finds the
+// lock held, and an mcs_lock, which always spins.
+
+namespace {
+
+template <typename Lock>
+struct shared {
+  Lock lock;
+  std::uint64_t counter = 0;
+};
+
+template <typename Lock>
+shared<Lock> &get_shared() {
+  static shared<Lock> s;
+  return s;
+}
+
+} // End of anonymous namespace
+
+template <typename Lock>
+static void BM_lock(benchmark::State &state) {
+  shared<Lock> &s = get_shared<Lock>();
+  const std::int64_t work = state.range(0);
+  for (auto _ : state) {
+    const std::lock_guard guard{s.lock};
+    for (std::int64_t i = 0; i < work; ++i)
+      benchmark::DoNotOptimize(++s.counter);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_lock, adaptive_mutex)
+    ->Arg(1)->Arg(64)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_lock, std::mutex)
+    ->Arg(1)->Arg(64)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_lock, mcs_lock)
+    ->Arg(1)->Arg(64)->ThreadRange(1, 16);
+
+BENCHMARK_MAIN();
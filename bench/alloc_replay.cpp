@@ -0,0 +1,335 @@
+//==-- alloc_replay.cpp - replay allocation traces against resources -----==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+// Replays an allocation trace recorded by csg::trace_resource against one or
+// more std::pmr::memory_resource implementations, and reports:
+//
+//   - throughput, in allocate/deallocate operations per second
+//   - the peak increase in resident set size (RSS) during the replay
+//   - fragmentation, computed as 1 - (peak live bytes / peak RSS increase)
+//
+// Usage:
+//
+//   alloc_replay [--resource=<name>]... [--no-touch] <trace-file>
+//
+// where <name> is one of the resources listed by `alloc_replay --help`. If no
+// resource is named, all of them are measured. Unless --no-touch is given,
+// one byte of every page of each allocation is written, as a real program
+// would, so that the memory counts towards the RSS.
+//
+// Each measurement runs in its own child process, so that memory retained by
+// one resource (or by the C library) does not distort the next measurement.
+// The trace is replayed in timestamp order by a single thread; allocations
+// whose deallocation precedes the start of the trace are ignored.
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <csg/core/alloc_trace.h>
+#include <csg/core/malloc_type.h>
+
+namespace {
+
+struct replay_op {
+  std::uint32_t slot;
+  bool allocate;
+  std::size_t size;
+  std::size_t align;
+};
+
+struct replay_trace {
+  std::vector<replay_op> ops;
+  std::size_t slots = 0;
+  std::size_t threads = 0;
+  std::size_t peakLiveBytes = 0;
+};
+
+struct resource_factory {
+  const char *name;
+  std::function<std::unique_ptr<std::pmr::memory_resource>()> create;
+};
+
+// Non-owning wrapper so that the process-wide resources can be returned
+// from a factory like any other.
+class forwarding_resource : public std::pmr::memory_resource {
+public:
+  explicit forwarding_resource(std::pmr::memory_resource *r) : m_r{r} {}
+
+private:
+  void *do_allocate(std::size_t b, std::size_t a) override {
+    return m_r->allocate(b, a);
+  }
+
+  void do_deallocate(void *p, std::size_t b, std::size_t a) override {
+    m_r->deallocate(p, b, a);
+  }
+
+  bool do_is_equal(const memory_resource &o) const noexcept override {
+    return this == &o;
+  }
+
+  std::pmr::memory_resource *m_r;
+};
+
+const std::vector<resource_factory> &resources() {
+  static const std::vector<resource_factory> r{
+    {"new_delete", [] {
+      return std::make_unique<forwarding_resource>(
+          std::pmr::new_delete_resource());
+    }},
+    {"unsync_pool", [] {
+      return std::make_unique<std::pmr::unsynchronized_pool_resource>();
+    }},
+    {"sync_pool", [] {
+      return std::make_unique<std::pmr::synchronized_pool_resource>();
+    }},
+    {"monotonic", [] {
+      return std::make_unique<std::pmr::monotonic_buffer_resource>();
+    }},
+    {"malloc_type", [] {
+      // Measures the cost of accounting, on top of new_delete.
+      static csg::malloc_type type{"alloc_replay"};
+      return std::make_unique<csg::malloc_type_resource>(type);
+    }},
+  };
+  return r;
+}
+
+// Convert the trace's addresses into dense slot numbers, so that the replay
+// loop indexes an array rather than probing a hash table.
+replay_trace prepare(const std::vector<csg::alloc_trace_event> &events) {
+  replay_trace t;
+  std::unordered_map<std::uint64_t, std::uint32_t> live;
+  std::vector<std::uint32_t> freeSlots;
+  std::size_t liveBytes = 0;
+
+  t.ops.reserve(events.size());
+
+  for (const auto &e : events) {
+    t.threads = std::max<std::size_t>(t.threads, e.thread() + 1u);
+
+    if (e.kind() == csg::alloc_trace_kind::allocate) {
+      std::uint32_t slot;
+      if (freeSlots.empty())
+        slot = static_cast<std::uint32_t>(t.slots++);
+      else {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+      }
+
+      live[e.address] = slot;
+      t.ops.push_back({slot, true, e.size(), e.alignment()});
+      liveBytes += e.size();
+      t.peakLiveBytes = std::max(t.peakLiveBytes, liveBytes);
+    }
+    else if (const auto i = live.find(e.address); i != live.end()) {
+      t.ops.push_back({i->second, false, e.size(), e.alignment()});
+      freeSlots.push_back(i->second);
+      live.erase(i);
+      liveBytes -= e.size();
+    }
+  }
+
+  return t;
+}
+
+std::size_t current_rss() {
+  std::FILE *const f = std::fopen("/proc/self/statm", "r");
+  unsigned long pages = 0, resident = 0;
+  if (f) {
+    if (std::fscanf(f, "%lu %lu", &pages, &resident) != 2)
+      resident = 0;
+    std::fclose(f);
+  }
+  return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+struct replay_result {
+  double seconds;
+  std::size_t peakRssDelta;
+};
+
+// Replays the trace; if `sampleRss` is true the RSS is sampled periodically
+// (which perturbs the timing, so throughput is measured in a separate run).
+replay_result replay(const replay_trace &t, std::pmr::memory_resource &r,
+                     bool touch, bool sampleRss) {
+  constexpr std::size_t SampleInterval = 4096;
+  const std::size_t pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  std::vector<void *> slots(t.slots);
+
+  const std::size_t baseRss = sampleRss ? current_rss() : 0;
+  std::size_t peakRss = baseRss;
+
+  const auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t n = 0; n < t.ops.size(); ++n) {
+    const replay_op &op = t.ops[n];
+
+    if (op.allocate) {
+      auto *const p = static_cast<volatile char *>(r.allocate(op.size, op.align));
+      if (touch) {
+        for (std::size_t off = 0; off < op.size; off += pageSize)
+          p[off] = 0;
+      }
+      slots[op.slot] = const_cast<char *>(p);
+    }
+    else
+      r.deallocate(slots[op.slot], op.size, op.align);
+
+    if (sampleRss && n % SampleInterval == 0)
+      peakRss = std::max(peakRss, current_rss());
+  }
+
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  if (sampleRss)
+    peakRss = std::max(peakRss, current_rss());
+
+  return {std::chrono::duration<double>(elapsed).count(), peakRss - baseRss};
+}
+
+// Run `fn` in a child process, which writes its result to a pipe.
+template <typename Fn>
+bool run_isolated(Fn fn, replay_result &result) {
+  int fds[2];
+  if (::pipe(fds) == -1)
+    return false;
+
+  const pid_t pid = ::fork();
+  if (pid == -1)
+    return false;
+
+  if (pid == 0) {
+    ::close(fds[0]);
+    const replay_result r = fn();
+    const bool ok = ::write(fds[1], &r, sizeof r) == sizeof r;
+    std::_Exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+  }
+
+  ::close(fds[1]);
+  const bool ok = ::read(fds[0], &result, sizeof result) == sizeof result;
+  ::close(fds[0]);
+
+  int status;
+  ::waitpid(pid, &status, 0);
+  return ok && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+void usage(std::FILE *out) {
+  std::fprintf(out, "usage: alloc_replay [--resource=<name>]... [--no-touch] "
+                    "<trace-file>\n\nresources:");
+  for (const auto &r : resources())
+    std::fprintf(out, " %s", r.name);
+  std::fprintf(out, "\n");
+}
+
+} // End of anonymous namespace
+
+int main(int argc, char **argv) {
+  std::vector<const resource_factory *> selected;
+  const char *path = nullptr;
+  bool touch = true;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg{argv[i]};
+
+    if (arg == "--help" || arg == "-h") {
+      usage(stdout);
+      return EXIT_SUCCESS;
+    }
+    else if (arg == "--no-touch")
+      touch = false;
+    else if (arg.starts_with("--resource=")) {
+      const auto name = arg.substr(std::strlen("--resource="));
+      const auto &all = resources();
+      const auto r = std::ranges::find(all, name, &resource_factory::name);
+      if (r == all.end()) {
+        std::fprintf(stderr, "unknown resource: %.*s\n",
+                     static_cast<int>(name.size()), name.data());
+        return EXIT_FAILURE;
+      }
+      selected.push_back(&*r);
+    }
+    else if (!path && !arg.starts_with("-"))
+      path = argv[i];
+    else {
+      usage(stderr);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!path) {
+    usage(stderr);
+    return EXIT_FAILURE;
+  }
+
+  if (selected.empty()) {
+    for (const auto &r : resources())
+      selected.push_back(&r);
+  }
+
+  replay_trace trace;
+  try {
+    trace = prepare(csg::read_alloc_trace(path));
+  }
+  catch (const std::exception &e) {
+    std::fprintf(stderr, "alloc_replay: %s\n", e.what());
+    return EXIT_FAILURE;
+  }
+
+  std::printf("trace: %zu operations, %zu threads, peak live %zu bytes\n\n",
+              trace.ops.size(), trace.threads, trace.peakLiveBytes);
+  std::printf("%-16s %14s %16s %14s\n", "resource", "Mops/s",
+              "peak RSS (KiB)", "fragmentation");
+
+  for (const resource_factory *f : selected) {
+    replay_result timing, memory;
+
+    const bool ok =
+        run_isolated([&] {
+          const auto r = f->create();
+          return replay(trace, *r, touch, false);
+        }, timing) &&
+        run_isolated([&] {
+          const auto r = f->create();
+          return replay(trace, *r, touch, true);
+        }, memory);
+
+    if (!ok) {
+      std::printf("%-16s %14s\n", f->name, "(failed)");
+      continue;
+    }
+
+    const double mops = timing.seconds > 0
+        ? static_cast<double>(trace.ops.size()) / timing.seconds / 1e6 : 0;
+    const double frag = memory.peakRssDelta
+        ? std::max(0.0, 1.0 - static_cast<double>(trace.peakLiveBytes) /
+                            static_cast<double>(memory.peakRssDelta))
+        : 0;
+
+    std::printf("%-16s %14.2f %16zu %13.1f%%\n", f->name, mops,
+                memory.peakRssDelta / 1024, frag * 100);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/alloc_trace.h>
+
+using namespace csg;
+
+// Measures the cost that trace_resource adds to each allocate/deallocate
+// pair. The trace is written to /dev/null so that only the recording cost
+// (timestamp, buffer store, and the amortized buffer write) is measured.
+
+namespace {
+
+template <typename Resource>
+void alloc_free_batch(benchmark::State &state, Resource &r) {
+  std::vector<void *> ptrs(static_cast<std::size_t>(state.range(0)));
+
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < ptrs.size(); ++i)
+      ptrs[i] = r.allocate(16 + (i % 32) * 8, alignof(std::max_align_t));
+    for (std::size_t i = 0; i < ptrs.size(); ++i)
+      r.deallocate(ptrs[i], 16 + (i % 32) * 8, alignof(std::max_align_t));
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(0) * 2);
+}
+
+} // End of anonymous namespace
+
+static void BM_untraced(benchmark::State &state) {
+  std::pmr::unsynchronized_pool_resource r;
+  alloc_free_batch(state, r);
+}
+BENCHMARK(BM_untraced)->Arg(1024);
+
+static void BM_traced(benchmark::State &state) {
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> devNull{
+      std::fopen("/dev/null", "wb"), &std::fclose};
+  std::pmr::unsynchronized_pool_resource upstream;
+  alloc_trace_log log{devNull.get()};
+  trace_resource r{log, &upstream};
+  alloc_free_batch(state, r);
+}
+BENCHMARK(BM_traced)->Arg(1024);
+
+BENCHMARK_MAIN();
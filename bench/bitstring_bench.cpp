@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/bitstring.h>
+
+using namespace csg;
+
+// The benchmarks model an allocation bitmap, where a set bit means "in use".
+// A "dense" bitmap is almost full, so searching for free space (clear bits)
+// must skip over long runs of set bits. A "sparse" bitmap is almost empty, so
+// the same is true when searching for allocated (set) bits.
+
+namespace {
+
+// Every `period` bits, a single bit differs from the background value.
+bitstring make_bitmap(std::size_t nbits, bool dense, std::size_t period) {
+  bitstring b{nbits};
+  if (dense)
+    b.set_all();
+
+  std::mt19937_64 gen{nbits};
+  std::uniform_int_distribution<std::size_t> jitter{0, period / 2};
+
+  for (std::size_t i = period / 2; i < nbits; i += period) {
+    const std::size_t bit = std::min(i + jitter(gen), nbits - 1);
+    dense ? b.clear(bit) : b.set(bit);
+  }
+
+  return b;
+}
+
+// Word-at-a-time scan with std::countr_zero; this is what a straightforward
+// port of the BSD macros would do, and is the baseline for the vector scans.
+template <bool Clear>
+std::ptrdiff_t scalar_find_at(const bitstring &b, std::size_t start) {
+  const auto words = b.words();
+  constexpr std::uint64_t Flip = Clear ? ~std::uint64_t{0} : 0;
+  std::size_t i = start / 64;
+  std::uint64_t w = (words[i] ^ Flip) & (~std::uint64_t{0} << (start % 64));
+
+  while (!w) {
+    if (++i == words.size())
+      return bitstring::not_found;
+    w = words[i] ^ Flip;
+  }
+
+  const std::size_t bit = i * 64 + std::countr_zero(w);
+  return bit < b.size() ? static_cast<std::ptrdiff_t>(bit)
+                        : bitstring::not_found;
+}
+
+void args(benchmark::internal::Benchmark *b) {
+  for (const std::int64_t nbits : { 1 << 20, 1 << 24 })
+    for (const std::int64_t period : { 4096, 65536 })
+      b->Args({nbits, period});
+}
+
+} // End of anonymous namespace
+
+template <bool Dense, bool Scalar>
+static void BM_find_all(benchmark::State &state) {
+  // Visit every "interesting" bit in the bitmap, i.e., every clear bit in a
+  // dense bitmap or every set bit in a sparse one.
+  const auto b = make_bitmap(state.range(0), Dense, state.range(1));
+
+  for (auto _ : state) {
+    std::size_t found = 0;
+    std::ptrdiff_t bit = -1;
+
+    while (true) {
+      const std::size_t start = static_cast<std::size_t>(bit + 1);
+      if (start >= b.size())
+        break;
+      if constexpr (Scalar)
+        bit = scalar_find_at<Dense>(b, start);
+      else
+        bit = Dense ? b.ffc_at(start) : b.ffs_at(start);
+      if (bit == bitstring::not_found)
+        break;
+      ++found;
+    }
+
+    benchmark::DoNotOptimize(found);
+  }
+
+  state.SetBytesProcessed(state.iterations() * (state.range(0) / 8));
+}
+
+BENCHMARK_TEMPLATE(BM_find_all, true, false)->Name("ffc_dense")->Apply(args);
+BENCHMARK_TEMPLATE(BM_find_all, true, true)->Name("ffc_dense_scalar")->Apply(args);
+BENCHMARK_TEMPLATE(BM_find_all, false, false)->Name("ffs_sparse")->Apply(args);
+BENCHMARK_TEMPLATE(BM_find_all, false, true)->Name("ffs_sparse_scalar")->Apply(args);
+
+static void BM_ffc_area_dense(benchmark::State &state) {
+  // Search a dense bitmap for a free run longer than any that exists, which
+  // is the worst case for an allocator: every hole is examined.
+  const auto b = make_bitmap(state.range(0), true, state.range(1));
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(b.ffc_area(2));
+
+  state.SetBytesProcessed(state.iterations() * (state.range(0) / 8));
+}
+BENCHMARK(BM_ffc_area_dense)->Apply(args);
+
+static void BM_ffc_area_sparse(benchmark::State &state) {
+  // Search a sparse bitmap for a free run longer than the gaps between set
+  // bits, which must be found by skipping most of the bitmap.
+  const auto b = make_bitmap(state.range(0), false, state.range(1));
+  const auto n = static_cast<std::size_t>(state.range(1)) * 2;
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(b.ffc_area(n));
+
+  state.SetBytesProcessed(state.iterations() * (state.range(0) / 8));
+}
+BENCHMARK(BM_ffc_area_sparse)->Apply(args);
+
+static void BM_count(benchmark::State &state) {
+  const auto b = make_bitmap(state.range(0), true, state.range(1));
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(b.count());
+
+  state.SetBytesProcessed(state.iterations() * (state.range(0) / 8));
+}
+BENCHMARK(BM_count)->Apply(args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,106 @@
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/buf_ring.h>
+#include <csg/core/stailq.h>
+
+using namespace csg;
+
+// Hand packets from N producer threads to one consumer thread, through a
+// buf_ring or through the mutex-protected stailq that it replaces. Each
+// iteration moves Packets packets; items_per_second is the packet rate.
+
+namespace {
+
+constexpr std::size_t Packets = 1 << 16;
+
+struct packet {
+  stailq_entry<packet> next;
+  std::uint64_t payload;
+};
+
+using packet_queue = CSG_STAILQ_HEAD_OFFSET_T(packet, next);
+
+// Split the packets among the producers, run them, and consume all packets
+// on the calling thread.
+template <typename Enqueue, typename Dequeue>
+void run_pipeline(std::vector<packet> &packets, std::size_t producers,
+                  Enqueue enqueue, Dequeue dequeue) {
+  std::vector<std::thread> threads;
+  const std::size_t share = packets.size() / producers;
+
+  for (std::size_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      for (std::size_t i = p * share; i < (p + 1) * share; ++i) {
+        while (!enqueue(&packets[i]))
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  std::uint64_t sum = 0;
+  for (std::size_t n = 0; n < producers * share;) {
+    if (packet *const p = dequeue()) {
+      sum += p->payload;
+      ++n;
+    }
+    else
+      std::this_thread::yield();
+  }
+  benchmark::DoNotOptimize(sum);
+
+  for (auto &t : threads)
+    t.join();
+}
+
+} // End of anonymous namespace
+
+static void BM_buf_ring(benchmark::State &state) {
+  const auto producers = static_cast<std::size_t>(state.range(0));
+  std::vector<packet> packets(Packets);
+  buf_ring<packet *> ring{1024};
+
+  for (auto _ : state) {
+    run_pipeline(packets, producers,
+                 [&ring](packet *p) { return ring.enqueue(p); },
+                 [&ring] { return ring.dequeue_sc(); });
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(Packets));
+}
+BENCHMARK(BM_buf_ring)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+static void BM_mutex_stailq(benchmark::State &state) {
+  const auto producers = static_cast<std::size_t>(state.range(0));
+  std::vector<packet> packets(Packets);
+  std::mutex mutex;
+  packet_queue queue;
+
+  for (auto _ : state) {
+    run_pipeline(packets, producers,
+                 [&](packet *p) {
+                   const std::lock_guard lock{mutex};
+                   queue.push_back(p);
+                   return true;
+                 },
+                 [&]() -> packet * {
+                   const std::lock_guard lock{mutex};
+                   if (queue.empty())
+                     return nullptr;
+                   packet *const p = &queue.front();
+                   queue.pop_front();
+                   return p;
+                 });
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(Packets));
+}
+BENCHMARK(BM_mutex_stailq)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
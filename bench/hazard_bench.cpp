@@ -0,0 +1,57 @@
+#include <atomic>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/epoch.h>
+#include <csg/core/hazard.h>
+
+using namespace csg;
+
+// Measures a read of one node through each reclamation policy, and the cost
+// of retiring a node (including the batched scans and the callbacks). A
+// hazard pointer protects each node it visits; an epoch section protects
+// every node at once, so it is cheaper when a reader visits many.
+
+namespace {
+
+struct hazard_node : hazard_context {
+  int value;
+};
+
+struct epoch_node : epoch_context {
+  int value;
+};
+
+hazard_domain hazards;
+epoch ep;
+hazard_node hazardNode;
+epoch_node epochNode;
+std::atomic<hazard_node *> hazardHead = &hazardNode;
+std::atomic<epoch_node *> epochHead = &epochNode;
+
+} // End of anonymous namespace
+
+template <typename Domain, typename Node>
+static void BM_read(benchmark::State &state, Domain &d,
+                    std::atomic<Node *> &head) {
+  int sum = 0;
+  for (auto _ : state) {
+    typename Domain::guard g{d};
+    sum += g.protect(head, 0)->value;
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_read, hazard, hazards, hazardHead)->ThreadRange(1, 4);
+BENCHMARK_CAPTURE(BM_read, epoch, ep, epochHead)->ThreadRange(1, 4);
+
+static void BM_retire(benchmark::State &state) {
+  for (auto _ : state) {
+    hazards.retire(new hazard_node, [](hazard_context *c) {
+      delete static_cast<hazard_node *>(c);
+    });
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_retire)->ThreadRange(1, 4);
+
+BENCHMARK_MAIN();
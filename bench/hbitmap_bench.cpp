@@ -0,0 +1,78 @@
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/bitstring.h>
+#include <csg/core/hbitmap.h>
+
+using namespace csg;
+
+// Model the ready set of a large scheduler: a 16 Mbit bitmap with a small
+// number of set bits, which is repeatedly scanned in order.
+
+namespace {
+
+std::vector<std::size_t> random_bits(std::size_t nbits, std::size_t n) {
+  std::mt19937_64 gen{n};
+  std::uniform_int_distribution<std::size_t> pos{0, nbits - 1};
+  std::vector<std::size_t> bits(n);
+  for (auto &b : bits)
+    b = pos(gen);
+  return bits;
+}
+
+void args(benchmark::internal::Benchmark *b) {
+  for (const std::int64_t setBits : { 16, 1024, 65536 })
+    b->Args({1 << 24, setBits});
+}
+
+} // End of anonymous namespace
+
+static void BM_scan_bitstring(benchmark::State &state) {
+  bitstring b{static_cast<std::size_t>(state.range(0))};
+  for (const auto bit : random_bits(b.size(), state.range(1)))
+    b.set(bit);
+
+  for (auto _ : state) {
+    std::size_t found = 0;
+    for (auto bit = b.ffs(); bit != bitstring::not_found;
+         bit = b.ffs_at(static_cast<std::size_t>(bit) + 1))
+      ++found;
+    benchmark::DoNotOptimize(found);
+  }
+}
+BENCHMARK(BM_scan_bitstring)->Apply(args);
+
+static void BM_scan_hbitmap(benchmark::State &state) {
+  hbitmap b{static_cast<std::size_t>(state.range(0))};
+  for (const auto bit : random_bits(b.size(), state.range(1)))
+    b.set(bit);
+
+  for (auto _ : state) {
+    std::size_t found = 0;
+    for ([[maybe_unused]] const auto bit : b)
+      ++found;
+    benchmark::DoNotOptimize(found);
+  }
+}
+BENCHMARK(BM_scan_hbitmap)->Apply(args);
+
+static void BM_set_clear_hbitmap(benchmark::State &state) {
+  // Cost of maintaining the summary level.
+  hbitmap b{static_cast<std::size_t>(state.range(0))};
+  const auto bits = random_bits(b.size(), state.range(1));
+
+  for (auto _ : state) {
+    for (const auto bit : bits)
+      b.set(bit);
+    for (const auto bit : bits)
+      b.clear(bit);
+  }
+
+  state.SetItemsProcessed(state.iterations() * state.range(1) * 2);
+}
+BENCHMARK(BM_set_clear_hbitmap)->Apply(args);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,73 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/mcs_lock.h>
+#include <csg/core/utility.h>
+
+using namespace csg;
+
+// Measures the throughput of short critical sections under an MCS lock, a
+// cohort lock and a std::mutex, against a test-and-test-and-set spin lock,
+// whose waiters all spin on the lock itself; and their fairness, as the
+// fraction of acquisitions in which a thread took the lock again straight
+// after releasing it while other threads were waiting ("reacquired").
+
+namespace {
+
+class tas_lock {
+public:
+  void lock() noexcept {
+    util::spin_backoff backoff;
+    while (m_locked.exchange(true, std::memory_order_acquire)) {
+      while (m_locked.load(std::memory_order_relaxed))
+        backoff.pause();
+    }
+  }
+
+  void unlock() noexcept { m_locked.store(false, std::memory_order_release); }
+
+private:
+  std::atomic<bool> m_locked = false;
+};
+
+template <typename Lock>
+struct shared {
+  Lock lock;
+  std::uint64_t counter = 0;
+  int lastOwner = -1;
+};
+
+template <typename Lock>
+shared<Lock> &get_shared() {
+  static shared<Lock> s;
+  return s;
+}
+
+} // End of anonymous namespace
+
+template <typename Lock>
+static void BM_lock(benchmark::State &state) {
+  shared<Lock> &s = get_shared<Lock>();
+  const int self = state.thread_index();
+  std::uint64_t reacquired = 0;
+  for (auto _ : state) {
+    const std::lock_guard guard{s.lock};
+    ++s.counter;
+    reacquired += s.lastOwner == self;
+    s.lastOwner = self;
+  }
+  state.SetItemsProcessed(state.iterations());
+  if (state.threads() > 1) {
+    state.counters["reacquired"] = benchmark::Counter(
+        static_cast<double>(reacquired) / state.iterations(),
+        benchmark::Counter::kAvgThreads);
+  }
+}
+BENCHMARK_TEMPLATE(BM_lock, tas_lock)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_lock, std::mutex)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_lock, mcs_lock)->ThreadRange(1, 16);
+BENCHMARK_TEMPLATE(BM_lock, cohort_lock)->ThreadRange(1, 16);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,66 @@
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/mempool.h>
+
+using namespace csg;
+
+// Compares taking and returning objects through a thread's cache, through
+// the shared ring alone (cache_size = 0), and with operator new/delete.
+
+namespace {
+
+struct alignas(64) object {
+  std::uint64_t data[8];
+};
+
+std::unique_ptr<mempool<object>> pool;
+
+void setup(const benchmark::State &state) {
+  pool = std::make_unique<mempool<object>>(
+      16384, mempool_options{.cache_size = static_cast<std::size_t>(
+                                 state.range(0))});
+}
+
+void teardown(const benchmark::State &) { pool.reset(); }
+
+} // End of anonymous namespace
+
+static void BM_get_put(benchmark::State &state) {
+  for (auto _ : state) {
+    object *const p = pool->get();
+    benchmark::DoNotOptimize(p);
+    pool->put(p);
+  }
+  pool->flush_cache();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_get_put)->Arg(0)->Arg(256)->ThreadRange(1, 4)
+    ->Setup(setup)->Teardown(teardown);
+
+static void BM_get_put_bulk(benchmark::State &state) {
+  std::array<object *, 32> burst;
+  for (auto _ : state) {
+    if (pool->get_bulk(burst))
+      pool->put_bulk(burst);
+    benchmark::ClobberMemory();
+  }
+  pool->flush_cache();
+  state.SetItemsProcessed(state.iterations() * burst.size());
+}
+BENCHMARK(BM_get_put_bulk)->Arg(0)->Arg(256)->ThreadRange(1, 4)
+    ->Setup(setup)->Teardown(teardown);
+
+static void BM_new_delete(benchmark::State &state) {
+  for (auto _ : state) {
+    object *const p = new object;
+    benchmark::DoNotOptimize(p);
+    delete p;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_new_delete)->ThreadRange(1, 4);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,92 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/ring.h>
+
+using namespace csg;
+
+// The single-threaded bulk enqueue/dequeue test from DPDK's ring_perf_autotest:
+// it measures the fixed cost of an operation, and how batching amortizes it,
+// for each synchronization policy.
+
+template <typename Ring>
+static void BM_bulk(benchmark::State &state) {
+  const auto n = static_cast<std::size_t>(state.range(0));
+  Ring r{1024};
+  std::vector<int *> objs(n), out(n);
+
+  for (auto _ : state) {
+    r.enqueue_bulk(objs);
+    r.dequeue_bulk(out);
+    benchmark::DoNotOptimize(out.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(n));
+}
+
+BENCHMARK_TEMPLATE(BM_bulk, ring<int *, ring_single, ring_single>)
+    ->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK_TEMPLATE(BM_bulk, ring<int *, ring_multi, ring_multi>)
+    ->Arg(1)->Arg(8)->Arg(32);
+
+BENCHMARK_TEMPLATE(BM_bulk, ring<int *, ring_rts, ring_rts>)
+    ->Arg(1)->Arg(8)->Arg(32);
+BENCHMARK_TEMPLATE(BM_bulk, ring<int *, ring_hts, ring_hts>)
+    ->Arg(1)->Arg(8)->Arg(32);
+
+// Overcommitted threads: every thread enqueues a burst and then dequeues one,
+// and records how long each round trip took. Run with more threads than
+// CPUs, a thread preempted in the middle of an operation makes the others
+// wait; with ring_multi they spin behind it until the scheduler runs it
+// again, which shows in the tail latencies (the p99 and max counters, in
+// nanoseconds). The RTS and HTS policies avoid this.
+
+template <typename Ring>
+static void BM_overcommit(benchmark::State &state) {
+  constexpr std::size_t Burst = 8;
+  static Ring *r;
+  if (state.thread_index() == 0)
+    r = new Ring{1024};
+
+  std::vector<int *> objs(Burst), out(Burst);
+  std::vector<std::int64_t> samples;
+  samples.reserve(1 << 20);
+
+  for (auto _ : state) {
+    const auto start = std::chrono::steady_clock::now();
+    r->enqueue_bulk(objs);
+    for (std::size_t got = 0; got < Burst;)
+      got += r->dequeue_burst(std::span{out}.subspan(got));
+    const auto end = std::chrono::steady_clock::now();
+    if (samples.size() < samples.capacity())
+      samples.push_back((end - start).count());
+  }
+
+  std::sort(samples.begin(), samples.end());
+  auto at = [&](double q) {
+    return samples.empty() ? 0.0 : static_cast<double>(
+        samples[static_cast<std::size_t>(q * (samples.size() - 1))]);
+  };
+  state.counters["p50_ns"] = {at(0.50), benchmark::Counter::kAvgThreads};
+  state.counters["p99_ns"] = {at(0.99), benchmark::Counter::kAvgThreads};
+  state.counters["max_ns"] = {at(1.0), benchmark::Counter::kAvgThreads};
+  state.SetItemsProcessed(state.iterations() *
+                          static_cast<std::int64_t>(Burst));
+
+  if (state.thread_index() == 0)
+    delete r;
+}
+
+BENCHMARK_TEMPLATE(BM_overcommit, ring<int *, ring_multi, ring_multi>)
+    ->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_overcommit, ring<int *, ring_rts, ring_rts>)
+    ->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_overcommit, ring<int *, ring_hts, ring_hts>)
+    ->ThreadRange(1, 8)->UseRealTime();
+
+BENCHMARK_MAIN();
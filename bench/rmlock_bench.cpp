@@ -0,0 +1,45 @@
+#include <mutex>
+#include <shared_mutex>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/rmlock.h>
+
+using namespace csg;
+
+// Measures the read side of rmlock, which writes only to a per-thread
+// tracker, against std::shared_mutex, whose readers all update the same
+// reader count; and the (much slower) rmlock write side.
+
+namespace {
+
+rmlock rm;
+std::shared_mutex sm;
+int value;
+
+} // End of anonymous namespace
+
+template <typename Mutex>
+static void BM_read(benchmark::State &state, Mutex &m) {
+  int sum = 0;
+  for (auto _ : state) {
+    std::shared_lock r{m};
+    sum += value;
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_read, rmlock, rm)->ThreadRange(1, 8);
+BENCHMARK_CAPTURE(BM_read, shared_mutex, sm)->ThreadRange(1, 8);
+
+template <typename Mutex>
+static void BM_write(benchmark::State &state, Mutex &m) {
+  for (auto _ : state) {
+    std::unique_lock w{m};
+    ++value;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_write, rmlock, rm);
+BENCHMARK_CAPTURE(BM_write, shared_mutex, sm);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/seqlock.h>
+
+using namespace csg;
+
+// Measures the readers of a small statistics record protected by a seqlock,
+// which only load from shared memory, against a record protected by a
+// std::shared_mutex, whose readers all update its reader count; with up to
+// 64 readers, alone or with a writer (thread 0) updating the record.
+
+namespace {
+
+struct stats {
+  std::uint64_t packets;
+  std::uint64_t bytes;
+  std::uint64_t drops;
+  std::uint64_t errors;
+  std::uint64_t last_seen;
+  std::uint64_t pad[3];
+};
+
+seqlock<stats> seqStats;
+std::shared_mutex statsMutex;
+stats mutexStats;
+
+void update(stats &s) noexcept {
+  ++s.packets;
+  s.bytes += 1500;
+  s.last_seen = s.packets;
+}
+
+} // End of anonymous namespace
+
+static void BM_read_seqlock(benchmark::State &state) {
+  std::uint64_t sum = 0;
+  for (auto _ : state)
+    sum += seqStats.load().bytes;
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_read_seqlock)->Threads(1)->Threads(8)->Threads(64);
+
+static void BM_read_shared_mutex(benchmark::State &state) {
+  std::uint64_t sum = 0;
+  for (auto _ : state) {
+    std::shared_lock r{statsMutex};
+    sum += mutexStats.bytes;
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_read_shared_mutex)->Threads(1)->Threads(8)->Threads(64);
+
+static void BM_mixed_seqlock(benchmark::State &state) {
+  std::uint64_t sum = 0;
+  for (auto _ : state) {
+    if (state.thread_index() == 0)
+      seqStats.update(update);
+    else
+      sum += seqStats.load().bytes;
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mixed_seqlock)->Threads(64);
+
+static void BM_mixed_shared_mutex(benchmark::State &state) {
+  std::uint64_t sum = 0;
+  for (auto _ : state) {
+    if (state.thread_index() == 0) {
+      std::unique_lock w{statsMutex};
+      update(mutexStats);
+    }
+    else {
+      std::shared_lock r{statsMutex};
+      sum += mutexStats.bytes;
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mixed_shared_mutex)->Threads(64);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,138 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/shm_ring.h>
+
+using namespace csg;
+
+// Passing 64 byte messages from one process to another: through a shm_ring
+// in a memfd (with both sides blocking, so neither process spins on a full or
+// empty ring for a whole time slice), and through a Unix stream socketpair,
+// which is what the ring replaces. Each benchmark forks a consumer process
+// which reads until it sees a message with the `last` flag. The argument is
+// the number of messages per enqueue, or per write(2).
+
+namespace {
+
+struct message {
+  std::uint64_t seq;
+  std::uint64_t last;
+  std::byte payload[48];
+};
+
+static_assert(sizeof(message) == 64);
+
+using msg_ring = shm_ring<message, ring_blocking<ring_single>,
+                          ring_blocking<ring_single>>;
+
+constexpr std::size_t MaxBatch = 32;
+
+void wait_child(benchmark::State &state, pid_t child) {
+  int status;
+  if (::waitpid(child, &status, 0) != child || !WIFEXITED(status) ||
+      WEXITSTATUS(status))
+    state.SkipWithError("consumer process failed");
+}
+
+bool write_all(int fd, const void *data, std::size_t size) {
+  const auto *p = static_cast<const std::byte *>(data);
+  while (size) {
+    const ssize_t n = ::write(fd, p, size);
+    if (n <= 0)
+      return false;
+    p += n;
+    size -= static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+} // End of anonymous namespace
+
+static void BM_shm_ring(benchmark::State &state) {
+  const auto batch = static_cast<std::size_t>(state.range(0));
+  auto r = msg_ring::create_anonymous(1024);
+
+  const pid_t child = ::fork();
+  if (!child) {
+    std::array<message, MaxBatch> in;
+    for (;;) {
+      const std::size_t n = r.dequeue_burst_wait(in);
+      for (std::size_t i = 0; i < n; ++i) {
+        if (in[i].last)
+          ::_exit(0);
+      }
+    }
+  }
+
+  std::array<message, MaxBatch> out{};
+  std::uint64_t seq = 0;
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < batch; ++i)
+      out[i].seq = seq++;
+    r.enqueue_bulk_wait({out.data(), batch});
+  }
+
+  out[0].last = 1;
+  r.enqueue_wait(out[0]);
+  wait_child(state, child);
+  state.SetItemsProcessed(static_cast<std::int64_t>(seq));
+  state.SetBytesProcessed(static_cast<std::int64_t>(seq * sizeof(message)));
+}
+
+static void BM_socketpair(benchmark::State &state) {
+  const auto batch = static_cast<std::size_t>(state.range(0));
+  int fds[2];
+  if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+    state.SkipWithError("socketpair failed");
+    return;
+  }
+
+  const pid_t child = ::fork();
+  if (!child) {
+    ::close(fds[0]);
+    std::array<message, MaxBatch> in;
+    std::size_t have = 0;
+    for (;;) {
+      const ssize_t n = ::read(fds[1], reinterpret_cast<std::byte *>(
+          in.data()) + have, sizeof in - have);
+      if (n <= 0)
+        ::_exit(1);
+      have += static_cast<std::size_t>(n);
+      const std::size_t whole = have / sizeof(message);
+      for (std::size_t i = 0; i < whole; ++i) {
+        if (in[i].last)
+          ::_exit(0);
+      }
+      have -= whole * sizeof(message);
+      std::memmove(in.data(), &in[whole], have);
+    }
+  }
+
+  ::close(fds[1]);
+  std::array<message, MaxBatch> out{};
+  std::uint64_t seq = 0;
+  for (auto _ : state) {
+    for (std::size_t i = 0; i < batch; ++i)
+      out[i].seq = seq++;
+    write_all(fds[0], out.data(), batch * sizeof(message));
+  }
+
+  out[0].last = 1;
+  write_all(fds[0], out.data(), sizeof(message));
+  wait_child(state, child);
+  ::close(fds[0]);
+  state.SetItemsProcessed(static_cast<std::int64_t>(seq));
+  state.SetBytesProcessed(static_cast<std::int64_t>(seq * sizeof(message)));
+}
+
+BENCHMARK(BM_shm_ring)->Arg(1)->Arg(32)->UseRealTime();
+BENCHMARK(BM_socketpair)->Arg(1)->Arg(32)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,37 @@
+#include <cstdint>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <benchmark/benchmark.h>
+#include <csg/core/trace_ring.h>
+
+using namespace csg;
+
+// Measures the cost of recording a trace event, which should be a timestamp
+// read and a 64 byte store, and of a full dump to /dev/null.
+
+static void BM_trace(benchmark::State &state) {
+  std::uint64_t i = 0;
+  for (auto _ : state) {
+    CSG_TRACE("event %lu of %p", i, &i);
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_trace)->ThreadRange(1, 4);
+
+static void BM_dump(benchmark::State &state) {
+  for (std::size_t i = 0; i < detail::trace_ring_buffer::capacity; ++i)
+    CSG_TRACE("event %zu", i);
+
+  const int fd = ::open("/dev/null", O_WRONLY);
+  std::size_t n = 0;
+  for (auto _ : state)
+    n += trace_dump(fd);
+  ::close(fd);
+  state.SetItemsProcessed(static_cast<std::int64_t>(n));
+}
+BENCHMARK(BM_dump);
+
+BENCHMARK_MAIN();
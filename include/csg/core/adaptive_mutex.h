@@ -0,0 +1,382 @@
+//==-- csg/core/adaptive_mutex.h - spin-then-sleep mutex --------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a mutex which spins while its owner runs and otherwise
+ *     sleeps until a release wakes it, in the style of FreeBSD's default
+ *     mutex(9).
+ */
+
+#ifndef CSG_CORE_ADAPTIVE_MUTEX_H
+#define CSG_CORE_ADAPTIVE_MUTEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <source_location>
+#include <thread>
+
+#include <csg/core/assert.h>
+#include <csg/core/futex.h>
+#include <csg/core/lock_profile.h>
+#include <csg/core/tailq.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+namespace detail {
+
+enum adaptive_wakeup : std::uint32_t {
+  adaptive_asleep,
+  adaptive_retry,     // Woken to compete for the mutex again.
+  adaptive_handoff    // Woken as the new owner of the mutex.
+};
+
+// The state of a thread as the owner of, or a waiter for, adaptive mutexes,
+// like the parts of FreeBSD's struct thread which mutexes use. Records are
+// reused by new threads but never freed while the process runs (like the
+// type-stable memory of FreeBSD threads), so a thread spinning on a mutex
+// can safely read the record of an owner which has since exited.
+struct alignas(util::cache_line_size) adaptive_thread {
+  tailq_entry<adaptive_thread> link;
+  std::atomic<std::thread::id> thread;
+  std::atomic<bool> running = true;        // Cleared while it sleeps.
+  std::atomic<std::uint32_t> wakeup = adaptive_asleep;
+  bool inUse = false;                      // Protected by the registry.
+};
+
+class adaptive_thread_registry {
+public:
+  static adaptive_thread_registry &instance() {
+    static adaptive_thread_registry r;
+    return r;
+  }
+
+  ~adaptive_thread_registry() {
+    while (!m_threads.empty()) {
+      adaptive_thread &t = m_threads.front();
+      m_threads.pop_front();
+      delete &t;
+    }
+  }
+
+  adaptive_thread *attachThread() noexcept {
+    const std::lock_guard lock{m_mutex};
+    adaptive_thread *t = nullptr;
+    for (adaptive_thread &r : m_threads) {
+      if (!r.inUse) {
+        t = &r;
+        break;
+      }
+    }
+    if (!t) {
+      t = new (std::nothrow) adaptive_thread;
+      if (!t)
+        return nullptr;
+      m_threads.push_back(t);
+    }
+    t->inUse = true;
+    t->thread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    return t;
+  }
+
+  void detachThread(adaptive_thread &t) noexcept {
+    const std::lock_guard lock{m_mutex};
+    t.thread.store(std::thread::id{}, std::memory_order_relaxed);
+    t.inUse = false;
+  }
+
+private:
+  adaptive_thread_registry() = default;
+
+  std::mutex m_mutex;
+  CSG_TAILQ_HEAD_OFFSET_T(adaptive_thread, link) m_threads;
+};
+
+struct adaptive_thread_tls {
+  ~adaptive_thread_tls() {
+    if (record)
+      adaptive_thread_registry::instance().detachThread(*record);
+  }
+
+  adaptive_thread &get() noexcept {
+    if (!record) [[unlikely]] {
+      record = adaptive_thread_registry::instance().attachThread();
+      if (!record) {
+        // Without a record, the thread cannot be recorded as an owner.
+        std::terminate();
+      }
+    }
+    return *record;
+  }
+
+  adaptive_thread *record = nullptr;
+};
+
+inline thread_local adaptive_thread_tls adaptive_current_thread;
+
+// A thread sleeping on an adaptive mutex, on the stack of adaptive_mutex's
+// lockSlow; like a turnstile, but one per waiter rather than per lock.
+struct adaptive_waiter {
+  tailq_entry<adaptive_waiter> link;
+  adaptive_thread *thread;
+};
+
+using adaptive_waiter_list = CSG_TAILQ_HEAD_OFFSET_T(adaptive_waiter, link);
+
+} // End of namespace detail
+
+/**
+ * @brief A mutex which spins while its owner is running, and otherwise
+ *     sleeps until the owner wakes it, modeled after FreeBSD's default
+ *     (MTX_DEF) mutex(9).
+ *
+ * The lock word holds a pointer to the owner's thread record, whose
+ * `running` flag tells waiters whether the owner is on a CPU. If it is, the
+ * critical section is likely to end soon, and a waiter spins rather than
+ * paying for two context switches, as a waiter on a std::mutex does. If the
+ * owner sleeps (because it waits for another adaptive_mutex), if other
+ * threads already sleep, or if the waiter has spun for @ref max_spins
+ * iterations, the waiter links a node on its stack onto the mutex's tailq
+ * of waiters, sets the contested bit of the lock word, and sleeps on a
+ * futex in its thread record. There is no spinning on a machine with a
+ * single CPU, where the owner cannot run while a waiter does.
+ *
+ * Releasing an uncontested mutex is a single compare-and-swap. When the
+ * contested bit is set, the owner removes the first waiter from the queue,
+ * releases the mutex, and wakes only that waiter, rather than every waiter
+ * as FreeBSD's turnstiles do. A running thread may take the mutex before the
+ * woken waiter is scheduled, which avoids a context switch per acquisition
+ * under contention; but a woken waiter which loses that race requeues at
+ * the head of the queue, without spinning, and sets the handoff bit, so that
+ * the next owner hands the mutex directly to it, as Linux's mutexes do. So
+ * no waiter is overtaken more than once after it is woken.
+ *
+ * Unlike the kernel, a user-space thread cannot tell whether another thread
+ * has been preempted, so an owner only counts as not running while it
+ * sleeps on an adaptive mutex, and the spin limit bounds the time lost
+ * spinning on a preempted owner.
+ *
+ * The adaptive_mutex meets the requirements of the standard Lockable
+ * concept; it is not recursive, which is asserted against. The
+ * source_location parameters of the lock functions name the lock site when
+ * lock profiling is enabled (see lock_profile.h), and are otherwise unused.
+ */
+class adaptive_mutex {
+public:
+  constexpr static std::uint32_t max_spins = 4096;
+
+  explicit adaptive_mutex(const char *name = "adaptive_mutex") noexcept
+      : m_name{name} {}
+
+  adaptive_mutex(const adaptive_mutex &) = delete;
+
+  ~adaptive_mutex() {
+    CSG_ASSERT(!m_lock.load(std::memory_order_relaxed),
+               "adaptive_mutex %s destroyed while locked", m_name);
+  }
+
+  adaptive_mutex &operator=(const adaptive_mutex &) = delete;
+
+  const char *name() const noexcept { return m_name; }
+
+  void lock(std::source_location loc =
+                std::source_location::current()) noexcept {
+    detail::adaptive_thread &self = detail::adaptive_current_thread.get();
+    detail::lock_profile_attempt profile;
+    std::uintptr_t v = 0;
+    if (!m_lock.compare_exchange_strong(v, toWord(self),
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+      profile.failed();
+      lockSlow(self);
+    }
+    profile.success(this, m_name, loc);
+  }
+
+  bool try_lock(std::source_location loc =
+                    std::source_location::current()) noexcept {
+    detail::adaptive_thread &self = detail::adaptive_current_thread.get();
+    std::uintptr_t v = 0;
+    if (!m_lock.compare_exchange_strong(v, toWord(self),
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed))
+      return false;
+    detail::lock_profile_attempt{}.success(this, m_name, loc);
+    return true;
+  }
+
+  void unlock() noexcept {
+    detail::adaptive_thread &self = detail::adaptive_current_thread.get();
+    CSG_ASSERT(ownerRecord() == &self,
+               "adaptive_mutex %s is not locked by this thread", m_name);
+    detail::lock_profile_release(this);
+    std::uintptr_t v = toWord(self);
+    if (!m_lock.compare_exchange_strong(v, 0, std::memory_order_release,
+                                        std::memory_order_relaxed))
+      unlockSlow();
+  }
+
+  /// Whether the calling thread holds the mutex.
+  bool held() const noexcept {
+    return ownerRecord() == &detail::adaptive_current_thread.get();
+  }
+
+  /// The thread which holds the mutex, if any; only a snapshot, unless the
+  /// caller holds it.
+  std::thread::id owner() const noexcept {
+    const detail::adaptive_thread *const t = ownerRecord();
+    return t ? t->thread.load(std::memory_order_relaxed) : std::thread::id{};
+  }
+
+  /// Whether threads sleep waiting for the mutex; only a snapshot.
+  bool contested() const noexcept {
+    return m_lock.load(std::memory_order_relaxed) & contested_bit;
+  }
+
+private:
+  constexpr static std::uintptr_t contested_bit = 1;
+  constexpr static std::uintptr_t handoff_bit = 2;
+  constexpr static std::uintptr_t flag_mask = contested_bit | handoff_bit;
+
+  static std::uintptr_t toWord(detail::adaptive_thread &t) noexcept {
+    return reinterpret_cast<std::uintptr_t>(&t);
+  }
+
+  detail::adaptive_thread *ownerRecord() const noexcept {
+    return reinterpret_cast<detail::adaptive_thread *>(
+        m_lock.load(std::memory_order_relaxed) & ~flag_mask);
+  }
+
+  static bool canSpin() noexcept {
+    static const bool multiprocessor = std::thread::hardware_concurrency() > 1;
+    return multiprocessor;
+  }
+
+  void lockQueue() noexcept {
+    util::spin_backoff backoff;
+    while (m_queueLocked.exchange(true, std::memory_order_acquire)) {
+      while (m_queueLocked.load(std::memory_order_relaxed))
+        backoff.pause();
+    }
+  }
+
+  void unlockQueue() noexcept {
+    m_queueLocked.store(false, std::memory_order_release);
+  }
+
+  void lockSlow(detail::adaptive_thread &self) noexcept;
+
+  void unlockSlow() noexcept;
+
+  const char *m_name;
+
+  // The owner's adaptive_thread record, if any, or'ed with contested_bit
+  // while threads sleep on m_waiters, and with handoff_bit while the first
+  // of them must be handed the mutex; 0 when the mutex is free.
+  alignas(util::cache_line_size) std::atomic<std::uintptr_t> m_lock = 0;
+
+  // A spin lock protecting m_waiters and the setting and clearing of the
+  // contested bit; like FreeBSD's turnstile chain locks, it is held only
+  // for a few instructions.
+  std::atomic<bool> m_queueLocked = false;
+  detail::adaptive_waiter_list m_waiters;
+};
+
+inline void adaptive_mutex::lockSlow(detail::adaptive_thread &self) noexcept {
+  CSG_ASSERT(ownerRecord() != &self, "adaptive_mutex %s: recursive lock",
+             m_name);
+  std::uint32_t spins = 0;
+  bool woken = false;
+  for (;;) {
+    // The mutex may be free while contested, after an unlock which woke a
+    // waiter.
+    std::uintptr_t v = m_lock.load(std::memory_order_relaxed);
+    if (!(v & ~flag_mask)) {
+      if (m_lock.compare_exchange_weak(v, toWord(self) | v,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        return;
+      continue;
+    }
+
+    // Spin while the owner runs, unless it must hand the mutex to a waiter,
+    // or we were woken and lost the mutex to it, and so requeue at once to
+    // be handed the mutex on its release.
+    const auto *const owner =
+        reinterpret_cast<detail::adaptive_thread *>(v & ~flag_mask);
+    if (!woken && !(v & handoff_bit) && spins < max_spins && canSpin() &&
+        owner->running.load(std::memory_order_relaxed)) {
+      ++spins;
+      util::cpu_relax();
+      continue;
+    }
+
+    lockQueue();
+    v = m_lock.load(std::memory_order_relaxed);
+    if (!(v & ~flag_mask)) {
+      unlockQueue();
+      continue;
+    }
+    const std::uintptr_t flags = contested_bit | (woken ? handoff_bit : 0);
+    if ((v | flags) != v &&
+        !m_lock.compare_exchange_strong(v, v | flags,
+                                        std::memory_order_relaxed)) {
+      // The owner released the mutex meanwhile.
+      unlockQueue();
+      continue;
+    }
+
+    // The owner cannot release the mutex without taking the queue lock, and
+    // so will find us on the queue.
+    detail::adaptive_waiter w;
+    w.thread = &self;
+    self.wakeup.store(detail::adaptive_asleep, std::memory_order_relaxed);
+    if (woken)
+      m_waiters.push_front(&w);
+    else
+      m_waiters.push_back(&w);
+    unlockQueue();
+
+    self.running.store(false, std::memory_order_relaxed);
+    std::uint32_t wakeup;
+    while (!(wakeup = self.wakeup.load(std::memory_order_acquire)))
+      util::futex_wait(self.wakeup, detail::adaptive_asleep);
+    self.running.store(true, std::memory_order_relaxed);
+    if (wakeup == detail::adaptive_handoff)
+      return;
+    woken = true;
+  }
+}
+
+inline void adaptive_mutex::unlockSlow() noexcept {
+  lockQueue();
+  CSG_ASSERT(!m_waiters.empty(), "adaptive_mutex %s contested, but no waiter",
+             m_name);
+  detail::adaptive_waiter &w = m_waiters.front();
+  m_waiters.pop_front();
+  detail::adaptive_thread &next = *w.thread;
+  const std::uintptr_t contested = m_waiters.empty() ? 0 : contested_bit;
+  const bool handoff = m_lock.load(std::memory_order_relaxed) & handoff_bit;
+  m_lock.store((handoff ? toWord(next) : 0) | contested,
+               std::memory_order_release);
+  unlockQueue();
+
+  // `w` may be gone as soon as the waiter is woken, but thread records are
+  // never freed.
+  next.wakeup.store(handoff ? detail::adaptive_handoff : detail::adaptive_retry,
+                    std::memory_order_release);
+  util::futex_wake(next.wakeup, 1);
+}
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,378 @@
+//==-- csg/core/alloc_trace.h - allocation trace capture --------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a std::pmr::memory_resource adaptor that records every
+ *     allocation and deallocation to a compact binary log, which can later
+ *     be replayed against other memory resources.
+ */
+
+#ifndef CSG_CORE_ALLOC_TRACE_H
+#define CSG_CORE_ALLOC_TRACE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <system_error>
+#include <vector>
+
+#include <csg/core/assert.h>
+#include <csg/core/tailq.h>
+
+namespace csg {
+
+enum class alloc_trace_kind : std::uint8_t {
+  allocate,
+  deallocate
+};
+
+/**
+ * @brief A single allocation or deallocation event, as stored in the log.
+ *
+ * Events are 24 bytes: a timestamp, the address, and an "info" word packing
+ * the size (40 bits), the base-2 logarithm of the alignment (6 bits), the
+ * event kind (1 bit), and the recording thread's index (16 bits). The
+ * lifetime of an allocation is the difference between the timestamps of its
+ * allocate and deallocate events.
+ */
+struct alloc_trace_event {
+  constexpr static unsigned size_bits = 40;
+  constexpr static std::uint64_t max_size = (std::uint64_t{1} << size_bits) - 1;
+
+  /// Nanoseconds since the log was opened.
+  std::uint64_t timestamp;
+  std::uint64_t address;
+  std::uint64_t info;
+
+  constexpr static alloc_trace_event
+  make(alloc_trace_kind k, std::uint64_t ts, const void *p, std::size_t bytes,
+       std::size_t align, std::uint16_t thread) noexcept {
+    const std::uint64_t alignLog2 =
+        static_cast<std::uint64_t>(std::countr_zero(align));
+    return {ts, std::bit_cast<std::uintptr_t>(p),
+            std::min<std::uint64_t>(bytes, max_size) |
+            alignLog2 << size_bits |
+            static_cast<std::uint64_t>(k) << (size_bits + 6) |
+            static_cast<std::uint64_t>(thread) << 48};
+  }
+
+  constexpr std::size_t size() const noexcept {
+    return static_cast<std::size_t>(info & max_size);
+  }
+
+  constexpr std::size_t alignment() const noexcept {
+    return std::size_t{1} << ((info >> size_bits) & 0x3f);
+  }
+
+  constexpr alloc_trace_kind kind() const noexcept {
+    return static_cast<alloc_trace_kind>((info >> (size_bits + 6)) & 1);
+  }
+
+  constexpr std::uint16_t thread() const noexcept {
+    return static_cast<std::uint16_t>(info >> 48);
+  }
+};
+
+static_assert(sizeof(alloc_trace_event) == 24);
+
+/// The file header at the start of every allocation trace log.
+struct alloc_trace_header {
+  constexpr static char expected_magic[8] = {'C', 'S', 'D', 'A',
+                                             'T', 'R', 'C', '\0'};
+  constexpr static std::uint32_t current_version = 1;
+
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t event_size;
+};
+
+class alloc_trace_log;
+
+namespace detail {
+
+// Each recording thread appends events to its own buffer, so the fast path
+// of trace_resource is a timestamp read and a 24 byte store with no shared
+// writes. Full buffers are written to the log's file under the log's mutex.
+struct alloc_trace_buffer {
+  constexpr static std::size_t capacity = 4096;
+
+  // Set by the recording thread, and cleared by the log when it is
+  // destroyed, after which the thread may reuse the buffer for another log.
+  std::atomic<alloc_trace_log *> log = nullptr;
+  tailq_entry<alloc_trace_buffer> logLink;
+  tailq_entry<alloc_trace_buffer> threadLink;
+  std::uint16_t thread = 0;
+  std::size_t count = 0;
+  alloc_trace_event events[capacity];
+};
+
+// A thread's buffers, one for each log it has recorded into, like the
+// per-thread records of reclaim.h; `last` caches the most recently used.
+struct alloc_trace_tls {
+  ~alloc_trace_tls();
+  alloc_trace_buffer *last = nullptr;
+  CSG_TAILQ_HEAD_OFFSET_T(alloc_trace_buffer, threadLink) buffers;
+};
+
+inline thread_local alloc_trace_tls alloc_trace_thread_buffers;
+
+} // End of namespace detail
+
+/**
+ * @brief Destination for allocation trace events, which are written in a
+ *     binary format to a stdio stream.
+ *
+ * Each thread that records into the log gets its own event buffer, which is
+ * registered on a tailq owned by the log and written out when it fills, when
+ * the thread exits, or when @ref flush is called. A thread keeps its buffer
+ * (and its thread index) for each log it records into, so alternating
+ * between logs costs only a search of its buffers. Because buffers are written
+ * independently, the events in the file are ordered only per thread;
+ * @ref read_alloc_trace sorts them by timestamp.
+ *
+ * The log must outlive all recording threads' use of it. Calls to
+ * @ref flush and the destructor must not run concurrently with recording.
+ */
+class alloc_trace_log {
+public:
+  /// Record into an already-opened stream, which is not closed by the log.
+  explicit alloc_trace_log(std::FILE *out)
+      : m_out{out}, m_ownsFile{false}, m_nextThread{0},
+        m_epoch{std::chrono::steady_clock::now()} {
+    writeHeader();
+  }
+
+  /// Create (or truncate) the file at `path` and record into it.
+  explicit alloc_trace_log(const char *path)
+      : m_out{std::fopen(path, "wb")}, m_ownsFile{true}, m_nextThread{0},
+        m_epoch{std::chrono::steady_clock::now()} {
+    if (!m_out)
+      throw std::system_error{errno, std::generic_category(), path};
+    writeHeader();
+  }
+
+  alloc_trace_log(const alloc_trace_log &) = delete;
+
+  ~alloc_trace_log() {
+    flush();
+
+    const std::lock_guard lock{m_mutex};
+    while (!m_buffers.empty()) {
+      detail::alloc_trace_buffer &b = m_buffers.front();
+      m_buffers.pop_front();
+      b.log.store(nullptr, std::memory_order_release);
+    }
+
+    if (m_ownsFile)
+      std::fclose(m_out);
+  }
+
+  alloc_trace_log &operator=(const alloc_trace_log &) = delete;
+
+  void record(alloc_trace_kind kind, const void *p, std::size_t bytes,
+              std::size_t align) noexcept {
+    detail::alloc_trace_buffer *b = detail::alloc_trace_thread_buffers.last;
+    if (!b || b->log.load(std::memory_order_relaxed) != this) [[unlikely]]
+      b = threadBuffer();
+
+    const auto ts = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - m_epoch).count();
+    b->events[b->count++] = alloc_trace_event::make(kind,
+        static_cast<std::uint64_t>(ts), p, bytes, align, b->thread);
+
+    if (b->count == detail::alloc_trace_buffer::capacity) [[unlikely]] {
+      const std::lock_guard lock{m_mutex};
+      writeBuffer(*b);
+    }
+  }
+
+  /// Write all buffered events of all threads to the stream.
+  void flush() noexcept {
+    const std::lock_guard lock{m_mutex};
+    for (auto &b : m_buffers)
+      writeBuffer(b);
+    std::fflush(m_out);
+  }
+
+  /// The number of threads which have recorded events into the log.
+  std::uint16_t thread_count() const noexcept {
+    const std::lock_guard lock{m_mutex};
+    return m_nextThread;
+  }
+
+private:
+  friend struct detail::alloc_trace_tls;
+
+  void writeHeader() {
+    alloc_trace_header h;
+    std::memcpy(h.magic, alloc_trace_header::expected_magic, sizeof h.magic);
+    h.version = alloc_trace_header::current_version;
+    h.event_size = sizeof(alloc_trace_event);
+    if (std::fwrite(&h, sizeof h, 1, m_out) != 1)
+      throw std::system_error{errno, std::generic_category(),
+                              "alloc_trace_log header"};
+  }
+
+  // Requires m_mutex. Write errors are deliberately ignored: tracing must
+  // never cause the traced allocation to fail.
+  void writeBuffer(detail::alloc_trace_buffer &b) noexcept {
+    std::fwrite(b.events, sizeof(alloc_trace_event), b.count, m_out);
+    b.count = 0;
+  }
+
+  // Find the calling thread's buffer for this log, or attach one: either a
+  // buffer whose log has been destroyed, or a new one.
+  detail::alloc_trace_buffer *threadBuffer() noexcept {
+    auto &tls = detail::alloc_trace_thread_buffers;
+    detail::alloc_trace_buffer *unused = nullptr;
+    for (auto &b : tls.buffers) {
+      const alloc_trace_log *const log =
+          b.log.load(std::memory_order_acquire);
+      if (log == this)
+        return tls.last = &b;
+      if (!log && !unused)
+        unused = &b;
+    }
+
+    if (!unused) {
+      // Tracing is a diagnostic facility, so if we cannot even allocate the
+      // buffer there is nothing sensible to do but stop.
+      unused = new (std::nothrow) detail::alloc_trace_buffer;
+      if (!unused)
+        std::terminate();
+      tls.buffers.push_back(unused);
+    }
+
+    const std::lock_guard lock{m_mutex};
+    unused->log.store(this, std::memory_order_relaxed);
+    unused->thread = m_nextThread++;
+    m_buffers.push_back(unused);
+    return tls.last = unused;
+  }
+
+  void detachThread(detail::alloc_trace_buffer &b) noexcept {
+    const std::lock_guard lock{m_mutex};
+    writeBuffer(b);
+    m_buffers.erase(m_buffers.iter(&b));
+    b.log.store(nullptr, std::memory_order_relaxed);
+  }
+
+  using buffer_list_type =
+      CSG_TAILQ_HEAD_OFFSET_T(detail::alloc_trace_buffer, logLink);
+
+  std::FILE *m_out;
+  bool m_ownsFile;
+  std::uint16_t m_nextThread;
+  std::chrono::steady_clock::time_point m_epoch;
+  mutable std::mutex m_mutex;
+  buffer_list_type m_buffers;
+};
+
+inline detail::alloc_trace_tls::~alloc_trace_tls() {
+  while (!buffers.empty()) {
+    alloc_trace_buffer &b = buffers.front();
+    buffers.pop_front();
+    if (alloc_trace_log *const log = b.log.load(std::memory_order_acquire))
+      log->detachThread(b);
+    delete &b;
+  }
+}
+
+/**
+ * @brief A std::pmr::memory_resource which forwards to an upstream resource
+ *     and records each allocation and deallocation in an alloc_trace_log.
+ */
+class trace_resource : public std::pmr::memory_resource {
+public:
+  explicit trace_resource(alloc_trace_log &log,
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      noexcept
+      : m_log{log}, m_upstream{upstream} {}
+
+  trace_resource(const trace_resource &) = delete;
+
+  trace_resource &operator=(const trace_resource &) = delete;
+
+  std::pmr::memory_resource *upstream_resource() const noexcept {
+    return m_upstream;
+  }
+
+  alloc_trace_log &log() const noexcept { return m_log; }
+
+protected:
+  void *do_allocate(std::size_t bytes, std::size_t align) override {
+    void *const p = m_upstream->allocate(bytes, align);
+    m_log.record(alloc_trace_kind::allocate, p, bytes, align);
+    return p;
+  }
+
+  void do_deallocate(void *p, std::size_t bytes, std::size_t align) override {
+    // Recorded before the memory is released, so that the event always has
+    // an earlier timestamp than any allocation which reuses the address.
+    m_log.record(alloc_trace_kind::deallocate, p, bytes, align);
+    m_upstream->deallocate(p, bytes, align);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+private:
+  alloc_trace_log &m_log;
+  std::pmr::memory_resource *m_upstream;
+};
+
+/// Read all events from an allocation trace stream, sorted by timestamp.
+inline std::vector<alloc_trace_event> read_alloc_trace(std::FILE *in) {
+  alloc_trace_header h;
+  if (std::fread(&h, sizeof h, 1, in) != 1 ||
+      std::memcmp(h.magic, alloc_trace_header::expected_magic,
+                  sizeof h.magic) ||
+      h.version != alloc_trace_header::current_version ||
+      h.event_size != sizeof(alloc_trace_event))
+    throw std::system_error{std::make_error_code(std::errc::invalid_argument),
+                            "not a CSD allocation trace"};
+
+  std::vector<alloc_trace_event> events;
+  alloc_trace_event buf[1024];
+  std::size_t n;
+
+  while ((n = std::fread(buf, sizeof *buf, std::size(buf), in)) > 0)
+    events.insert(events.end(), buf, buf + n);
+
+  if (std::ferror(in))
+    throw std::system_error{errno, std::generic_category(),
+                            "reading allocation trace"};
+
+  std::ranges::stable_sort(events, {}, &alloc_trace_event::timestamp);
+  return events;
+}
+
+inline std::vector<alloc_trace_event> read_alloc_trace(const char *path) {
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> in{
+      std::fopen(path, "rb"), &std::fclose};
+  if (!in)
+    throw std::system_error{errno, std::generic_category(), path};
+  return read_alloc_trace(in.get());
+}
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,261 @@
+//==-- csg/core/bip_ring.h - variable-length record ring --------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a bipartite ("bip") ring buffer of variable-length
+ *     records, for log and message streams.
+ */
+
+#ifndef CSG_CORE_BIP_RING_H
+#define CSG_CORE_BIP_RING_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#include <csg/core/assert.h>
+#include <csg/core/ring.h>
+
+namespace csg {
+
+/**
+ * @brief A ring buffer of variable-length, length-prefixed records, each of
+ *     which is stored contiguously.
+ *
+ * A record is an 8 byte header followed by its payload, padded to a multiple
+ * of @ref record_alignment bytes. A record that does not fit between its
+ * start position and the end of the buffer is never split: like Simon
+ * Cooke's bip buffer, the producer instead writes a padding record over the
+ * rest of the buffer and places the record at the start. Every payload is
+ * therefore a single contiguous span of memory, which can be handed directly
+ * to a parser or to write(2).
+ *
+ * Writing is zero-copy: @ref reserve returns a region of the requested size
+ * to fill in place, and @ref commit publishes it. The consumer side is
+ * single-threaded, and the producer side's synchronization is a ring policy:
+ * ring_single for one producer (SPSC) or ring_multi for several (MPSC). With
+ * ring_multi, reservations are made with a compare-and-swap and committed in
+ * reservation order, so a producer must not hold a reservation for long.
+ *
+ * As with csg::ring, wrapping either policy in ring_blocking lets the other
+ * side sleep, in @ref reserve_wait or @ref peek_wait.
+ *
+ * The buffer size must be a power of two. Any record of up to
+ * @ref max_record_size bytes fits in an empty ring, wherever the ring's
+ * indices happen to be.
+ */
+template <ring_sync_policy Prod = ring_multi,
+          ring_sync_policy Cons = ring_single>
+class bip_ring {
+  static_assert(!Cons::is_multi_thread, "bip_ring has a single consumer");
+
+  using block_type = detail::ring_block<std::byte, Prod, Cons>;
+
+public:
+  using size_type = std::size_t;
+  using producer_sync = Prod;
+  using consumer_sync = Cons;
+
+  constexpr static size_type record_alignment = 8;
+
+  /// A space reserved for a record, to be filled and passed to commit.
+  class reservation {
+  public:
+    reservation() = default;
+
+    std::span<std::byte> data() const noexcept { return m_data; }
+
+    explicit operator bool() const noexcept { return m_total; }
+
+  private:
+    friend class bip_ring;
+
+    reservation(std::span<std::byte> d, std::uint32_t head,
+                std::uint32_t total) noexcept
+        : m_data{d}, m_head{head}, m_total{total} {}
+
+    std::span<std::byte> m_data;
+    std::uint32_t m_head = 0;
+    std::uint32_t m_total = 0;
+  };
+
+  /// Create a ring of `bytes` bytes, which must be a power of two and at
+  /// least 64.
+  explicit bip_ring(size_type bytes)
+      : m_block{detail::make_ring_block<block_type>(bytes)} {
+    CSG_ASSERT(std::has_single_bit(bytes) && bytes >= 64 &&
+               bytes <= max_size(), "bip_ring size %zu is not valid", bytes);
+  }
+
+  bip_ring(const bip_ring &) = delete;
+
+  bip_ring &operator=(const bip_ring &) = delete;
+
+  constexpr static size_type max_size() noexcept {
+    return size_type{1} << 31;
+  }
+
+  size_type capacity() const noexcept { return m_block->capacity(); }
+
+  size_type max_record_size() const noexcept {
+    return capacity() / 2 - sizeof(header);
+  }
+
+  /// Bytes in use by records and padding; only a snapshot.
+  size_type bytes_used() const noexcept { return m_block->size(); }
+
+  bool empty() const noexcept { return !bytes_used(); }
+
+  //===---------------------------- Producer -----------------------------===//
+
+  /// Reserve space for a record of `length` bytes; the returned reservation
+  /// is empty if there is no room. Every non-empty reservation must be
+  /// committed.
+  reservation reserve(size_type length) noexcept {
+    CSG_ASSERT(length <= max_record_size(), "record of %zu bytes too large",
+               length);
+    if (length > max_record_size())
+      return {};
+
+    const std::uint32_t cap = m_block->capacity();
+    const std::uint32_t size = recordSize(length);
+    std::uint32_t head;
+
+    // The bytes needed for the record if it starts at `h`, including any
+    // padding to the end of the buffer, or zero if they are not free.
+    auto amount = [&](std::uint32_t h) -> std::uint32_t {
+      const std::uint32_t toEnd = cap - (h & m_block->mask);
+      const std::uint32_t need = size <= toEnd ? size : toEnd + size;
+      const std::uint32_t free =
+          cap + Cons::load_tail(m_block->cons) - h;
+      return need <= free ? need : 0;
+    };
+
+    const std::uint32_t total = Prod::move_head(m_block->prod, head, amount);
+
+    if (!total)
+      return {};
+
+    std::uint32_t pos = head & m_block->mask;
+    if (total != size) {
+      writeHeader(pos, {total - size, header::pad});
+      pos = 0;
+    }
+
+    writeHeader(pos, {static_cast<std::uint32_t>(length), 0});
+    return {{m_block->slots() + pos + sizeof(header), length}, head, total};
+  }
+
+  /// Reserve space for a record of `length` bytes, sleeping until there is
+  /// room; requires a blocking consumer policy.
+  reservation reserve_wait(size_type length) noexcept
+    requires Cons::is_blocking {
+    reservation r;
+    Cons::wait(m_block->cons, [&] {
+      r = reserve(length);
+      return r.m_total;
+    });
+    return r;
+  }
+
+  /// Publish a reserved record to the consumer.
+  void commit(const reservation &r) noexcept {
+    CSG_ASSERT(r, "empty reservation committed");
+    Prod::update_tail(m_block->prod, r.m_head, r.m_total);
+  }
+
+  /// Copy `record` into the ring; returns false if there is no room.
+  bool write(std::span<const std::byte> record) noexcept {
+    const reservation r = reserve(record.size());
+    if (!r)
+      return false;
+    std::memcpy(r.data().data(), record.data(), record.size());
+    commit(r);
+    return true;
+  }
+
+  //===---------------------------- Consumer -----------------------------===//
+
+  /// Get the record at the head of the ring, without removing it; returns
+  /// false if the ring is empty. The record stays valid until @ref release.
+  bool peek(std::span<std::byte> &record) noexcept {
+    std::uint32_t head = m_block->cons.head.load(std::memory_order_relaxed);
+    const std::uint32_t tail = Prod::load_tail(m_block->prod);
+
+    if (head == tail)
+      return false;
+
+    header h = readHeader(head & m_block->mask);
+    if (h.flags & header::pad) {
+      // A padding record is always committed together with the record which
+      // follows it, so there is certainly a record at the start.
+      const std::uint32_t padStart = head;
+      head += h.length;
+      m_block->cons.head.store(head, std::memory_order_relaxed);
+      Cons::update_tail(m_block->cons, padStart, h.length);
+      h = readHeader(0);
+    }
+
+    record = {m_block->slots() + (head & m_block->mask) + sizeof(header),
+              h.length};
+    return true;
+  }
+
+  /// Like peek, but sleeps while the ring is empty; requires a blocking
+  /// producer policy.
+  void peek_wait(std::span<std::byte> &record) noexcept
+    requires Prod::is_blocking {
+    Prod::wait(m_block->prod, [&] {
+      return static_cast<std::uint32_t>(peek(record));
+    });
+  }
+
+  /// Remove the record returned by the last successful peek.
+  void release() noexcept {
+    const std::uint32_t head =
+        m_block->cons.head.load(std::memory_order_relaxed);
+    const header h = readHeader(head & m_block->mask);
+    const std::uint32_t size = recordSize(h.length);
+    m_block->cons.head.store(head + size, std::memory_order_relaxed);
+    Cons::update_tail(m_block->cons, head, size);
+  }
+
+private:
+  struct header {
+    constexpr static std::uint32_t pad = 1;
+
+    std::uint32_t length;
+    std::uint32_t flags;
+  };
+
+  static_assert(sizeof(header) == record_alignment);
+
+  static std::uint32_t recordSize(size_type length) noexcept {
+    return static_cast<std::uint32_t>((sizeof(header) + length +
+        record_alignment - 1) & ~(record_alignment - 1));
+  }
+
+  void writeHeader(std::uint32_t pos, header h) noexcept {
+    std::memcpy(m_block->slots() + pos, &h, sizeof h);
+  }
+
+  header readHeader(std::uint32_t pos) const noexcept {
+    header h;
+    std::memcpy(&h, m_block->slots() + pos, sizeof h);
+    return h;
+  }
+
+  detail::ring_block_ptr<block_type> m_block;
+};
+
+} // End of namespace csg
+
+#endif
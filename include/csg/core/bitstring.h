@@ -0,0 +1,478 @@
+//==-- csg/core/bitstring.h - bit string manipulation -----------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains an implementation of fixed-size bit strings, inspired by
+ *     BSD's bitstring(3) macros.
+ *
+ * The scanning operations (ffs, ffc, their area variants and count) examine
+ * 256 or 128 bits at a time when the translation unit is compiled with AVX2
+ * or SSE4.1 support, respectively. Otherwise, or if CSG_BITSTRING_NO_SIMD is
+ * defined, a portable word-at-a-time implementation based on
+ * `std::countr_zero` and `std::popcount` is used.
+ */
+
+#ifndef CSG_CORE_BITSTRING_H
+#define CSG_CORE_BITSTRING_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <span>
+#include <utility>
+
+#include <csg/core/assert.h>
+#include <csg/core/utility.h>
+
+#if !defined(CSG_BITSTRING_NO_SIMD)
+#if defined(__AVX2__)
+#define CSG_BITSTRING_AVX2 1
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#define CSG_BITSTRING_SSE41 1
+#include <smmintrin.h>
+#endif
+#endif
+
+namespace csg {
+
+namespace detail {
+
+using bitstr_word = std::uint64_t;
+
+constexpr std::size_t bitstr_word_bits =
+    std::numeric_limits<bitstr_word>::digits;
+
+// Storage is always allocated in whole "blocks" of this many words, so that
+// the vector loops below never need a scalar epilogue for a partial block.
+// The unused bits in the final block are always zero.
+constexpr std::size_t bitstr_block_words = 4;
+
+// Storage is aligned to a cache line; this is stricter than the vector loads
+// require, but allows bitstrings to be used as the base level of the
+// cache-line oriented hbitmap.
+constexpr std::size_t bitstr_alloc_align =
+    std::max(util::cache_line_size, bitstr_block_words * sizeof(bitstr_word));
+
+// Returns the index of the first word in [i, end) which has any bit set (or
+// when `Invert` is true, any bit clear), or `end` if there is no such word.
+// All words in [0, end) must be readable and `end` must be a multiple of
+// bitstr_block_words.
+template <bool Invert>
+inline std::size_t bitstr_scan_words(const bitstr_word *w, std::size_t i,
+                                     std::size_t end) noexcept {
+  constexpr bitstr_word Flip = Invert ? ~bitstr_word{0} : bitstr_word{0};
+
+  // Advance to the next block boundary, so that vector loads are aligned.
+  for (; i < end && (i % bitstr_block_words); ++i) {
+    if (w[i] ^ Flip)
+      return i;
+  }
+
+#if defined(CSG_BITSTRING_AVX2)
+  const __m256i ones = _mm256_set1_epi64x(-1);
+
+  // Examine a whole cache line (two 256-bit vectors) per iteration; in sparse
+  // or dense bitmaps nearly every iteration is a miss, so it pays to combine
+  // the two vectors and perform a single test.
+  for (; i + 2 * bitstr_block_words <= end; i += 2 * bitstr_block_words) {
+    const __m256i a = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(w + i));
+    const __m256i b = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(w + i + bitstr_block_words));
+    if constexpr (Invert) {
+      if (!_mm256_testc_si256(_mm256_and_si256(a, b), ones))
+        break;
+    }
+    else {
+      const __m256i c = _mm256_or_si256(a, b);
+      if (!_mm256_testz_si256(c, c))
+        break;
+    }
+  }
+
+  for (; i < end; i += bitstr_block_words) {
+    const __m256i a = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(w + i));
+    if constexpr (Invert) {
+      if (!_mm256_testc_si256(a, ones))
+        break;
+    }
+    else if (!_mm256_testz_si256(a, a))
+      break;
+  }
+#elif defined(CSG_BITSTRING_SSE41)
+  const __m128i ones = _mm_set1_epi64x(-1);
+
+  for (; i < end; i += 2) {
+    const __m128i a = _mm_load_si128(reinterpret_cast<const __m128i *>(w + i));
+    if constexpr (Invert) {
+      if (!_mm_testc_si128(a, ones))
+        break;
+    }
+    else if (!_mm_testz_si128(a, a))
+      break;
+  }
+#endif
+
+  // Either no vector unit is available, or the vector loop above stopped on
+  // the block containing the word we're looking for.
+  for (; i < end; ++i) {
+    if (w[i] ^ Flip)
+      return i;
+  }
+
+  return end;
+}
+
+// Returns the number of set bits in the words [i, end), which must satisfy
+// the same requirements as in bitstr_scan_words.
+inline std::size_t bitstr_popcount_words(const bitstr_word *w, std::size_t i,
+                                         std::size_t end) noexcept {
+  std::size_t n = 0;
+
+  for (; i < end && (i % bitstr_block_words); ++i)
+    n += static_cast<std::size_t>(std::popcount(w[i]));
+
+#if defined(CSG_BITSTRING_AVX2)
+  // Population count using an in-register nibble lookup table (W. Mula's
+  // vpshufb algorithm); the per-byte counts are accumulated horizontally by
+  // vpsadbw into four 64-bit lanes.
+  const __m256i lookup = _mm256_setr_epi8(
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i lowMask = _mm256_set1_epi8(0x0f);
+  __m256i acc = _mm256_setzero_si256();
+
+  for (; i < end; i += bitstr_block_words) {
+    const __m256i v = _mm256_load_si256(
+        reinterpret_cast<const __m256i *>(w + i));
+    const __m256i lo = _mm256_and_si256(v, lowMask);
+    const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+    const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo),
+                                        _mm256_shuffle_epi8(lookup, hi));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+  }
+
+  alignas(32) std::uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  n += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#else
+  for (; i < end; ++i)
+    n += static_cast<std::size_t>(std::popcount(w[i]));
+#endif
+
+  return n;
+}
+
+} // End of namespace detail
+
+/**
+ * @brief Fixed-size string of bits, providing the operations of BSD's
+ *     bitstring(3) library.
+ *
+ * Bit positions are zero-based. As in bitstring(3), the ranges passed to
+ * @ref nset and @ref nclear are closed intervals, i.e., `nset(0, 3)` sets
+ * four bits. All search functions return @ref not_found (-1) if no bit (or
+ * area) satisfies the search, which corresponds to the BSD convention of
+ * storing -1 into the result pointer.
+ */
+class bitstring {
+public:
+  using word_type = detail::bitstr_word;
+  using size_type = std::size_t;
+
+  constexpr static std::ptrdiff_t not_found = -1;
+  constexpr static size_type bits_per_word = detail::bitstr_word_bits;
+
+  constexpr bitstring() noexcept : m_words{nullptr}, m_nbits{0} {}
+
+  /// Create a bit string of `nbits` bits, all clear; same as bit_alloc(3).
+  explicit bitstring(size_type nbits)
+      : m_words{allocateWords(nbits)}, m_nbits{nbits} {}
+
+  bitstring(const bitstring &other) : bitstring{other.m_nbits} {
+    std::copy_n(other.m_words, other.allocatedWords(), m_words);
+  }
+
+  bitstring(bitstring &&other) noexcept
+      : m_words{std::exchange(other.m_words, nullptr)},
+        m_nbits{std::exchange(other.m_nbits, 0)} {}
+
+  ~bitstring() { freeWords(m_words); }
+
+  bitstring &operator=(const bitstring &other) {
+    if (this != &other)
+      *this = bitstring{other};
+    return *this;
+  }
+
+  bitstring &operator=(bitstring &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  void swap(bitstring &other) noexcept {
+    std::ranges::swap(m_words, other.m_words);
+    std::ranges::swap(m_nbits, other.m_nbits);
+  }
+
+  size_type size() const noexcept { return m_nbits; }
+
+  bool empty() const noexcept { return !m_nbits; }
+
+  /// Access the underlying words; bit `i` is stored in the bit
+  /// `i % bits_per_word` of word `i / bits_per_word`.
+  std::span<word_type> words() noexcept { return {m_words, usedWords()}; }
+
+  std::span<const word_type> words() const noexcept {
+    return {m_words, usedWords()};
+  }
+
+  bool test(size_type bit) const noexcept {
+    CSG_ASSERT(bit < m_nbits, "bit %zu out of range", bit);
+    return m_words[wordIndex(bit)] & bitMask(bit);
+  }
+
+  bool operator[](size_type bit) const noexcept { return test(bit); }
+
+  void set(size_type bit) noexcept {
+    CSG_ASSERT(bit < m_nbits, "bit %zu out of range", bit);
+    m_words[wordIndex(bit)] |= bitMask(bit);
+  }
+
+  void clear(size_type bit) noexcept {
+    CSG_ASSERT(bit < m_nbits, "bit %zu out of range", bit);
+    m_words[wordIndex(bit)] &= ~bitMask(bit);
+  }
+
+  /// Set the bits in the closed interval [start, stop]; same as bit_nset(3).
+  void nset(size_type start, size_type stop) noexcept {
+    applyRange(start, stop, [](word_type &w, word_type m) { w |= m; });
+  }
+
+  /// Clear the bits in the closed interval [start, stop]; same as
+  /// bit_nclear(3).
+  void nclear(size_type start, size_type stop) noexcept {
+    applyRange(start, stop, [](word_type &w, word_type m) { w &= ~m; });
+  }
+
+  void set_all() noexcept {
+    if (m_nbits)
+      nset(0, m_nbits - 1);
+  }
+
+  void clear_all() noexcept { std::fill_n(m_words, allocatedWords(), 0); }
+
+  /// Find the first set bit; same as bit_ffs(3).
+  std::ptrdiff_t ffs() const noexcept { return ffs_at(0); }
+
+  /// Find the first clear bit; same as bit_ffc(3).
+  std::ptrdiff_t ffc() const noexcept { return ffc_at(0); }
+
+  /// Find the first set bit at or after `start`; same as bit_ffs_at(3).
+  std::ptrdiff_t ffs_at(size_type start) const noexcept {
+    return findFirst<false>(start);
+  }
+
+  /// Find the first clear bit at or after `start`; same as bit_ffc_at(3).
+  std::ptrdiff_t ffc_at(size_type start) const noexcept {
+    return findFirst<true>(start);
+  }
+
+  /// Find the first run of `n` contiguous set bits; same as bit_ffs_area(3).
+  std::ptrdiff_t ffs_area(size_type n) const noexcept {
+    return ffs_area_at(0, n);
+  }
+
+  /// Find the first run of `n` contiguous clear bits; same as
+  /// bit_ffc_area(3). This is typically used to find free space in an
+  /// allocation bitmap.
+  std::ptrdiff_t ffc_area(size_type n) const noexcept {
+    return ffc_area_at(0, n);
+  }
+
+  std::ptrdiff_t ffs_area_at(size_type start, size_type n) const noexcept {
+    return findArea<false>(start, n);
+  }
+
+  std::ptrdiff_t ffc_area_at(size_type start, size_type n) const noexcept {
+    return findArea<true>(start, n);
+  }
+
+  /// Count the number of set bits.
+  size_type count() const noexcept {
+    return detail::bitstr_popcount_words(m_words, 0, allocatedWords());
+  }
+
+  /// Count the number of set bits in the `nbits` bits beginning at `start`;
+  /// same as bit_count(3).
+  size_type count(size_type start, size_type nbits) const noexcept {
+    CSG_ASSERT(start + nbits <= m_nbits, "count range exceeds bit string");
+    if (!nbits)
+      return 0;
+
+    const size_type stop = start + nbits - 1;
+    const size_type first = wordIndex(start);
+    const size_type last = wordIndex(stop);
+    const word_type headMask = ~word_type{0} << bitOffset(start);
+    const word_type tailMask =
+        ~word_type{0} >> (bits_per_word - 1 - bitOffset(stop));
+
+    if (first == last)
+      return static_cast<size_type>(std::popcount(m_words[first] & headMask &
+                                                  tailMask));
+
+    // The middle words are not necessarily a whole number of blocks, so
+    // count whole blocks only after the first block boundary and handle the
+    // remainder by hand.
+    size_type n = static_cast<size_type>(std::popcount(m_words[first] & headMask));
+    size_type i = first + 1;
+    const size_type blockEnd = last - last % detail::bitstr_block_words;
+    if (i < blockEnd) {
+      n += detail::bitstr_popcount_words(m_words, i, blockEnd);
+      i = blockEnd;
+    }
+    for (; i < last; ++i)
+      n += static_cast<size_type>(std::popcount(m_words[i]));
+
+    return n + static_cast<size_type>(std::popcount(m_words[last] & tailMask));
+  }
+
+  bool operator==(const bitstring &other) const noexcept {
+    return m_nbits == other.m_nbits &&
+        std::equal(m_words, m_words + usedWords(), other.m_words);
+  }
+
+private:
+  static constexpr size_type wordIndex(size_type bit) noexcept {
+    return bit / bits_per_word;
+  }
+
+  static constexpr size_type bitOffset(size_type bit) noexcept {
+    return bit % bits_per_word;
+  }
+
+  static constexpr word_type bitMask(size_type bit) noexcept {
+    return word_type{1} << bitOffset(bit);
+  }
+
+  static constexpr size_type wordsFor(size_type nbits) noexcept {
+    const size_type w = (nbits + bits_per_word - 1) / bits_per_word;
+    return (w + detail::bitstr_block_words - 1) /
+        detail::bitstr_block_words * detail::bitstr_block_words;
+  }
+
+  static word_type *allocateWords(size_type nbits) {
+    const size_type n = wordsFor(nbits);
+    if (!n)
+      return nullptr;
+    auto *const w = static_cast<word_type *>(::operator new(
+        n * sizeof(word_type), std::align_val_t{detail::bitstr_alloc_align}));
+    std::fill_n(w, n, 0);
+    return w;
+  }
+
+  static void freeWords(word_type *w) noexcept {
+    if (w)
+      ::operator delete(w, std::align_val_t{detail::bitstr_alloc_align});
+  }
+
+  size_type usedWords() const noexcept {
+    return (m_nbits + bits_per_word - 1) / bits_per_word;
+  }
+
+  size_type allocatedWords() const noexcept { return wordsFor(m_nbits); }
+
+  template <typename Fn>
+  void applyRange(size_type start, size_type stop, Fn fn) noexcept {
+    CSG_ASSERT(start <= stop && stop < m_nbits, "invalid range [%zu, %zu]",
+               start, stop);
+    const size_type first = wordIndex(start);
+    const size_type last = wordIndex(stop);
+    const word_type headMask = ~word_type{0} << bitOffset(start);
+    const word_type tailMask =
+        ~word_type{0} >> (bits_per_word - 1 - bitOffset(stop));
+
+    if (first == last) {
+      fn(m_words[first], headMask & tailMask);
+      return;
+    }
+
+    fn(m_words[first], headMask);
+    for (size_type i = first + 1; i < last; ++i)
+      fn(m_words[i], ~word_type{0});
+    fn(m_words[last], tailMask);
+  }
+
+  template <bool Clear>
+  std::ptrdiff_t findFirst(size_type start) const noexcept {
+    if (start >= m_nbits)
+      return not_found;
+
+    constexpr word_type Flip = Clear ? ~word_type{0} : word_type{0};
+    size_type i = wordIndex(start);
+    const word_type w = (m_words[i] ^ Flip) & (~word_type{0} << bitOffset(start));
+
+    if (!w) {
+      const size_type end = allocatedWords();
+      i = detail::bitstr_scan_words<Clear>(m_words, i + 1, end);
+      if (i == end)
+        return not_found;
+    }
+
+    const size_type bit = i * bits_per_word +
+        static_cast<size_type>(std::countr_zero(w ? w : m_words[i] ^ Flip));
+
+    // When searching for a clear bit, the zero padding past the end of the
+    // bit string may be found; such results are out of range.
+    return bit < m_nbits ? static_cast<std::ptrdiff_t>(bit) : not_found;
+  }
+
+  template <bool Clear>
+  std::ptrdiff_t findArea(size_type start, size_type n) const noexcept {
+    if (!n)
+      return start < m_nbits ? static_cast<std::ptrdiff_t>(start) : not_found;
+
+    // Alternate between finding the start of a candidate run and finding
+    // its end (the next bit of the opposite value). Both searches use the
+    // vectorized word scanner, so long runs are skipped quickly and the
+    // cost for short runs is a couple of word operations each.
+    while (start < m_nbits && n <= m_nbits - start) {
+      const std::ptrdiff_t runStart = findFirst<Clear>(start);
+      if (runStart == not_found ||
+          n > m_nbits - static_cast<size_type>(runStart))
+        return not_found;
+
+      const std::ptrdiff_t runEnd =
+          findFirst<!Clear>(static_cast<size_type>(runStart));
+      const size_type runStop = runEnd == not_found
+          ? m_nbits : static_cast<size_type>(runEnd);
+
+      if (runStop - static_cast<size_type>(runStart) >= n)
+        return runStart;
+
+      start = runStop;
+    }
+
+    return not_found;
+  }
+
+  word_type *m_words;
+  size_type m_nbits;
+};
+
+inline void swap(bitstring &lhs, bitstring &rhs) noexcept { lhs.swap(rhs); }
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,230 @@
+//==-- csg/core/buf_ring.h - FreeBSD buf_ring(9) implementation -*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a lock-free, multi-producer ring buffer of pointers based
+ *     on FreeBSD's buf_ring(9).
+ */
+
+#ifndef CSG_CORE_BUF_RING_H
+#define CSG_CORE_BUF_RING_H
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include <csg/core/assert.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+template <typename T>
+class buf_ring;
+
+/**
+ * @brief A fixed-capacity ring of pointers with lock-free, multi-producer
+ *     enqueue and (usually) single-consumer dequeue.
+ *
+ * This is a port of FreeBSD's buf_ring(9), the ring used by network drivers
+ * to pass mbufs from the transmitting threads to a single transmit thread.
+ * Producers reserve a slot with a compare-and-swap on the producer head,
+ * store the pointer, and then publish it by advancing the producer tail in
+ * reservation order. The consumer owns the consumer indices, so dequeue_sc is
+ * wait-free. As in FreeBSD, a multi-consumer dequeue_mc is also provided,
+ * but it must not be mixed with the single-consumer operations.
+ *
+ * The producer and consumer indices live on separate cache lines (each with
+ * its own copy of the ring mask and slot pointer) so that the two sides only
+ * share a line when one of them reads the other's tail.
+ *
+ * The single-consumer peek / advance_sc / putback_sc protocol lets a
+ * consumer look at the next pointer without removing it, e.g., a driver
+ * which must first check that the hardware has room for a packet:
+ *
+ * @code
+ *   while (packet *p = ring.peek()) {
+ *     if (!hw_try_transmit(p))
+ *       break;              // leave it at the head of the ring
+ *     ring.advance_sc();
+ *   }
+ * @endcode
+ *
+ * Null pointers cannot be enqueued, since null signals an empty ring.
+ */
+template <typename T>
+class buf_ring<T *> {
+public:
+  using value_type = T *;
+  using size_type = std::size_t;
+
+  /// Create a ring with room for `count` pointers, which must be a power of
+  /// two.
+  explicit buf_ring(size_type count)
+      : m_storage{std::make_unique<value_type[]>(count)} {
+    CSG_ASSERT(std::has_single_bit(count) && count <= max_size(),
+               "buf_ring size %zu is not a power of two", count);
+    m_prod.ring = m_cons.ring = m_storage.get();
+    m_prod.mask = m_cons.mask = static_cast<std::uint32_t>(count - 1);
+  }
+
+  buf_ring(const buf_ring &) = delete;
+
+  buf_ring &operator=(const buf_ring &) = delete;
+
+  constexpr static size_type max_size() noexcept {
+    return size_type{1} << 31;
+  }
+
+  size_type capacity() const noexcept { return size_type{m_prod.mask} + 1; }
+
+  /// Multi-producer enqueue; returns false (and counts a drop) if the ring
+  /// is full.
+  bool enqueue(value_type p) noexcept {
+    CSG_ASSERT(p, "null pointers cannot be enqueued");
+    std::uint32_t head = m_prod.head.load(std::memory_order_relaxed);
+    std::uint32_t next;
+
+    do {
+      const std::uint32_t consTail =
+          m_cons.tail.load(std::memory_order_acquire);
+      if (head - consTail > m_prod.mask) {
+        m_prod.drops.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+      next = head + 1;
+    } while (!m_prod.head.compare_exchange_weak(head, next,
+                                                std::memory_order_relaxed));
+
+    m_prod.ring[head & m_prod.mask] = p;
+
+    // Enqueues which reserved earlier slots must publish them first, or the
+    // consumer could see our slot before theirs had been written. Our plain
+    // store does not continue their release sequence, so we acquire their
+    // tail: a consumer which acquires ours is then ordered after their slot
+    // writes as well.
+    util::spin_backoff backoff;
+    while (m_prod.tail.load(std::memory_order_acquire) != head)
+      backoff.pause();
+    m_prod.tail.store(next, std::memory_order_release);
+    return true;
+  }
+
+  /// Single-consumer dequeue; returns nullptr if the ring is empty.
+  value_type dequeue_sc() noexcept {
+    const std::uint32_t head = m_cons.head.load(std::memory_order_relaxed);
+    if (head == m_prod.tail.load(std::memory_order_acquire))
+      return nullptr;
+
+    value_type p = m_cons.ring[head & m_cons.mask];
+    m_cons.head.store(head + 1, std::memory_order_relaxed);
+    m_cons.tail.store(head + 1, std::memory_order_release);
+    return p;
+  }
+
+  /// Multi-consumer dequeue; returns nullptr if the ring is empty.
+  value_type dequeue_mc() noexcept {
+    std::uint32_t head = m_cons.head.load(std::memory_order_relaxed);
+    std::uint32_t next;
+
+    do {
+      if (head == m_prod.tail.load(std::memory_order_acquire))
+        return nullptr;
+      next = head + 1;
+    } while (!m_cons.head.compare_exchange_weak(head, next,
+                                                std::memory_order_relaxed));
+
+    value_type p = m_cons.ring[head & m_cons.mask];
+
+    // As in enqueue, acquire the earlier dequeues' tail, so a producer
+    // which acquires ours is ordered after their slot reads too.
+    util::spin_backoff backoff;
+    while (m_cons.tail.load(std::memory_order_acquire) != head)
+      backoff.pause();
+    m_cons.tail.store(next, std::memory_order_release);
+    return p;
+  }
+
+  /// Single-consumer: the pointer at the head of the ring, without removing
+  /// it, or nullptr if the ring is empty.
+  value_type peek() const noexcept {
+    const std::uint32_t head = m_cons.head.load(std::memory_order_relaxed);
+    if (head == m_prod.tail.load(std::memory_order_acquire))
+      return nullptr;
+    return m_cons.ring[head & m_cons.mask];
+  }
+
+  /// Single-consumer: remove the pointer returned by the last peek.
+  void advance_sc() noexcept {
+    const std::uint32_t head = m_cons.head.load(std::memory_order_relaxed);
+    CSG_ASSERT(head != m_prod.tail.load(std::memory_order_relaxed),
+               "advance_sc on empty buf_ring");
+    m_cons.head.store(head + 1, std::memory_order_relaxed);
+    m_cons.tail.store(head + 1, std::memory_order_release);
+  }
+
+  /// Single-consumer: replace the pointer returned by the last peek with
+  /// `p`, which will be returned by the next peek or dequeue_sc. This is
+  /// used when the consumer has to replace the object, e.g., with a
+  /// defragmented copy of a packet.
+  void putback_sc(value_type p) noexcept {
+    CSG_ASSERT(p, "null pointers cannot be put back");
+    const std::uint32_t head = m_cons.head.load(std::memory_order_relaxed);
+    CSG_ASSERT(head != m_prod.tail.load(std::memory_order_relaxed),
+               "putback_sc on empty buf_ring");
+    m_cons.ring[head & m_cons.mask] = p;
+  }
+
+  bool empty() const noexcept {
+    return m_cons.head.load(std::memory_order_relaxed) ==
+           m_prod.tail.load(std::memory_order_relaxed);
+  }
+
+  bool full() const noexcept {
+    return m_prod.head.load(std::memory_order_relaxed) -
+           m_cons.tail.load(std::memory_order_relaxed) > m_prod.mask;
+  }
+
+  /// The number of pointers in the ring; only a snapshot, if other threads
+  /// are using the ring.
+  size_type size() const noexcept {
+    return m_prod.tail.load(std::memory_order_relaxed) -
+           m_cons.tail.load(std::memory_order_relaxed);
+  }
+
+  /// The number of failed enqueues.
+  std::uint64_t drops() const noexcept {
+    return m_prod.drops.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct alignas(util::cache_line_size) prod_state {
+    std::atomic<std::uint32_t> head = 0;
+    std::atomic<std::uint32_t> tail = 0;
+    std::uint32_t mask;
+    value_type *ring;
+    std::atomic<std::uint64_t> drops = 0;
+  };
+
+  struct alignas(util::cache_line_size) cons_state {
+    std::atomic<std::uint32_t> head = 0;
+    std::atomic<std::uint32_t> tail = 0;
+    std::uint32_t mask;
+    value_type *ring;
+  };
+
+  prod_state m_prod;
+  cons_state m_cons;
+  std::unique_ptr<value_type[]> m_storage;
+};
+
+} // End of namespace csg
+
+#endif
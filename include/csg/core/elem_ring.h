@@ -0,0 +1,88 @@
+//==-- csg/core/elem_ring.h - ring of inline elements -----------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a ring buffer which stores trivially copyable elements in
+ *     its slots, rather than pointers to them.
+ */
+
+#ifndef CSG_CORE_ELEM_RING_H
+#define CSG_CORE_ELEM_RING_H
+
+#include <bit>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <csg/core/assert.h>
+#include <csg/core/ring.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+/**
+ * @brief A csg::ring whose slots hold trivially copyable values of type T,
+ *     modeled after DPDK's rte_ring_elem.
+ *
+ * Passing small messages through a ring of pointers costs an allocation per
+ * message and, on the consumer side, a cache miss to read it. An elem_ring
+ * stores the messages themselves in its slots, so the consumer's reads of
+ * them are the same sequential accesses as its reads of the ring. A burst
+ * is copied in at most two runs (one if it does not wrap around the end of
+ * the slots), each a single vectorized memmove, so a burst of small
+ * elements costs little more than a burst of pointers.
+ *
+ * The operations and policies are those of csg::ring, including the
+ * zero-copy ones, which let elements too large to copy cheaply be built and
+ * read in place:
+ *
+ * @code
+ *   struct order { std::uint64_t id; std::uint32_t qty; std::uint32_t px; };
+ *   csg::elem_ring<order, csg::ring_multi, csg::ring_single> orders{4096};
+ *
+ *   orders.enqueue({42, 100, 9950});
+ *   std::array<order, 32> batch;
+ *   const std::size_t n = orders.dequeue_burst(batch);
+ * @endcode
+ */
+template <typename T, ring_sync_policy Prod = ring_multi,
+          ring_sync_policy Cons = ring_multi>
+class elem_ring : public detail::ring_ops<T, Prod, Cons> {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "elem_ring elements must be trivially copyable");
+  static_assert(alignof(T) <= util::cache_line_size,
+                "elem_ring slots are only cache-line aligned");
+
+  using base = detail::ring_ops<T, Prod, Cons>;
+  using block_type = typename base::block_type;
+
+public:
+  using typename base::size_type;
+
+  /// Create a ring with `count` slots, which must be a power of two.
+  explicit elem_ring(size_type count)
+      : elem_ring{detail::make_ring_block<block_type>(count)} {
+    CSG_ASSERT(std::has_single_bit(count) && count <= base::max_size(),
+               "elem_ring size %zu is not a power of two", count);
+  }
+
+  elem_ring(const elem_ring &) = delete;
+
+  elem_ring &operator=(const elem_ring &) = delete;
+
+private:
+  explicit elem_ring(detail::ring_block_ptr<block_type> b) noexcept
+      : base{b.get()}, m_storage{std::move(b)} {}
+
+  detail::ring_block_ptr<block_type> m_storage;
+};
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,365 @@
+//==-- csg/core/epoch.h - epoch-based memory reclamation --------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains an epoch-based memory reclamation domain, modeled after
+ *     FreeBSD's epoch(9) and ConcurrencyKit's ck_epoch, which defers the
+ *     freeing of nodes unlinked from lock-free structures until no reader
+ *     can still be using them.
+ */
+
+#ifndef CSG_CORE_EPOCH_H
+#define CSG_CORE_EPOCH_H
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <csg/core/assert.h>
+#include <csg/core/membarrier.h>
+#include <csg/core/reclaim.h>
+#include <csg/core/stailq.h>
+#include <csg/core/tailq.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+class epoch;
+class epoch_guard;
+
+/**
+ * @brief The part of a node which links it onto the list of nodes waiting
+ *     for a grace period, like FreeBSD's struct epoch_context.
+ *
+ * Nodes of lock-free structures usually derive from it, so that the
+ * callback can recover the node with a static_cast.
+ */
+struct epoch_context {
+  stailq_entry<epoch_context> link;
+  void (*fn)(epoch_context *);
+  std::uint64_t epoch;  // The global epoch when the node was retired.
+};
+
+using epoch_callback_list = CSG_STAILQ_HEAD_OFFSET_T(epoch_context, link);
+
+namespace detail {
+
+// The state of one thread in one epoch domain, a record as described in
+// reclaim.h; the domain scans its records to detect grace periods. `epoch`
+// is the global epoch the thread observed when it entered its outermost
+// section, or 0 outside of sections; only the owning thread writes it, and
+// only the owning thread touches `nesting`, `retired` and `pending`.
+struct alignas(util::cache_line_size) epoch_record {
+  using domain_type = csg::epoch;
+
+  tailq_entry<epoch_record> domainLink;
+  tailq_entry<epoch_record> threadLink;
+  std::atomic<std::uint64_t> epoch = 0;
+  std::atomic<csg::epoch *> domain;  // nullptr once the domain is destroyed.
+  std::uint32_t nesting = 0;
+  std::size_t retired = 0;      // Nodes retired since the last poll.
+  epoch_callback_list pending;  // Retired nodes, oldest first.
+};
+
+using epoch_record_list = reclaim_record_list<epoch_record>;
+
+// Protects the lists of records of all domains, and their lists of nodes
+// orphaned by exited threads; taken to add or remove records, and to scan
+// them for a grace period.
+inline std::mutex &epoch_list_mutex() {
+  return reclaim_list_mutex<epoch_record>();
+}
+
+// Moves the nodes of `from` whose grace period has elapsed by `current` to
+// the back of `to`.
+inline void epoch_take_ready(epoch_callback_list &from,
+                             epoch_callback_list &to,
+                             std::uint64_t current) noexcept {
+  auto prev = from.before_begin();
+  for (auto i = from.begin(); i != from.end(); ) {
+    if (i->epoch + 2 <= current) {
+      epoch_context *const c = &*i;
+      i = from.erase_after(prev);
+      to.push_back(c);
+    }
+    else
+      prev = i++;
+  }
+}
+
+inline void epoch_run_callbacks(epoch_callback_list &ready) noexcept {
+  while (!ready.empty()) {
+    epoch_context &c = ready.front();
+    ready.pop_front();
+    c.fn(&c);
+  }
+}
+
+} // End of namespace detail
+
+/**
+ * @brief An epoch-based memory reclamation domain, modeled after FreeBSD's
+ *     epoch(9) and ConcurrencyKit's ck_epoch.
+ *
+ * Readers of a lock-free structure access it inside an epoch *section*,
+ * between @ref enter and @ref exit. A writer which unlinks a node cannot
+ * free it at once, because readers may still be using it; instead it
+ * retires the node with @ref call_epoch, which queues it (through its
+ * embedded epoch_context) on an intrusive stailq of the calling thread.
+ * The node's callback runs once a *grace period* has elapsed, i.e., once
+ * every section which was active when the node was retired has exited.
+ *
+ * The domain has a global epoch counter. Entering a section only records
+ * the current global epoch in a per-thread record, which no other thread
+ * writes, and exiting clears it, so sections are cheap and readers never
+ * write to shared cache lines. The global epoch advances by one when every
+ * thread in a section has observed its current value, which is checked by
+ * scanning the records; a node retired in epoch `e` can be freed once the
+ * global epoch reaches `e + 2`. Grace periods are detected in batches:
+ * every @ref batch_size calls to @ref call_epoch, the calling thread tries
+ * to advance the epoch and runs the callbacks of its nodes which are ready.
+ * As with rmlock, the store-load fence of a reader entering a section is
+ * made cheap by a membarrier(2) in the (rare) scans, while retiring a node
+ * pays for a full fence.
+ *
+ * Sections may be nested, and may call @ref call_epoch but not
+ * @ref wait_for_grace_period. A reader which stays in a section for a long
+ * time (e.g., by blocking) stops the epoch from advancing, so retired nodes
+ * pile up; hazard pointers do not have that problem.
+ *
+ * When a thread exits, its retired nodes are handed over to the domain, and
+ * are freed by a later batch of another thread, by @ref drain_callbacks, or
+ * by the destructor of the domain.
+ *
+ * The epoch is a reclamation_domain, so lock-free structures parameterized
+ * by their reclamation policy can use it, or a hazard_domain.
+ *
+ * @code
+ *   struct node : csg::epoch_context {
+ *     std::atomic<node *> next;
+ *     int value;
+ *   };
+ *
+ *   csg::epoch list_epoch;
+ *
+ *   bool contains(int v) {               // readers
+ *     csg::epoch_guard g{list_epoch};
+ *     for (node *n = head.load(); n; n = n->next.load())
+ *       if (n->value == v)
+ *         return true;
+ *     return false;
+ *   }
+ *
+ *   void remove(node *n) {               // a writer, after unlinking n
+ *     list_epoch.call_epoch(n, [](csg::epoch_context *c) {
+ *       delete static_cast<node *>(c);
+ *     });
+ *   }
+ * @endcode
+ */
+class epoch {
+public:
+  /// The number of nodes a thread retires between attempts to detect a
+  /// grace period and run the callbacks of the ready ones.
+  constexpr static std::size_t batch_size = 64;
+
+  using node_type = epoch_context;
+  using guard = epoch_guard;
+
+  epoch() noexcept = default;
+
+  epoch(const epoch &) = delete;
+
+  ~epoch();
+
+  epoch &operator=(const epoch &) = delete;
+
+  /// Enters a section, in which nodes retired by other threads are not
+  /// freed; sections may be nested.
+  void enter() noexcept {
+    detail::epoch_record &r = threadRecord();
+    if (r.nesting++)
+      return;
+    r.epoch.store(m_epoch.load(std::memory_order_relaxed),
+                  std::memory_order_relaxed);
+    util::asymmetric_light_fence();
+  }
+
+  void exit() noexcept {
+    detail::epoch_record &r = threadRecord();
+    CSG_ASSERT(r.nesting, "epoch section exited without being entered");
+    if (!--r.nesting)
+      r.epoch.store(0, std::memory_order_release);
+  }
+
+  /// Whether the calling thread is in a section.
+  bool in_section() noexcept { return threadRecord().nesting; }
+
+  /**
+   * @brief Retires `node`, which must no longer be reachable by readers
+   *     which enter a section from now on; `fn(node)` is called once every
+   *     section active now has exited.
+   *
+   * The callback runs in a later call to @ref call_epoch or
+   * @ref drain_callbacks, usually of the same thread, and must not throw.
+   */
+  void call_epoch(epoch_context *node, void (*fn)(epoch_context *)) noexcept {
+    detail::epoch_record &r = threadRecord();
+    node->fn = fn;
+
+    // The unlinking of the node must be visible to every thread before we
+    // read the epoch `e`: a reader which enters once the epoch has become
+    // `e + 1` (a later value of m_epoch than the one we read) must then not
+    // find the node, so only readers in epoch `e` or earlier can hold it,
+    // and they have all exited by the advance to `e + 2` (see tryAdvance).
+    // The heavy fence in tryAdvance precedes its own load of the epoch, so
+    // it cannot order our store before our load; a full fence here does,
+    // and retiring is far rarer than entering a section.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    node->epoch = m_epoch.load(std::memory_order_acquire);
+    r.pending.push_back(node);
+    if (++r.retired == batch_size) [[unlikely]]
+      poll(r);
+  }
+
+  /// call_epoch, as the reclamation_domain interface.
+  void retire(epoch_context *node, void (*fn)(epoch_context *)) noexcept {
+    call_epoch(node, fn);
+  }
+
+  /**
+   * @brief Waits until every section which is active now has exited, like
+   *     FreeBSD's epoch_wait; it must not be called from a section.
+   *
+   * The callbacks of retired nodes are not run; see @ref drain_callbacks.
+   */
+  void wait_for_grace_period() noexcept {
+    CSG_ASSERT(!in_section(), "wait_for_grace_period called in a section");
+    const std::uint64_t target = m_epoch.load(std::memory_order_acquire) + 2;
+    util::spin_backoff backoff;
+    while (m_epoch.load(std::memory_order_acquire) < target) {
+      if (!tryAdvance())
+        backoff.pause();
+    }
+  }
+
+  /// Waits for a grace period, and runs the callbacks of all the nodes
+  /// retired before the call by this thread and by exited threads.
+  void drain_callbacks() noexcept {
+    wait_for_grace_period();
+    poll(threadRecord());
+  }
+
+  /// The global epoch, for debugging; it starts at 1.
+  std::uint64_t current() const noexcept {
+    return m_epoch.load(std::memory_order_relaxed);
+  }
+
+private:
+  friend struct detail::reclaim_tls<detail::epoch_record>;
+
+  detail::epoch_record &threadRecord() noexcept {
+    return detail::reclaim_thread_record<detail::epoch_record>(
+        this, m_records, [](detail::epoch_record &) {});
+  }
+
+  // Takes over the nodes retired by an exiting thread; called with the list
+  // mutex held.
+  void detachThread(detail::epoch_record &r) noexcept {
+    m_records.erase(m_records.iter(&r));
+    m_orphans.splice_after(m_orphans.cbefore_end(), r.pending);
+  }
+
+  // Advances the global epoch if every thread in a section has observed its
+  // current value; returns false if a thread has not. A node unlinked and
+  // retired in epoch `e` (as read after the unlinking) may be held by a
+  // reader in epoch `e` or earlier, but not by one which entered after the
+  // epoch became `e + 1`; the advance to `e + 2` requires all the former
+  // to have exited.
+  bool tryAdvance() noexcept {
+    util::asymmetric_heavy_fence();
+    std::uint64_t e = m_epoch.load(std::memory_order_acquire);
+    {
+      const std::lock_guard lock{detail::epoch_list_mutex()};
+      for (const detail::epoch_record &r : m_records) {
+        const std::uint64_t observed = r.epoch.load(std::memory_order_acquire);
+        if (observed && observed != e)
+          return false;
+      }
+    }
+    m_epoch.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel);
+    return true;
+  }
+
+  void poll(detail::epoch_record &r) noexcept {
+    tryAdvance();
+
+    const std::uint64_t e = m_epoch.load(std::memory_order_acquire);
+    epoch_callback_list ready;
+    detail::epoch_take_ready(r.pending, ready, e);
+    {
+      const std::lock_guard lock{detail::epoch_list_mutex()};
+      detail::epoch_take_ready(m_orphans, ready, e);
+    }
+    r.retired = 0;
+    detail::epoch_run_callbacks(ready);
+  }
+
+  alignas(util::cache_line_size) std::atomic<std::uint64_t> m_epoch = 1;
+  detail::epoch_record_list m_records;  // Protected by epoch_list_mutex.
+  epoch_callback_list m_orphans;        // Protected by epoch_list_mutex.
+};
+
+/// Keeps the calling thread in a section of an epoch domain for its
+/// lifetime, like std::lock_guard.
+class epoch_guard {
+public:
+  explicit epoch_guard(epoch &e) noexcept : m_epoch{e} { m_epoch.enter(); }
+
+  epoch_guard(const epoch_guard &) = delete;
+
+  ~epoch_guard() { m_epoch.exit(); }
+
+  epoch_guard &operator=(const epoch_guard &) = delete;
+
+  /// Loads a pointer to a node, which stays valid for the lifetime of the
+  /// guard; the slot is ignored, since the section protects every node.
+  template <std::derived_from<epoch_context> T>
+  T *protect(const std::atomic<T *> &src, std::size_t = 0) const noexcept {
+    return src.load(std::memory_order_acquire);
+  }
+
+private:
+  epoch &m_epoch;
+};
+
+inline epoch::~epoch() {
+  // No thread may be using the domain any longer, so every retired node
+  // can be freed at once.
+  epoch_callback_list ready;
+  {
+    const std::lock_guard lock{detail::epoch_list_mutex()};
+    detail::reclaim_orphan_records(m_records, [&](detail::epoch_record &r) {
+      CSG_ASSERT(!r.epoch.load(std::memory_order_relaxed),
+                 "epoch destroyed while a thread is in a section");
+      ready.splice_after(ready.cbefore_end(), r.pending);
+    });
+    ready.splice_after(ready.cbefore_end(), m_orphans);
+  }
+  detail::epoch_run_callbacks(ready);
+}
+
+static_assert(reclamation_domain<epoch>);
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,70 @@
+//==-- csg/core/futex.h - futex wait and wake -------------------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains thin wrappers around the Linux futex(2) system call, used
+ *     to put threads to sleep on a 32-bit atomic word.
+ *
+ * Unlike std::atomic<T>::wait, these use "shared" futexes, so a thread can
+ * wait on a word in memory shared with another process (e.g., the index of a
+ * ring in a shm_open(3) mapping) and be woken by a thread of that process.
+ * On other systems, they fall back to std::atomic<T>::wait and notify, which
+ * only work within one process.
+ */
+
+#ifndef CSG_CORE_FUTEX_H
+#define CSG_CORE_FUTEX_H
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace csg::util {
+
+/// If `word` still holds `expected`, sleep until woken by futex_wake; may
+/// also return spuriously, so callers must recheck their condition.
+inline void futex_wait(const std::atomic<std::uint32_t> &word,
+                       std::uint32_t expected) noexcept {
+#if defined(__linux__)
+  ::syscall(SYS_futex, reinterpret_cast<const std::uint32_t *>(&word),
+            FUTEX_WAIT, expected, nullptr, nullptr, 0);
+#else
+  word.wait(expected, std::memory_order_relaxed);
+#endif
+}
+
+/// Wake up to `count` threads sleeping in futex_wait on `word`.
+inline void futex_wake(const std::atomic<std::uint32_t> &word,
+                       int count) noexcept {
+#if defined(__linux__)
+  ::syscall(SYS_futex, reinterpret_cast<const std::uint32_t *>(&word),
+            FUTEX_WAKE, count, nullptr, nullptr, 0);
+#else
+  auto &w = const_cast<std::atomic<std::uint32_t> &>(word);
+  count == 1 ? w.notify_one() : w.notify_all();
+#endif
+}
+
+inline void futex_wake_all(const std::atomic<std::uint32_t> &word) noexcept {
+  futex_wake(word, std::numeric_limits<int>::max());
+}
+
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t) &&
+              std::atomic<std::uint32_t>::is_always_lock_free,
+              "futex words must be plain 32-bit integers");
+
+} // End of namespace csg::util
+
+#endif
@@ -0,0 +1,350 @@
+//==-- csg/core/hazard.h - hazard pointer memory reclamation ----*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a hazard pointer domain, which defers the freeing of nodes
+ *     unlinked from lock-free structures until no reader has announced
+ *     that it is using them.
+ */
+
+#ifndef CSG_CORE_HAZARD_H
+#define CSG_CORE_HAZARD_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <csg/core/assert.h>
+#include <csg/core/membarrier.h>
+#include <csg/core/reclaim.h>
+#include <csg/core/slist.h>
+#include <csg/core/tailq.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+class hazard_domain;
+class hazard_guard;
+
+/**
+ * @brief The part of a node which links it onto a list of retired nodes,
+ *     the hazard pointer counterpart of epoch_context.
+ */
+struct hazard_context {
+  slist_entry<hazard_context> link;
+  void (*fn)(hazard_context *);
+};
+
+using hazard_retired_list = CSG_SLIST_HEAD_OFFSET_T(hazard_context, link);
+
+namespace detail {
+
+// The state of one thread in one hazard pointer domain, a record as
+// described in reclaim.h; the domain scans the hazard slots of its records
+// before it frees retired nodes. Only the owning thread writes the slots,
+// and only the owning thread touches the other members.
+struct alignas(util::cache_line_size) hazard_record {
+  using domain_type = hazard_domain;
+
+  constexpr static std::size_t slots = 8;
+
+  tailq_entry<hazard_record> domainLink;
+  tailq_entry<hazard_record> threadLink;
+  std::atomic<hazard_domain *> domain;  // nullptr once it is destroyed.
+  std::atomic<const hazard_context *> hazards[slots];
+  std::uint32_t used = 0;               // A bit per slot taken.
+  std::size_t retiredCount = 0;
+  std::size_t nextScan = 0;             // The retiredCount to scan at.
+  hazard_retired_list retired;
+};
+
+using hazard_record_list = reclaim_record_list<hazard_record>;
+
+// Protects the lists of records of all domains, and their lists of nodes
+// orphaned by exited threads; taken to add or remove records, and to
+// collect the hazards of a domain.
+inline std::mutex &hazard_list_mutex() {
+  return reclaim_list_mutex<hazard_record>();
+}
+
+// Moves every node of `from` to the front of `to`. The whole-list form of
+// splice_after would replace the nodes of `to` after the position, rather
+// than keep them, so the range form is used.
+inline void hazard_splice(hazard_retired_list &to,
+                          hazard_retired_list &from) noexcept {
+  to.splice_after(to.cbefore_begin(), from, from.cbefore_begin(), from.cend());
+}
+
+} // End of namespace detail
+
+/**
+ * @brief A hazard pointer domain, after Michael's "Hazard Pointers: Safe
+ *     Memory Reclamation for Lock-Free Objects".
+ *
+ * Before a reader dereferences a pointer to a node of a lock-free
+ * structure, it publishes the pointer in a *hazard slot* of its own with a
+ * hazard_pointer, and checks that the node is still reachable. A writer
+ * which unlinks a node passes it to @ref retire, which links it (through
+ * its embedded hazard_context) onto an intrusive slist of the calling
+ * thread. Once a thread has retired @ref scan_threshold nodes since its
+ * last scan, it collects the hazard slots of all threads and calls the
+ * callbacks of its retired nodes which no slot holds.
+ *
+ * Unlike with an epoch, a reader which stalls (e.g., blocks on I/O while it
+ * holds a hazard pointer) keeps only the nodes it protects from being
+ * freed, so the number of retired nodes which are not yet freed is bounded
+ * by the number of hazard slots plus the scan threshold of each thread. In
+ * exchange, readers execute a store and a (light) fence for each node they
+ * visit, rather than once per section, and each thread has at most
+ * `detail::hazard_record::slots` (8) hazard pointers at once.
+ *
+ * When a thread exits, its retired nodes are handed over to the domain, and
+ * are freed by a later scan of another thread, or by the destructor of the
+ * domain. The domain is a reclamation_domain, so lock-free structures
+ * parameterized by their reclamation policy can use it, or an epoch.
+ *
+ * @code
+ *   struct node : csg::hazard_context {
+ *     std::atomic<node *> next;
+ *     int value;
+ *   };
+ *
+ *   csg::hazard_domain list_hazards;
+ *
+ *   int first_value() {                  // readers
+ *     csg::hazard_pointer hp{list_hazards};
+ *     node *const n = hp.protect(head);
+ *     return n ? n->value : -1;
+ *   }
+ *
+ *   void remove(node *n) {               // a writer, after unlinking n
+ *     list_hazards.retire(n, [](csg::hazard_context *c) {
+ *       delete static_cast<node *>(c);
+ *     });
+ *   }
+ * @endcode
+ */
+class hazard_domain {
+public:
+  constexpr static std::size_t default_scan_threshold = 64;
+
+  using node_type = hazard_context;
+  using guard = hazard_guard;
+
+  explicit hazard_domain(std::size_t scanThreshold =
+                             default_scan_threshold) noexcept
+      : m_scanThreshold{std::max<std::size_t>(scanThreshold, 1)} {}
+
+  hazard_domain(const hazard_domain &) = delete;
+
+  ~hazard_domain();
+
+  hazard_domain &operator=(const hazard_domain &) = delete;
+
+  /**
+   * @brief Retires `node`, which must no longer be reachable from the
+   *     structure; `fn(node)` is called once no hazard pointer holds it.
+   *
+   * The callback runs in a later scan, usually of the same thread, and must
+   * not throw.
+   */
+  void retire(hazard_context *node, void (*fn)(hazard_context *)) noexcept {
+    detail::hazard_record &r = threadRecord();
+    node->fn = fn;
+    r.retired.push_front(node);
+    if (++r.retiredCount >= r.nextScan) [[unlikely]]
+      scan(r);
+  }
+
+  /// Frees every node retired by this thread or by exited threads which no
+  /// hazard pointer holds.
+  void reclaim() noexcept { scan(threadRecord()); }
+
+  /// The number of nodes retired by this thread which are not yet freed.
+  std::size_t retired_count() noexcept { return threadRecord().retiredCount; }
+
+  std::size_t scan_threshold() const noexcept { return m_scanThreshold; }
+
+private:
+  friend class hazard_pointer;
+  friend struct detail::reclaim_tls<detail::hazard_record>;
+
+  detail::hazard_record &threadRecord() noexcept {
+    return detail::reclaim_thread_record<detail::hazard_record>(
+        this, m_records,
+        [this](detail::hazard_record &r) { r.nextScan = m_scanThreshold; });
+  }
+
+  // Takes over the nodes retired by an exiting thread; called with the list
+  // mutex held.
+  void detachThread(detail::hazard_record &r) noexcept {
+    m_records.erase(m_records.iter(&r));
+    detail::hazard_splice(m_orphans, r.retired);
+  }
+
+  void scan(detail::hazard_record &r) noexcept;
+
+  std::size_t m_scanThreshold;
+  detail::hazard_record_list m_records;  // Protected by hazard_list_mutex.
+  hazard_retired_list m_orphans;         // Protected by hazard_list_mutex.
+};
+
+/**
+ * @brief Owns one hazard slot of the calling thread, in which it publishes
+ *     the node it protects; like a lock guard, it must be destroyed by the
+ *     thread which constructed it.
+ */
+class hazard_pointer {
+public:
+  explicit hazard_pointer(hazard_domain &d) noexcept
+      : m_record{&d.threadRecord()} {
+    const unsigned slot = static_cast<unsigned>(std::countr_one(m_record->used));
+    if (slot >= detail::hazard_record::slots) {
+      CSG_ASSERT(false, "more than %zu hazard pointers in one thread",
+                 detail::hazard_record::slots);
+      std::terminate();
+    }
+    m_record->used |= std::uint32_t{1} << slot;
+    m_slot = &m_record->hazards[slot];
+  }
+
+  hazard_pointer(const hazard_pointer &) = delete;
+
+  ~hazard_pointer() {
+    reset();
+    m_record->used &= ~(std::uint32_t{1} << (m_slot - m_record->hazards));
+  }
+
+  hazard_pointer &operator=(const hazard_pointer &) = delete;
+
+  /// Loads the pointer in `src` and protects the node it points to, which
+  /// stays valid until the hazard pointer protects another node, is reset,
+  /// or is destroyed.
+  template <std::derived_from<hazard_context> T>
+  T *protect(const std::atomic<T *> &src) noexcept {
+    T *p = src.load(std::memory_order_relaxed);
+    for (;;) {
+      // The node is safe only if it is still reachable after the hazard is
+      // visible to scans (which fence heavily before reading the slots).
+      m_slot->store(p, std::memory_order_relaxed);
+      util::asymmetric_light_fence();
+      T *const q = src.load(std::memory_order_acquire);
+      if (q == p) [[likely]]
+        return p;
+      p = q;
+    }
+  }
+
+  void reset() noexcept { m_slot->store(nullptr, std::memory_order_release); }
+
+private:
+  detail::hazard_record *m_record;
+  std::atomic<const hazard_context *> *m_slot;
+};
+
+/// The guard of a hazard_domain as a reclamation_domain, which owns
+/// reclaim_guard_slots hazard pointers.
+class hazard_guard {
+public:
+  explicit hazard_guard(hazard_domain &d) noexcept
+      : m_pointers{hazard_pointer{d}, hazard_pointer{d}} {}
+
+  template <std::derived_from<hazard_context> T>
+  T *protect(const std::atomic<T *> &src, std::size_t slot) noexcept {
+    CSG_ASSERT(slot < reclaim_guard_slots, "bad hazard slot %zu", slot);
+    return m_pointers[slot].protect(src);
+  }
+
+private:
+  static_assert(reclaim_guard_slots == 2);
+  hazard_pointer m_pointers[reclaim_guard_slots];
+};
+
+inline hazard_domain::~hazard_domain() {
+  // No thread may be using the domain any longer, so every retired node
+  // can be freed at once.
+  hazard_retired_list ready;
+  {
+    const std::lock_guard lock{detail::hazard_list_mutex()};
+    detail::reclaim_orphan_records(m_records, [&](detail::hazard_record &r) {
+      CSG_ASSERT(!r.used, "hazard_domain destroyed with hazard pointers");
+      detail::hazard_splice(ready, r.retired);
+      r.retiredCount = 0;
+    });
+    detail::hazard_splice(ready, m_orphans);
+  }
+
+  while (!ready.empty()) {
+    hazard_context &c = ready.front();
+    ready.pop_front();
+    c.fn(&c);
+  }
+}
+
+inline void hazard_domain::scan(detail::hazard_record &r) noexcept {
+  // The retired nodes were unlinked before now, so a reader which has not
+  // published a hazard to one of them by the time of the fence will not
+  // find it reachable when it checks.
+  util::asymmetric_heavy_fence();
+
+  std::vector<const hazard_context *> hazards;
+  try {
+    const std::lock_guard lock{detail::hazard_list_mutex()};
+    detail::hazard_splice(r.retired, m_orphans);
+    for (const detail::hazard_record &h : m_records) {
+      for (const auto &slot : h.hazards) {
+        if (const hazard_context *const p =
+                slot.load(std::memory_order_acquire))
+          hazards.push_back(p);
+      }
+    }
+  }
+  catch (const std::bad_alloc &) {
+    // Try again after the next batch of retired nodes.
+    r.nextScan = r.retiredCount + m_scanThreshold;
+    return;
+  }
+  std::sort(hazards.begin(), hazards.end());
+
+  hazard_retired_list kept;
+  hazard_retired_list ready;
+  std::size_t keptCount = 0;
+  while (!r.retired.empty()) {
+    hazard_context &c = r.retired.front();
+    r.retired.pop_front();
+    if (std::binary_search(hazards.begin(), hazards.end(), &c)) {
+      kept.push_front(&c);
+      ++keptCount;
+    }
+    else
+      ready.push_front(&c);
+  }
+  r.retired.swap(kept);
+  r.retiredCount = keptCount;
+  r.nextScan = keptCount + m_scanThreshold;
+
+  while (!ready.empty()) {
+    hazard_context &c = ready.front();
+    ready.pop_front();
+    c.fn(&c);
+  }
+}
+
+static_assert(reclamation_domain<hazard_domain>);
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,232 @@
+//==-- csg/core/hbitmap.h - two-level hierarchical bitmap -------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a two-level hierarchical bitmap for fast scans of large,
+ *     sparse bit sets, inspired by DPDK's rte_bitmap.
+ */
+
+#ifndef CSG_CORE_HBITMAP_H
+#define CSG_CORE_HBITMAP_H
+
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <span>
+
+#include <csg/core/assert.h>
+#include <csg/core/bitstring.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+/**
+ * @brief A bit set with a summary level, where each summary bit records
+ *     whether a cache line of the base level contains any set bits.
+ *
+ * Setting or clearing a bit is O(1): set always sets the summary bit, and
+ * clear only clears it after checking that the rest of the base cache line
+ * is empty (eight words). Scans for set bits consult the summary level first
+ * so that empty cache lines are never loaded; in a 16 Mbit bitmap the summary
+ * is only 4 KiB, and it is itself scanned with the vectorized bitstring
+ * scanner.
+ *
+ * This makes hbitmap suitable as the "ready set" of large schedulers and
+ * allocators, where few bits are set at any time and the common operation is
+ * "find the next set bit after this one." Like rte_bitmap, it is not
+ * thread-safe.
+ */
+class hbitmap {
+public:
+  using word_type = bitstring::word_type;
+  using size_type = std::size_t;
+
+  constexpr static std::ptrdiff_t not_found = bitstring::not_found;
+  constexpr static size_type bits_per_word = bitstring::bits_per_word;
+  constexpr static size_type words_per_line =
+      util::cache_line_size / sizeof(word_type);
+  constexpr static size_type bits_per_line = util::cache_line_size * CHAR_BIT;
+
+  class iterator;
+  using const_iterator = iterator;
+
+  hbitmap() = default;
+
+  /// Create an hbitmap of `nbits` bits, all clear.
+  explicit hbitmap(size_type nbits)
+      : m_bits{nbits}, m_summary{(nbits + bits_per_line - 1) / bits_per_line} {}
+
+  hbitmap(const hbitmap &) = default;
+  hbitmap(hbitmap &&) noexcept = default;
+  ~hbitmap() = default;
+
+  hbitmap &operator=(const hbitmap &) = default;
+  hbitmap &operator=(hbitmap &&) noexcept = default;
+
+  void swap(hbitmap &other) noexcept {
+    m_bits.swap(other.m_bits);
+    m_summary.swap(other.m_summary);
+  }
+
+  size_type size() const noexcept { return m_bits.size(); }
+
+  /// The base level bit string.
+  const bitstring &bits() const noexcept { return m_bits; }
+
+  /// The summary level bit string; bit `i` is set if and only if any bit in
+  /// the range [i * bits_per_line, (i + 1) * bits_per_line) is set.
+  const bitstring &summary() const noexcept { return m_summary; }
+
+  bool test(size_type bit) const noexcept { return m_bits.test(bit); }
+
+  bool operator[](size_type bit) const noexcept { return test(bit); }
+
+  void set(size_type bit) noexcept {
+    m_bits.set(bit);
+    m_summary.set(bit / bits_per_line);
+  }
+
+  void clear(size_type bit) noexcept {
+    m_bits.clear(bit);
+    const size_type line = bit / bits_per_line;
+    if (lineEmpty(line))
+      m_summary.clear(line);
+  }
+
+  void clear_all() noexcept {
+    m_bits.clear_all();
+    m_summary.clear_all();
+  }
+
+  bool any() const noexcept { return m_summary.ffs() != not_found; }
+
+  bool none() const noexcept { return !any(); }
+
+  size_type count() const noexcept { return m_bits.count(); }
+
+  /// Find the first set bit.
+  std::ptrdiff_t ffs() const noexcept { return ffs_at(0); }
+
+  /// Find the first set bit at or after `start`, skipping empty cache lines
+  /// of the base level without reading them.
+  std::ptrdiff_t ffs_at(size_type start) const noexcept {
+    if (start >= size())
+      return not_found;
+
+    size_type line = start / bits_per_line;
+    if (m_summary.test(line)) {
+      if (const std::ptrdiff_t bit = scanLine(line, start); bit != not_found)
+        return bit;
+    }
+
+    const std::ptrdiff_t next = m_summary.ffs_at(line + 1);
+    if (next == not_found)
+      return not_found;
+
+    line = static_cast<size_type>(next);
+    return scanLine(line, line * bits_per_line);
+  }
+
+  iterator begin() const noexcept;
+  iterator end() const noexcept;
+
+private:
+  std::span<const word_type> lineWords(size_type line) const noexcept {
+    const auto words = m_bits.words();
+    const size_type first = line * words_per_line;
+    return words.subspan(first, std::min(words_per_line,
+                                         words.size() - first));
+  }
+
+  bool lineEmpty(size_type line) const noexcept {
+    word_type any = 0;
+    for (const word_type w : lineWords(line))
+      any |= w;
+    return !any;
+  }
+
+  // Find the first set bit at or after `start` in the given line, which must
+  // contain `start`.
+  std::ptrdiff_t scanLine(size_type line, size_type start) const noexcept {
+    const auto words = lineWords(line);
+    size_type i = (start / bits_per_word) % words_per_line;
+    word_type w = words[i] & (~word_type{0} << (start % bits_per_word));
+
+    while (!w) {
+      if (++i == words.size())
+        return not_found;
+      w = words[i];
+    }
+
+    return static_cast<std::ptrdiff_t>(line * bits_per_line +
+        i * bits_per_word + static_cast<size_type>(std::countr_zero(w)));
+  }
+
+  bitstring m_bits;
+  bitstring m_summary;
+};
+
+/// Forward iterator over the positions of the set bits in an hbitmap.
+class hbitmap::iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = size_type;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const size_type *;
+  using reference = size_type;
+
+  constexpr iterator() noexcept : m_bitmap{nullptr}, m_pos{not_found} {}
+
+  reference operator*() const noexcept {
+    CSG_ASSERT(m_pos != not_found, "end() iterator dereferenced");
+    return static_cast<size_type>(m_pos);
+  }
+
+  iterator &operator++() noexcept {
+    CSG_ASSERT(m_pos != not_found, "end() iterator incremented");
+    m_pos = m_bitmap->ffs_at(static_cast<size_type>(m_pos) + 1);
+    return *this;
+  }
+
+  iterator operator++(int) noexcept {
+    auto i = *this;
+    ++*this;
+    return i;
+  }
+
+  bool operator==(const iterator &rhs) const noexcept {
+    return m_pos == rhs.m_pos;
+  }
+
+private:
+  friend class hbitmap;
+
+  iterator(const hbitmap *b, std::ptrdiff_t pos) noexcept
+      : m_bitmap{b}, m_pos{pos} {}
+
+  const hbitmap *m_bitmap;
+  std::ptrdiff_t m_pos;
+};
+
+inline hbitmap::iterator hbitmap::begin() const noexcept {
+  return {this, ffs()};
+}
+
+inline hbitmap::iterator hbitmap::end() const noexcept {
+  return {this, not_found};
+}
+
+inline void swap(hbitmap &lhs, hbitmap &rhs) noexcept { lhs.swap(rhs); }
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,409 @@
+//==-- csg/core/lock_profile.h - optional lock profiling --------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains the optional lock profiler of the CSD locks, in the style
+ *     of FreeBSD's LOCK_PROFILING, which is compiled in only when
+ *     CSG_LOCK_PROFILING is non-zero.
+ */
+
+#ifndef CSG_CORE_LOCK_PROFILE_H
+#define CSG_CORE_LOCK_PROFILE_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <source_location>
+#include <vector>
+
+#include <csg/core/tailq.h>
+
+#if !defined(CSG_LOCK_PROFILING)
+#define CSG_LOCK_PROFILING 0
+#endif
+
+#if !defined(CSG_LOCK_PROFILE_SITES)
+#define CSG_LOCK_PROFILE_SITES 256
+#endif
+
+namespace csg {
+
+constexpr bool lock_profiling = CSG_LOCK_PROFILING != 0;
+
+/**
+ * @brief The statistics of one lock site, as reported by
+ *     lock_profile_snapshot.
+ *
+ * A site is a place in the source where a lock (identified by its name) is
+ * acquired. Times are in nanoseconds. The wait time of an acquisition is
+ * measured from its first failure to get the lock, so uncontended
+ * acquisitions have no wait time.
+ */
+struct lock_profile_record {
+  const char *name;
+  const char *file;
+  std::uint32_t line;
+  std::uint64_t acquisitions;
+  std::uint64_t contentions;  ///< Acquisitions which had to wait.
+  std::uint64_t hold_total;
+  std::uint64_t hold_max;
+  std::uint64_t wait_total;
+  std::uint64_t wait_max;
+};
+
+namespace detail {
+
+#if CSG_LOCK_PROFILING
+
+inline std::uint64_t lock_profile_now() noexcept {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// The counters are only written by the thread which owns the buffer; they
+// are atomic so that reports can read them while the thread runs.
+inline void lock_profile_add(std::atomic<std::uint64_t> &c,
+                             std::uint64_t v) noexcept {
+  c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+}
+
+inline void lock_profile_raise(std::atomic<std::uint64_t> &c,
+                               std::uint64_t v) noexcept {
+  if (v > c.load(std::memory_order_relaxed))
+    c.store(v, std::memory_order_relaxed);
+}
+
+struct lock_profile_site {
+  std::atomic<const char *> file = nullptr;  // Published last, with release.
+  const char *name = nullptr;
+  std::uint32_t line = 0;
+  std::atomic<std::uint64_t> acquisitions = 0;
+  std::atomic<std::uint64_t> contentions = 0;
+  std::atomic<std::uint64_t> holdTotal = 0;
+  std::atomic<std::uint64_t> holdMax = 0;
+  std::atomic<std::uint64_t> waitTotal = 0;
+  std::atomic<std::uint64_t> waitMax = 0;
+};
+
+// A lock held by the thread, whose hold time is added to its site when it
+// is released.
+struct lock_profile_held {
+  const void *lock;
+  lock_profile_site *site;
+  std::uint64_t acquired;
+};
+
+// The statistics of one thread, as a hash table of sites keyed by the
+// addresses of the lock name and source file, and the line. Buffers are
+// never freed: when a thread exits, its buffer is taken over by the next
+// new thread, which keeps adding to the same counters.
+struct lock_profile_buffer {
+  constexpr static std::size_t capacity = CSG_LOCK_PROFILE_SITES;
+  constexpr static std::size_t max_held = 16;
+
+  static_assert((capacity & (capacity - 1)) == 0,
+                "CSG_LOCK_PROFILE_SITES must be a power of two");
+
+  lock_profile_site *findSite(const char *name,
+                              const std::source_location &loc) noexcept {
+    const char *const file = loc.file_name();
+    const std::uint32_t line = loc.line();
+    const std::size_t hash = (reinterpret_cast<std::uintptr_t>(file) ^
+                              reinterpret_cast<std::uintptr_t>(name) >> 4) +
+                             line * std::size_t{0x9e3779b9};
+
+    for (std::size_t i = 0; i < capacity; ++i) {
+      lock_profile_site &s = sites[(hash + i) & (capacity - 1)];
+      const char *const f = s.file.load(std::memory_order_relaxed);
+      if (!f) {
+        s.name = name;
+        s.line = line;
+        s.file.store(file, std::memory_order_release);
+        return &s;
+      }
+      if (f == file && s.line == line && s.name == name)
+        return &s;
+    }
+
+    lock_profile_add(dropped, 1);
+    return nullptr;
+  }
+
+  tailq_entry<lock_profile_buffer> link;
+  bool inUse = true;                       // Protected by the registry mutex.
+  std::atomic<std::uint64_t> dropped = 0;  // Acquisitions of unrecorded sites.
+  std::size_t heldCount = 0;
+  lock_profile_held held[max_held];
+  lock_profile_site sites[capacity];
+};
+
+class lock_profile_registry {
+public:
+  static lock_profile_registry &instance() {
+    static lock_profile_registry r;
+    return r;
+  }
+
+  ~lock_profile_registry() {
+    while (!m_buffers.empty()) {
+      lock_profile_buffer &b = m_buffers.front();
+      m_buffers.pop_front();
+      delete &b;
+    }
+  }
+
+  lock_profile_buffer *attachThread() noexcept {
+    const std::lock_guard lock{m_mutex};
+    for (lock_profile_buffer &b : m_buffers) {
+      if (!b.inUse) {
+        b.inUse = true;
+        return &b;
+      }
+    }
+
+    auto *const b = new (std::nothrow) lock_profile_buffer;
+    if (b)
+      m_buffers.push_back(b);
+    return b;
+  }
+
+  void detachThread(lock_profile_buffer &b) noexcept {
+    const std::lock_guard lock{m_mutex};
+    b.heldCount = 0;
+    b.inUse = false;
+  }
+
+  std::vector<lock_profile_record> snapshot(std::uint64_t *dropped) const;
+
+private:
+  lock_profile_registry() = default;
+
+  mutable std::mutex m_mutex;
+  CSG_TAILQ_HEAD_OFFSET_T(lock_profile_buffer, link) m_buffers;
+};
+
+struct lock_profile_tls {
+  ~lock_profile_tls() {
+    if (buffer)
+      lock_profile_registry::instance().detachThread(*buffer);
+  }
+
+  lock_profile_buffer *get() noexcept {
+    if (!buffer) [[unlikely]]
+      buffer = lock_profile_registry::instance().attachThread();
+    return buffer;
+  }
+
+  lock_profile_buffer *buffer = nullptr;
+};
+
+inline thread_local lock_profile_tls lock_profile_thread_buffer;
+
+// One attempt to acquire a lock, on the stack of the acquiring function:
+// the lock calls `failed` each time it cannot get the lock (only the first
+// call counts), and `success` once it has it, like FreeBSD's
+// lock_profile_obtain_lock_failed and lock_profile_obtain_lock_success.
+class lock_profile_attempt {
+public:
+  void failed() noexcept {
+    if (!m_waitStart)
+      m_waitStart = lock_profile_now();
+  }
+
+  void success(const void *lock, const char *name,
+               const std::source_location &loc) noexcept {
+    lock_profile_buffer *const b = lock_profile_thread_buffer.get();
+    if (!b)
+      return;
+    lock_profile_site *const s = b->findSite(name, loc);
+    if (!s)
+      return;
+
+    const std::uint64_t now = lock_profile_now();
+    lock_profile_add(s->acquisitions, 1);
+    if (m_waitStart) {
+      lock_profile_add(s->contentions, 1);
+      lock_profile_add(s->waitTotal, now - m_waitStart);
+      lock_profile_raise(s->waitMax, now - m_waitStart);
+    }
+    if (b->heldCount < lock_profile_buffer::max_held)
+      b->held[b->heldCount++] = {lock, s, now};
+  }
+
+private:
+  std::uint64_t m_waitStart = 0;
+};
+
+inline void lock_profile_release(const void *lock) noexcept {
+  lock_profile_buffer *const b = lock_profile_thread_buffer.buffer;
+  if (!b)
+    return;
+
+  // Locks are usually released in the reverse order of acquisition.
+  for (std::size_t i = b->heldCount; i-- > 0; ) {
+    lock_profile_held &h = b->held[i];
+    if (h.lock != lock)
+      continue;
+    const std::uint64_t hold = lock_profile_now() - h.acquired;
+    lock_profile_add(h.site->holdTotal, hold);
+    lock_profile_raise(h.site->holdMax, hold);
+    h = b->held[--b->heldCount];
+    return;
+  }
+}
+
+inline std::vector<lock_profile_record>
+lock_profile_registry::snapshot(std::uint64_t *dropped) const {
+  std::vector<lock_profile_record> r;
+  *dropped = 0;
+  {
+    const std::lock_guard lock{m_mutex};
+    for (const lock_profile_buffer &b : m_buffers) {
+      *dropped += b.dropped.load(std::memory_order_relaxed);
+      for (const lock_profile_site &s : b.sites) {
+        const char *const file = s.file.load(std::memory_order_acquire);
+        if (!file)
+          continue;
+        r.push_back({s.name, file, s.line,
+                     s.acquisitions.load(std::memory_order_relaxed),
+                     s.contentions.load(std::memory_order_relaxed),
+                     s.holdTotal.load(std::memory_order_relaxed),
+                     s.holdMax.load(std::memory_order_relaxed),
+                     s.waitTotal.load(std::memory_order_relaxed),
+                     s.waitMax.load(std::memory_order_relaxed)});
+      }
+    }
+  }
+
+  // Merge the records of the same site from different threads; the same
+  // file or name may have different addresses in different translation
+  // units, so they are compared as strings.
+  const auto compare = [](const lock_profile_record &a,
+                          const lock_profile_record &b) {
+    if (const int c = std::strcmp(a.file, b.file))
+      return c;
+    if (a.line != b.line)
+      return a.line < b.line ? -1 : 1;
+    return std::strcmp(a.name, b.name);
+  };
+  std::sort(r.begin(), r.end(), [&compare](const auto &a, const auto &b) {
+    return compare(a, b) < 0;
+  });
+
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < r.size(); ++i) {
+    if (n && compare(r[n - 1], r[i]) == 0) {
+      lock_profile_record &m = r[n - 1];
+      m.acquisitions += r[i].acquisitions;
+      m.contentions += r[i].contentions;
+      m.hold_total += r[i].hold_total;
+      m.hold_max = std::max(m.hold_max, r[i].hold_max);
+      m.wait_total += r[i].wait_total;
+      m.wait_max = std::max(m.wait_max, r[i].wait_max);
+    }
+    else
+      r[n++] = r[i];
+  }
+  r.resize(n);
+
+  // The hottest sites first.
+  std::stable_sort(r.begin(), r.end(), [](const auto &a, const auto &b) {
+    return a.wait_total != b.wait_total ? a.wait_total > b.wait_total
+                                        : a.hold_total > b.hold_total;
+  });
+  return r;
+}
+
+#else
+
+class lock_profile_attempt {
+public:
+  void failed() noexcept {}
+
+  void success(const void *, const char *,
+               const std::source_location &) noexcept {}
+};
+
+inline void lock_profile_release(const void *) noexcept {}
+
+#endif
+
+} // End of namespace detail
+
+/**
+ * @brief Returns the statistics of every lock site, summed over all threads
+ *     (including exited ones) and ordered by decreasing total wait time.
+ *
+ * The counters of running threads are read while they are being updated, so
+ * the statistics of a site are consistent only if its lock is idle. Without
+ * CSG_LOCK_PROFILING, there are no statistics and the result is empty.
+ */
+inline std::vector<lock_profile_record> lock_profile_snapshot() {
+#if CSG_LOCK_PROFILING
+  std::uint64_t dropped;
+  return detail::lock_profile_registry::instance().snapshot(&dropped);
+#else
+  return {};
+#endif
+}
+
+/**
+ * @brief Writes a table of the statistics of every lock site to `out`, in
+ *     the format of FreeBSD's debug.lock.prof.stats sysctl (but with times
+ *     in nanoseconds).
+ *
+ * The columns are: the maximum and total hold time, the maximum and total
+ * wait time, the number of acquisitions, the average hold and wait time,
+ * the number of contended acquisitions, and the site, as
+ * `file:line (lock name)`.
+ */
+inline void lock_profile_report(std::FILE *out) {
+#if CSG_LOCK_PROFILING
+  std::uint64_t dropped;
+  const auto records =
+      detail::lock_profile_registry::instance().snapshot(&dropped);
+
+  std::fprintf(out, "%12s %12s %14s %14s %10s %10s %10s %10s %s\n", "max",
+               "wait_max", "total", "wait_total", "count", "avg", "wait_avg",
+               "cnt_lock", "name");
+  for (const lock_profile_record &r : records) {
+    const std::uint64_t n = std::max<std::uint64_t>(r.acquisitions, 1);
+    std::fprintf(out, "%12llu %12llu %14llu %14llu %10llu %10llu %10llu "
+                 "%10llu %s:%u (%s)\n",
+                 static_cast<unsigned long long>(r.hold_max),
+                 static_cast<unsigned long long>(r.wait_max),
+                 static_cast<unsigned long long>(r.hold_total),
+                 static_cast<unsigned long long>(r.wait_total),
+                 static_cast<unsigned long long>(r.acquisitions),
+                 static_cast<unsigned long long>(r.hold_total / n),
+                 static_cast<unsigned long long>(r.wait_total / n),
+                 static_cast<unsigned long long>(r.contentions),
+                 r.file, r.line, r.name);
+  }
+  if (dropped) {
+    std::fprintf(out, "%llu acquisitions not recorded; increase "
+                 "CSG_LOCK_PROFILE_SITES\n",
+                 static_cast<unsigned long long>(dropped));
+  }
+#else
+  std::fprintf(out, "lock profiling is disabled; compile with "
+               "CSG_LOCK_PROFILING=1\n");
+#endif
+}
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,454 @@
+//==-- csg/core/malloc_type.h - per-type memory accounting ------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a std::pmr::memory_resource adaptor which charges every
+ *     allocation to a named "malloc type," in the style of FreeBSD's
+ *     malloc(9), so that memory use can be reported per subsystem.
+ */
+
+#ifndef CSG_CORE_MALLOC_TYPE_H
+#define CSG_CORE_MALLOC_TYPE_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <csg/core/assert.h>
+#include <csg/core/bitstring.h>
+#include <csg/core/tailq.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+class malloc_type;
+class malloc_type_resource;
+
+/// Limits on the memory which may be charged to a malloc_type; zero means
+/// "no limit."
+struct malloc_type_limits {
+  /// When the usage of the type first rises above this, `on_soft_limit` is
+  /// called (if not null). Allocations still succeed.
+  std::size_t soft_limit = 0;
+
+  /// Allocations which would take the usage of the type above this throw
+  /// std::bad_alloc.
+  std::size_t hard_limit = 0;
+
+  void (*on_soft_limit)(const malloc_type &, std::size_t usage) = nullptr;
+};
+
+/// A snapshot of the statistics of a malloc_type, i.e., one row of the
+/// `vmstat -m` table.
+struct malloc_type_usage {
+  const char *name;
+  std::uint64_t in_use;          ///< Number of live allocations.
+  std::uint64_t mem_use;         ///< Bytes in live allocations.
+  std::uint64_t requests;        ///< Total number of allocations.
+  std::uint64_t limit_failures;  ///< Allocations refused by the hard limit.
+  std::uint64_t size_mask;       ///< Bit n set: a size in (2^(n-1), 2^n].
+  std::size_t soft_limit;
+  std::size_t hard_limit;
+};
+
+constexpr std::size_t max_malloc_types = 256;
+
+namespace detail {
+
+// The statistics of one type, as maintained by one thread. The counters only
+// ever have a single writer (the owning thread) so they are updated with a
+// relaxed load and store rather than a read-modify-write; they are atomic
+// only so that the report can read them while they change.
+struct malloc_type_counters {
+  std::atomic<std::uint64_t> allocated;
+  std::atomic<std::uint64_t> freed;
+  std::atomic<std::uint64_t> allocs;
+  std::atomic<std::uint64_t> frees;
+  std::atomic<std::uint64_t> sizes;
+
+  // Change in usage not yet added to the type's shared total; owner only.
+  std::int64_t unpublished;
+
+  static void bump(std::atomic<std::uint64_t> &c, std::uint64_t n) noexcept {
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  void reset() noexcept {
+    allocated.store(0, std::memory_order_relaxed);
+    freed.store(0, std::memory_order_relaxed);
+    allocs.store(0, std::memory_order_relaxed);
+    frees.store(0, std::memory_order_relaxed);
+    sizes.store(0, std::memory_order_relaxed);
+    unpublished = 0;
+  }
+};
+
+struct alignas(util::cache_line_size) malloc_type_thread_stats {
+  tailq_entry<malloc_type_thread_stats> link;
+  malloc_type_counters counters[max_malloc_types] = {};
+};
+
+struct malloc_type_tls {
+  ~malloc_type_tls();
+  std::unique_ptr<malloc_type_thread_stats> stats;
+};
+
+inline thread_local malloc_type_tls malloc_type_thread_stats_tls;
+
+// Sum of the counters of all threads which have exited; protected by the
+// registry mutex.
+struct malloc_type_totals {
+  std::uint64_t allocated = 0;
+  std::uint64_t freed = 0;
+  std::uint64_t allocs = 0;
+  std::uint64_t frees = 0;
+  std::uint64_t sizes = 0;
+
+  void add(const malloc_type_counters &c) noexcept {
+    allocated += c.allocated.load(std::memory_order_relaxed);
+    freed += c.freed.load(std::memory_order_relaxed);
+    allocs += c.allocs.load(std::memory_order_relaxed);
+    frees += c.frees.load(std::memory_order_relaxed);
+    sizes |= c.sizes.load(std::memory_order_relaxed);
+  }
+};
+
+// The process-wide list of malloc types and of the threads which have
+// charged allocations to them.
+class malloc_type_registry {
+public:
+  static malloc_type_registry &instance() {
+    static malloc_type_registry r;
+    return r;
+  }
+
+  std::uint16_t attachType(malloc_type &t);
+  void detachType(malloc_type &t) noexcept;
+
+  malloc_type_thread_stats *attachThread() noexcept;
+  void detachThread(malloc_type_thread_stats &s) noexcept;
+
+  malloc_type_usage usage(const malloc_type &t) const noexcept {
+    const std::lock_guard lock{m_mutex};
+    return sumCounters(t);
+  }
+
+  std::vector<malloc_type_usage> statistics() const;
+
+private:
+  malloc_type_registry() : m_usedIds{max_malloc_types}, m_types{} {}
+
+  // Requires m_mutex.
+  malloc_type_usage sumCounters(const malloc_type &t) const noexcept;
+
+  using thread_list_type =
+      CSG_TAILQ_HEAD_OFFSET_T(malloc_type_thread_stats, link);
+
+  mutable std::mutex m_mutex;
+  bitstring m_usedIds;
+  malloc_type *m_types[max_malloc_types];
+  thread_list_type m_threads;
+};
+
+} // End of namespace detail
+
+/**
+ * @brief A named category of memory use, such as "packet" or "session,"
+ *     to which a malloc_type_resource charges its allocations.
+ *
+ * Like a FreeBSD `MALLOC_DEFINE`, a malloc_type is usually a long-lived
+ * (often namespace scope) object; it is registered in a process-wide list
+ * when constructed, and removed when destroyed. At most max_malloc_types
+ * types may exist at once.
+ *
+ * Each thread keeps its own counters for every type, so charging an
+ * allocation performs no shared writes. To enforce limits, each thread
+ * also adds its change in usage to a shared total, but only once that change
+ * reaches @ref publish_threshold bytes (in either direction). Limits are
+ * therefore checked against a total which may lag the exact usage by less
+ * than publish_threshold bytes per thread; allocations of at least that size
+ * are always published immediately. The exact usage is reported by
+ * @ref usage and @ref malloc_type_statistics.
+ */
+class malloc_type {
+public:
+  constexpr static std::size_t publish_threshold = 64 * 1024;
+
+  explicit malloc_type(const char *name, const malloc_type_limits &limits = {})
+      : m_name{name}, m_limits{limits}, m_published{0}, m_limitFailures{0} {
+    m_id = detail::malloc_type_registry::instance().attachType(*this);
+  }
+
+  malloc_type(const malloc_type &) = delete;
+
+  ~malloc_type() { detail::malloc_type_registry::instance().detachType(*this); }
+
+  malloc_type &operator=(const malloc_type &) = delete;
+
+  const char *name() const noexcept { return m_name; }
+
+  const malloc_type_limits &limits() const noexcept { return m_limits; }
+
+  /// Exact statistics for this type, summed over all threads.
+  malloc_type_usage usage() const noexcept {
+    return detail::malloc_type_registry::instance().usage(*this);
+  }
+
+private:
+  friend class malloc_type_resource;
+  friend class detail::malloc_type_registry;
+
+  static detail::malloc_type_counters &
+  threadCounters(std::uint16_t id) noexcept {
+    auto &tls = detail::malloc_type_thread_stats_tls;
+    if (!tls.stats) [[unlikely]]
+      tls.stats.reset(detail::malloc_type_registry::instance().attachThread());
+    return tls.stats->counters[id];
+  }
+
+  // Called before the upstream allocation; returns false if the hard limit
+  // would be exceeded.
+  bool charge(std::size_t bytes) noexcept {
+    auto &c = threadCounters(m_id);
+
+    if (m_limits.hard_limit) {
+      const std::int64_t usage = m_published.load(std::memory_order_relaxed) +
+          c.unpublished + static_cast<std::int64_t>(bytes);
+      if (usage > static_cast<std::int64_t>(m_limits.hard_limit)) {
+        m_limitFailures.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    }
+
+    c.bump(c.allocated, bytes);
+    c.bump(c.allocs, 1);
+    c.sizes.store(c.sizes.load(std::memory_order_relaxed) |
+                  std::uint64_t{1} << std::bit_width(bytes ? bytes - 1 : 0),
+                  std::memory_order_relaxed);
+    c.unpublished += static_cast<std::int64_t>(bytes);
+    if (c.unpublished >= static_cast<std::int64_t>(publish_threshold))
+      publish(c);
+    return true;
+  }
+
+  void uncharge(std::size_t bytes) noexcept {
+    auto &c = threadCounters(m_id);
+    c.bump(c.freed, bytes);
+    c.bump(c.frees, 1);
+    c.unpublished -= static_cast<std::int64_t>(bytes);
+    if (c.unpublished <= -static_cast<std::int64_t>(publish_threshold))
+      publish(c);
+  }
+
+  void publish(detail::malloc_type_counters &c) noexcept {
+    const std::int64_t old =
+        m_published.fetch_add(c.unpublished, std::memory_order_relaxed);
+    const std::int64_t soft = static_cast<std::int64_t>(m_limits.soft_limit);
+
+    if (m_limits.on_soft_limit && soft && old <= soft &&
+        old + c.unpublished > soft)
+      m_limits.on_soft_limit(*this,
+                             static_cast<std::size_t>(old + c.unpublished));
+
+    c.unpublished = 0;
+  }
+
+  const char *m_name;
+  malloc_type_limits m_limits;
+  std::uint16_t m_id;
+  std::atomic<std::int64_t> m_published;
+  std::atomic<std::uint64_t> m_limitFailures;
+  detail::malloc_type_totals m_exited;
+};
+
+/**
+ * @brief A std::pmr::memory_resource which forwards to an upstream resource
+ *     and charges each allocation to a malloc_type.
+ *
+ * Any number of resources may charge the same type. If the type's hard limit
+ * would be exceeded, do_allocate throws std::bad_alloc without calling the
+ * upstream resource.
+ */
+class malloc_type_resource : public std::pmr::memory_resource {
+public:
+  explicit malloc_type_resource(malloc_type &type,
+      std::pmr::memory_resource *upstream = std::pmr::get_default_resource())
+      noexcept
+      : m_type{type}, m_upstream{upstream} {}
+
+  malloc_type_resource(const malloc_type_resource &) = delete;
+
+  malloc_type_resource &operator=(const malloc_type_resource &) = delete;
+
+  std::pmr::memory_resource *upstream_resource() const noexcept {
+    return m_upstream;
+  }
+
+  malloc_type &type() const noexcept { return m_type; }
+
+protected:
+  void *do_allocate(std::size_t bytes, std::size_t align) override {
+    if (!m_type.charge(bytes))
+      throw std::bad_alloc{};
+
+    try {
+      return m_upstream->allocate(bytes, align);
+    }
+    catch (...) {
+      m_type.uncharge(bytes);
+      throw;
+    }
+  }
+
+  void do_deallocate(void *p, std::size_t bytes, std::size_t align) override {
+    m_upstream->deallocate(p, bytes, align);
+    m_type.uncharge(bytes);
+  }
+
+  bool do_is_equal(const std::pmr::memory_resource &other) const
+      noexcept override {
+    return this == &other;
+  }
+
+private:
+  malloc_type &m_type;
+  std::pmr::memory_resource *m_upstream;
+};
+
+/// Exact statistics for all malloc types, sorted by name.
+inline std::vector<malloc_type_usage> malloc_type_statistics() {
+  return detail::malloc_type_registry::instance().statistics();
+}
+
+/// Print the statistics of all malloc types as a table, like `vmstat -m`.
+inline void dump_malloc_types(std::FILE *out) {
+  std::fprintf(out, "%16s %10s %10s %12s %10s %10s %8s  %s\n", "Type",
+               "InUse", "MemUse", "Requests", "SoftLimit", "HardLimit",
+               "Refused", "Size(s)");
+
+  for (const malloc_type_usage &u : malloc_type_statistics()) {
+    std::fprintf(out, "%16s %10llu %9lluK %12llu %9zuK %9zuK %8llu  ",
+                 u.name, static_cast<unsigned long long>(u.in_use),
+                 static_cast<unsigned long long>((u.mem_use + 1023) / 1024),
+                 static_cast<unsigned long long>(u.requests),
+                 u.soft_limit / 1024, u.hard_limit / 1024,
+                 static_cast<unsigned long long>(u.limit_failures));
+
+    const char *sep = "";
+    for (std::uint64_t m = u.size_mask; m; m &= m - 1) {
+      std::fprintf(out, "%s%llu", sep, 1ull << std::countr_zero(m));
+      sep = ",";
+    }
+    std::fputc('\n', out);
+  }
+}
+
+namespace detail {
+
+inline malloc_type_tls::~malloc_type_tls() {
+  if (stats)
+    malloc_type_registry::instance().detachThread(*stats);
+}
+
+inline std::uint16_t malloc_type_registry::attachType(malloc_type &t) {
+  const std::lock_guard lock{m_mutex};
+
+  const std::ptrdiff_t id = m_usedIds.ffc();
+  if (id == bitstring::not_found)
+    throw std::length_error{"too many malloc types"};
+
+  // A previous type with this id may have left counts behind in the
+  // per-thread statistics.
+  for (malloc_type_thread_stats &s : m_threads)
+    s.counters[id].reset();
+
+  m_usedIds.set(static_cast<std::size_t>(id));
+  m_types[id] = &t;
+  return static_cast<std::uint16_t>(id);
+}
+
+inline void malloc_type_registry::detachType(malloc_type &t) noexcept {
+  const std::lock_guard lock{m_mutex};
+  CSG_ASSERT(m_types[t.m_id] == &t, "malloc type %s not registered", t.m_name);
+  m_types[t.m_id] = nullptr;
+  m_usedIds.clear(t.m_id);
+}
+
+inline malloc_type_thread_stats *malloc_type_registry::attachThread() noexcept {
+  auto *const s = new (std::nothrow) malloc_type_thread_stats;
+  if (!s) {
+    // We are accounting for an allocation, so there is nowhere to report
+    // this failure.
+    std::terminate();
+  }
+
+  const std::lock_guard lock{m_mutex};
+  m_threads.push_back(s);
+  return s;
+}
+
+inline void
+malloc_type_registry::detachThread(malloc_type_thread_stats &s) noexcept {
+  const std::lock_guard lock{m_mutex};
+
+  for (std::ptrdiff_t id = m_usedIds.ffs(); id != bitstring::not_found;
+       id = m_usedIds.ffs_at(static_cast<std::size_t>(id) + 1)) {
+    malloc_type &t = *m_types[id];
+    malloc_type_counters &c = s.counters[id];
+    t.m_exited.add(c);
+    if (c.unpublished)
+      t.m_published.fetch_add(c.unpublished, std::memory_order_relaxed);
+  }
+
+  m_threads.erase(m_threads.iter(&s));
+}
+
+inline malloc_type_usage
+malloc_type_registry::sumCounters(const malloc_type &t) const noexcept {
+  malloc_type_totals sum = t.m_exited;
+  for (const malloc_type_thread_stats &s : m_threads)
+    sum.add(s.counters[t.m_id]);
+
+  return {t.m_name, sum.allocs - sum.frees, sum.allocated - sum.freed,
+          sum.allocs, t.m_limitFailures.load(std::memory_order_relaxed),
+          sum.sizes, t.m_limits.soft_limit, t.m_limits.hard_limit};
+}
+
+inline std::vector<malloc_type_usage>
+malloc_type_registry::statistics() const {
+  std::vector<malloc_type_usage> stats;
+  {
+    const std::lock_guard lock{m_mutex};
+    for (std::ptrdiff_t id = m_usedIds.ffs(); id != bitstring::not_found;
+         id = m_usedIds.ffs_at(static_cast<std::size_t>(id) + 1))
+      stats.push_back(sumCounters(*m_types[id]));
+  }
+
+  std::ranges::sort(stats, [](const char *a, const char *b) {
+    return std::string_view{a} < std::string_view{b};
+  }, &malloc_type_usage::name);
+  return stats;
+}
+
+} // End of namespace detail
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,344 @@
+//==-- csg/core/mcs_lock.h - MCS queue locks --------------------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains the MCS queue lock, whose waiters each spin on a node of
+ *     their own, and a cohort lock built from MCS locks, which keeps the
+ *     lock within a cluster of CPUs for a while.
+ */
+
+#ifndef CSG_CORE_MCS_LOCK_H
+#define CSG_CORE_MCS_LOCK_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <source_location>
+#include <thread>
+
+#include <sched.h>
+
+#include <csg/core/assert.h>
+#include <csg/core/lock_profile.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+class cohort_lock;
+
+namespace detail {
+
+// A waiter's place in the queue of an MCS lock. Like an slist_entry, it is
+// only a link to the next node, but it is atomic, because the next waiter
+// fills it in while the owner of the node reads it.
+struct mcs_node {
+  std::atomic<mcs_node *> next = nullptr;
+  std::atomic<std::uint32_t> waiting = 1;  // Cleared to hand the lock over.
+};
+
+} // End of namespace detail
+
+/**
+ * @brief A FIFO spin lock, from Mellor-Crummey and Scott, whose waiters each
+ *     spin on their own node rather than on the lock.
+ *
+ * A thread which finds the lock held enqueues a node allocated on its stack,
+ * by swapping it into the tail of the queue and linking it from its
+ * predecessor's node, and then spins on a flag in that node until its
+ * predecessor hands it the lock. Each waiter spins on a cache line of its
+ * own, so the owner's release only invalidates the line of the next waiter,
+ * rather than every waiter's copy of the lock as with a test-and-set lock;
+ * and the lock is granted in the order of arrival.
+ *
+ * The usual MCS lock needs the owner's node to unlock, which does not fit
+ * the standard Lockable concept. As in the K42 variant, the owner instead
+ * moves the link to its successor into a node in the lock, `m_head`, as
+ * soon as it acquires the lock, so the waiter's node is only needed while
+ * it waits, and lock() and unlock() take no node. The lock is also released
+ * without reference to the thread which acquired it, which cohort_lock
+ * relies on.
+ *
+ * The waiters spin with util::spin_backoff, and so yield their CPU after a
+ * while. The source_location parameters of the lock functions name the lock
+ * site when lock profiling is enabled (see lock_profile.h), and are
+ * otherwise unused.
+ *
+ * @code
+ *   csg::mcs_lock stats_lock{"stats"};
+ *
+ *   {
+ *     std::lock_guard guard{stats_lock};
+ *     ++stats.packets;
+ *   }
+ * @endcode
+ */
+class mcs_lock {
+public:
+  explicit mcs_lock(const char *name = "mcs_lock") noexcept : m_name{name} {}
+
+  mcs_lock(const mcs_lock &) = delete;
+
+  ~mcs_lock() {
+    CSG_ASSERT(!m_tail.load(std::memory_order_relaxed),
+               "mcs_lock %s destroyed while locked", m_name);
+  }
+
+  mcs_lock &operator=(const mcs_lock &) = delete;
+
+  const char *name() const noexcept { return m_name; }
+
+  void lock(std::source_location loc =
+                std::source_location::current()) noexcept {
+    detail::lock_profile_attempt profile;
+    if (!tryAcquire()) {
+      profile.failed();
+      acquireSlow();
+    }
+    profile.success(this, m_name, loc);
+  }
+
+  bool try_lock(std::source_location loc =
+                    std::source_location::current()) noexcept {
+    if (!tryAcquire())
+      return false;
+    detail::lock_profile_attempt{}.success(this, m_name, loc);
+    return true;
+  }
+
+  void unlock() noexcept {
+    detail::lock_profile_release(this);
+    release();
+  }
+
+  /// Whether the lock is held; only a snapshot, unless the caller holds it.
+  bool is_locked() const noexcept {
+    return m_tail.load(std::memory_order_relaxed);
+  }
+
+  /// Whether threads are waiting for the lock, which the caller must hold.
+  bool has_waiters() const noexcept {
+    return m_tail.load(std::memory_order_relaxed) != &m_head;
+  }
+
+private:
+  friend class cohort_lock;
+
+  bool tryAcquire() noexcept {
+    detail::mcs_node *expected = nullptr;
+    return m_tail.compare_exchange_strong(expected, &m_head,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  void acquireSlow() noexcept;
+
+  void release() noexcept;
+
+  const char *m_name;
+
+  // nullptr when the lock is free, &m_head when it is held and no thread
+  // waits, and the node of the last waiter otherwise.
+  alignas(util::cache_line_size) std::atomic<detail::mcs_node *> m_tail =
+      nullptr;
+
+  // m_head.next is the first waiter, once it has linked itself.
+  detail::mcs_node m_head;
+};
+
+inline void mcs_lock::acquireSlow() noexcept {
+  util::spin_backoff backoff;
+  for (;;) {
+    detail::mcs_node *prev = m_tail.load(std::memory_order_relaxed);
+    if (!prev) {
+      if (m_tail.compare_exchange_weak(prev, &m_head,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        return;
+      continue;
+    }
+
+    // Release publishes our node to the thread which links it; acquire
+    // orders our link after the predecessor's reset of m_head.next.
+    detail::mcs_node n;
+    if (!m_tail.compare_exchange_weak(prev, &n, std::memory_order_acq_rel,
+                                      std::memory_order_relaxed))
+      continue;
+    prev->next.store(&n, std::memory_order_release);
+
+    while (n.waiting.load(std::memory_order_acquire))
+      backoff.pause();
+
+    // We own the lock; move the link to our successor into m_head, so that
+    // our node can go away. If there is no successor yet, either no thread
+    // has enqueued after us and the lock now shows no waiters, or one is
+    // about to link itself to our node.
+    detail::mcs_node *succ = n.next.load(std::memory_order_acquire);
+    if (!succ) {
+      m_head.next.store(nullptr, std::memory_order_relaxed);
+      detail::mcs_node *expected = &n;
+      if (m_tail.compare_exchange_strong(expected, &m_head,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed))
+        return;
+      backoff.reset();
+      while (!(succ = n.next.load(std::memory_order_acquire)))
+        backoff.pause();
+    }
+    m_head.next.store(succ, std::memory_order_relaxed);
+    return;
+  }
+}
+
+inline void mcs_lock::release() noexcept {
+  CSG_ASSERT(m_tail.load(std::memory_order_relaxed),
+             "mcs_lock %s is not locked", m_name);
+  detail::mcs_node *succ = m_head.next.load(std::memory_order_acquire);
+  if (!succ) {
+    detail::mcs_node *expected = &m_head;
+    if (m_tail.compare_exchange_strong(expected, nullptr,
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed))
+      return;
+
+    // A waiter has enqueued, but not yet linked itself.
+    util::spin_backoff backoff;
+    while (!(succ = m_head.next.load(std::memory_order_acquire)))
+      backoff.pause();
+  }
+  succ->waiting.store(0, std::memory_order_release);
+}
+
+namespace detail {
+
+struct alignas(util::cache_line_size) cohort_cluster {
+  mcs_lock local{"cohort_lock cluster"};
+  std::uint32_t passes = 0;  // Protected by `local`, as is globalHeld.
+  bool globalHeld = false;   // Whether the owner of `local` holds m_global.
+};
+
+} // End of namespace detail
+
+/**
+ * @brief A cohort lock, from Dice, Marathe and Shavit, which hands the lock
+ *     to waiters on nearby CPUs before those on distant CPUs.
+ *
+ * The CPUs are divided into clusters of `cluster_cpus` consecutive CPU
+ * numbers, each with a local MCS lock, and a global MCS lock is taken by
+ * the cluster whose thread owns the lock. A thread takes the local lock of
+ * the cluster it runs on, and then the global lock, unless the previous
+ * owner from its cluster has passed the global lock on with the local lock.
+ * On release, the owner passes both to the next waiter of its cluster, if
+ * there is one and the cluster has not held the global lock for `batch`
+ * consecutive acquisitions; otherwise it releases the global lock, and then
+ * its local lock.
+ *
+ * So the lock and the data it protects tend to stay in the caches of one
+ * cluster, at the cost of fairness between clusters, which is bounded by
+ * the batch. The clusters are not NUMA nodes, which would require knowledge
+ * of the machine's topology; consecutive CPU numbers usually share a socket,
+ * and often a last-level cache, so this approximates a NUMA-aware lock on
+ * any machine. A thread which migrates between lock() and unlock() still
+ * releases the cluster whose lock it took.
+ *
+ * The cohort_lock meets the requirements of the standard Lockable concept.
+ */
+class cohort_lock {
+public:
+  constexpr static unsigned default_cluster_cpus = 8;
+  constexpr static std::uint32_t default_batch = 64;
+
+  explicit cohort_lock(const char *name = "cohort_lock",
+                       unsigned cluster_cpus = default_cluster_cpus,
+                       std::uint32_t batch = default_batch)
+      : m_name{name},
+        m_clusterCpus{cluster_cpus ? cluster_cpus : 1},
+        m_clusterCount{(std::max(std::thread::hardware_concurrency(), 1u) +
+                        m_clusterCpus - 1) / m_clusterCpus},
+        m_batch{batch ? batch : 1},
+        m_clusters{std::make_unique<detail::cohort_cluster[]>(
+            m_clusterCount)} {}
+
+  cohort_lock(const cohort_lock &) = delete;
+
+  cohort_lock &operator=(const cohort_lock &) = delete;
+
+  const char *name() const noexcept { return m_name; }
+
+  std::size_t cluster_count() const noexcept { return m_clusterCount; }
+
+  void lock(std::source_location loc =
+                std::source_location::current()) noexcept {
+    detail::lock_profile_attempt profile;
+    detail::cohort_cluster &c = m_clusters[currentCluster()];
+    if (!c.local.tryAcquire()) {
+      profile.failed();
+      c.local.acquireSlow();
+    }
+    if (!c.globalHeld && !m_global.tryAcquire()) {
+      profile.failed();
+      m_global.acquireSlow();
+    }
+    m_owner = &c;
+    profile.success(this, m_name, loc);
+  }
+
+  bool try_lock(std::source_location loc =
+                    std::source_location::current()) noexcept {
+    detail::cohort_cluster &c = m_clusters[currentCluster()];
+    if (!c.local.tryAcquire())
+      return false;
+    if (!c.globalHeld && !m_global.tryAcquire()) {
+      c.local.release();
+      return false;
+    }
+    m_owner = &c;
+    detail::lock_profile_attempt{}.success(this, m_name, loc);
+    return true;
+  }
+
+  void unlock() noexcept {
+    CSG_ASSERT(m_owner, "cohort_lock %s is not locked", m_name);
+    detail::lock_profile_release(this);
+    detail::cohort_cluster &c = *m_owner;
+    m_owner = nullptr;
+    if (c.local.has_waiters() && ++c.passes < m_batch)
+      c.globalHeld = true;
+    else {
+      c.passes = 0;
+      c.globalHeld = false;
+      m_global.release();
+    }
+    c.local.release();
+  }
+
+private:
+  std::size_t currentCluster() const noexcept {
+#if defined(__linux__)
+    if (const int cpu = sched_getcpu(); cpu >= 0)
+      return static_cast<unsigned>(cpu) / m_clusterCpus % m_clusterCount;
+#endif
+    return std::hash<std::thread::id>{}(std::this_thread::get_id()) %
+        m_clusterCount;
+  }
+
+  const char *m_name;
+  const unsigned m_clusterCpus;
+  const std::size_t m_clusterCount;
+  const std::uint32_t m_batch;
+  std::unique_ptr<detail::cohort_cluster[]> m_clusters;
+  detail::cohort_cluster *m_owner = nullptr;  // Protected by m_global.
+  mcs_lock m_global{"cohort_lock global"};
+};
+
+} // End of namespace csg
+
+#endif
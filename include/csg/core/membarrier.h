@@ -0,0 +1,71 @@
+//==-- csg/core/membarrier.h - asymmetric memory fences ---------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a pair of memory fences for algorithms in which one side
+ *     (e.g., readers) runs far more often than the other (e.g., writers),
+ *     built on the Linux membarrier(2) system call.
+ *
+ * Both sides of such algorithms must order a store before a later load,
+ * e.g., a reader announces itself and then checks for a writer, while the
+ * writer announces itself and then checks for readers. Normally both need a
+ * full fence. Where membarrier(2) is available, the heavy fence makes every
+ * running thread of the process execute a full fence, so the light fence
+ * only has to stop the compiler from reordering, much like the IPIs which
+ * FreeBSD's rmlock(9) writers send to the CPUs running readers.
+ * Elsewhere, both fences are full fences.
+ */
+
+#ifndef CSG_CORE_MEMBARRIER_H
+#define CSG_CORE_MEMBARRIER_H
+
+#include <atomic>
+
+#if defined(__linux__)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace csg::util {
+
+/// Whether the process is registered for expedited membarrier(2), which
+/// the first call registers it for.
+inline bool membarrier_registered() noexcept {
+#if defined(__linux__) && defined(SYS_membarrier)
+  static const bool registered = ::syscall(SYS_membarrier,
+      MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+  return registered;
+#else
+  return false;
+#endif
+}
+
+/// The fence of the frequent side; orders its stores before its loads only
+/// relative to threads executing asymmetric_heavy_fence.
+inline void asymmetric_light_fence() noexcept {
+  if (membarrier_registered())
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+  else
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+/// The fence of the infrequent side, which costs a system call (and
+/// interrupts the CPUs running other threads of the process).
+inline void asymmetric_heavy_fence() noexcept {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+#if defined(__linux__) && defined(SYS_membarrier)
+  if (membarrier_registered())
+    ::syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+#endif
+}
+
+} // End of namespace csg::util
+
+#endif
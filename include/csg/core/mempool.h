@@ -0,0 +1,833 @@
+//==-- csg/core/mempool.h - ring-based object pool --------------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a fixed-size object pool modeled after DPDK's
+ *     librte_mempool: a lock-free ring of free objects, fronted by per-thread
+ *     caches.
+ */
+
+#ifndef CSG_CORE_MEMPOOL_H
+#define CSG_CORE_MEMPOOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csg/core/assert.h>
+#include <csg/core/bitstring.h>
+#include <csg/core/ring.h>
+#include <csg/core/tailq.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+/// Options for creating a mempool.
+struct mempool_options {
+  /// The number of objects each thread keeps in its private cache; zero
+  /// disables the caches, so that every get and put uses the shared ring.
+  /// It is limited to mempool_cache::max_size (512), and to two thirds of
+  /// the size of the pool.
+  std::size_t cache_size = 256;
+
+  /// Back the pool with huge pages (MAP_HUGETLB). If none are reserved, the
+  /// pool uses normal pages, and asks for transparent huge pages instead.
+  /// A pool in shared memory only asks for transparent huge pages.
+  bool hugepages = false;
+};
+
+constexpr std::size_t max_mempools = 256;
+
+namespace detail {
+
+// A thread's cache of free objects of one pool, as in DPDK's
+// rte_mempool_cache. Only the owning thread reads or writes it; `len` is
+// atomic only so that mempool::available can read it.
+struct alignas(util::cache_line_size) mempool_cache {
+  constexpr static std::size_t max_size = 512;
+
+  std::atomic<std::uint32_t> len = 0;
+  void *objs[2 * max_size];
+};
+
+struct mempool_thread_caches {
+  tailq_entry<mempool_thread_caches> link;
+  mempool_cache *caches[max_mempools] = {};
+};
+
+struct mempool_tls {
+  ~mempool_tls();
+  std::unique_ptr<mempool_thread_caches> caches;
+};
+
+inline thread_local mempool_tls mempool_thread_caches_tls;
+
+class mempool_registry;
+
+// The part of a mempool which does not depend on its object type: its slot
+// in the registry, through which its threads' caches are found, and
+// flushed when the threads exit.
+class mempool_base {
+public:
+  mempool_base(const mempool_base &) = delete;
+
+  mempool_base &operator=(const mempool_base &) = delete;
+
+protected:
+  friend class mempool_registry;
+
+  // Leaves m_id as no_id if there are already max_mempools pools.
+  mempool_base() noexcept;
+
+  ~mempool_base() { CSG_ASSERT(m_id == no_id, "mempool still attached"); }
+
+  // Must be called by the most derived destructor, while flushCache can
+  // still be called; flushes every thread's cache of the pool.
+  void detach() noexcept;
+
+  void setCacheSize(std::size_t cacheSize) noexcept {
+    m_cacheSize = static_cast<std::uint32_t>(
+        std::min(cacheSize, mempool_cache::max_size));
+    m_flushThreshold = m_cacheSize * 3 / 2;
+  }
+
+  // Return the objects in `c` to the pool's ring. Called by the owner of
+  // `c`, or by the registry when that thread exits.
+  virtual void flushCache(mempool_cache &c) noexcept = 0;
+
+  // The calling thread's cache of this pool, or nullptr if the pool has no
+  // caches (or one could not be allocated).
+  mempool_cache *threadCache() noexcept {
+    if (!m_cacheSize)
+      return nullptr;
+    const auto &tls = mempool_thread_caches_tls;
+    if (tls.caches) [[likely]] {
+      if (mempool_cache *const c = tls.caches->caches[m_id]) [[likely]]
+        return c;
+    }
+    return attachCache();
+  }
+
+  // The number of objects in all threads' caches.
+  std::size_t cachedCount() const noexcept;
+
+  constexpr static std::uint16_t no_id = 0xffff;
+
+  std::uint32_t m_cacheSize = 0;
+  std::uint32_t m_flushThreshold = 0;
+  std::uint16_t m_id = no_id;
+  bool m_shared = false;  // The objects are in memory shared by processes.
+
+private:
+  mempool_cache *attachCache() noexcept;
+};
+
+// The process-wide list of mempools and of the threads which have caches of
+// them.
+class mempool_registry {
+public:
+  static mempool_registry &instance() {
+    static mempool_registry r;
+    return r;
+  }
+
+  std::uint16_t attachPool(mempool_base &p) noexcept;
+  void detachPool(mempool_base &p) noexcept;
+
+  mempool_cache *attachCache(mempool_base &p) noexcept;
+  void detachThread(mempool_thread_caches &t) noexcept;
+
+  std::size_t cachedCount(const mempool_base &p) const noexcept;
+
+private:
+  mempool_registry() : m_usedIds{max_mempools}, m_pools{} {
+    ::pthread_atfork(&prepareFork, &parentFork, &childFork);
+  }
+
+  // A forked child inherits copies of the caches of the calling thread,
+  // holding the same objects as the parent's. For a private pool the
+  // child's copies are its own, but the objects of a shared pool are shared
+  // with the parent, so the child must forget its copies of their caches.
+  static void prepareFork() noexcept { instance().m_mutex.lock(); }
+  static void parentFork() noexcept { instance().m_mutex.unlock(); }
+  static void childFork() noexcept;
+
+  using thread_list_type = CSG_TAILQ_HEAD_OFFSET_T(mempool_thread_caches, link);
+
+  mutable std::mutex m_mutex;
+  bitstring m_usedIds;
+  mempool_base *m_pools[max_mempools];
+  thread_list_type m_threads;
+};
+
+// The first cache line of a pool's mapping, followed by the ring_block and
+// then the objects. It lets a process attaching to a shared pool check that
+// the pool holds the objects it expects; `magic` is stored last, once the
+// pool is constructed.
+struct alignas(util::cache_line_size) mempool_header {
+  constexpr static std::uint64_t magic_value = 0x6c6f6f702d677363; // csg-pool
+  constexpr static std::uint32_t current_version = 1;
+
+  std::atomic<std::uint64_t> magic;
+  std::uint32_t version;
+  std::uint32_t object_size;
+  std::uint32_t object_align;
+  std::uint32_t count;
+  std::uint64_t objects_offset;
+  std::uint64_t mapping_size;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "a shared mempool needs address-free 64-bit atomics");
+
+// The mapping holding a pool's header, ring and objects: private and
+// anonymous, or a shared mapping of `fd`.
+struct mempool_region {
+  constexpr static std::size_t huge_page_size = std::size_t{2} << 20;
+
+  static mempool_region map(std::size_t size, bool hugepages) {
+    mempool_region r;
+#if defined(MAP_HUGETLB)
+    if (hugepages) {
+      r.size = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+      r.addr = ::mmap(nullptr, r.size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (r.addr != MAP_FAILED) {
+        r.huge = true;
+        return r;
+      }
+    }
+#endif
+
+    r.size = size;
+    r.addr = ::mmap(nullptr, r.size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (r.addr == MAP_FAILED)
+      throw std::system_error{errno, std::generic_category(), "mmap"};
+#if defined(MADV_HUGEPAGE)
+    if (hugepages)
+      ::madvise(r.addr, r.size, MADV_HUGEPAGE);
+#endif
+    return r;
+  }
+
+  // Map `size` bytes of `fd`, which the region then owns.
+  void mapShared(std::size_t length) {
+    void *const p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      throw std::system_error{errno, std::generic_category(), "mmap"};
+    addr = p;
+    size = length;
+  }
+
+  void unmap() noexcept {
+    if (addr)
+      ::munmap(addr, size);
+    if (fd != -1)
+      ::close(fd);
+    addr = nullptr;
+    fd = -1;
+  }
+
+  void *addr = nullptr;
+  std::size_t size = 0;
+  int fd = -1;
+  bool huge = false;
+};
+
+} // End of namespace detail
+
+/**
+ * @brief A pool of `count` preallocated objects of type T, modeled after
+ *     DPDK's rte_mempool.
+ *
+ * All the objects are constructed when the pool is, in a single contiguous
+ * mapping (optionally of huge pages, see mempool_options), and live until it
+ * is destroyed. @ref get takes a free object from the pool and @ref put
+ * returns it; an object keeps whatever state its last user left it in, as
+ * it does in DPDK. The free objects are kept in a lock-free csg::ring of
+ * their indices, which lives at the start of the same mapping.
+ *
+ * Each thread keeps a cache of up to one and a half times `cache_size` free
+ * objects of each pool it uses, so that most gets and puts are a few loads
+ * and stores to memory no other thread writes. A get from an empty cache
+ * refills it from the ring with `cache_size` objects, in one bulk dequeue,
+ * and a put which would take the cache above its threshold first flushes
+ * the whole cache to the ring. Bulk requests larger than the cache go to the
+ * ring directly. The caches of a thread are flushed to their pools when the
+ * thread exits, or by @ref flush_cache.
+ *
+ * Consequently a get may fail while other threads' caches still hold free
+ * objects; as with DPDK, give the pool `threads * cache_size * 1.5` more
+ * objects than will be in use at once.
+ *
+ * @code
+ *   struct alignas(64) mbuf { ... };
+ *   csg::mempool<mbuf> pool{8191, {.cache_size = 256, .hugepages = true}};
+ *
+ *   std::array<mbuf *, 32> burst;
+ *   if (pool.get_bulk(burst)) {
+ *     ...
+ *     pool.put_bulk(burst);
+ *   }
+ * @endcode
+ *
+ * Objects are packed `sizeof(T)` bytes apart; give T cache-line alignment
+ * if neighboring objects will be used by different threads.
+ *
+ * A pool of trivially copyable objects may also be placed in shared memory,
+ * with @ref create_shared (or @ref create_anonymous), and used by every
+ * process which attaches to it with @ref open_shared (or @ref attach), so
+ * that an object taken in one process can be returned by another. Its ring
+ * and objects hold no pointers, and each process may map the pool at a
+ * different address, so objects are passed between processes as handles
+ * (see @ref handle and @ref from_handle):
+ *
+ * @code
+ *   auto pool = csg::mempool<frame>::create_shared("/frames", 4096);
+ *   frame *f = pool.get();                      // in the capture process
+ *   send(pool.handle(f));
+ *
+ *   auto pool = csg::mempool<frame>::open_shared("/frames");
+ *   frame *f = pool.from_handle(receive());     // in the encoder process
+ *   pool.put(f);
+ * @endcode
+ *
+ * Each process has its own caches, flushed to the shared ring when their
+ * threads exit, when the process's mempool object is destroyed, or by
+ * @ref flush_cache; the objects cached by a process which is killed are
+ * lost to the others. A child made by fork() starts with empty caches of
+ * the shared pools, since the parent's caches hold the same objects.
+ *
+ * Errors from the system calls are thrown as std::system_error.
+ */
+template <typename T>
+  requires std::default_initializable<T> && std::is_nothrow_destructible_v<T>
+class mempool : private detail::mempool_base {
+  using header = detail::mempool_header;
+  using ring_block = detail::ring_block<std::uint32_t, ring_multi, ring_multi>;
+  using cache = detail::mempool_cache;
+
+public:
+  using value_type = T;
+  using pointer = T *;
+  using size_type = std::size_t;
+
+  /// A reference to one of the pool's objects which is valid in every
+  /// process that maps the pool.
+  using handle_type = std::uint32_t;
+
+  /// Whether pools of T may be placed in shared memory.
+  constexpr static bool shareable = std::is_trivially_copyable_v<T>;
+
+  constexpr static size_type max_size() noexcept {
+    return size_type{1} << 31;
+  }
+
+  explicit mempool(size_type count, const mempool_options &options = {})
+      : mempool{-1, count, options} {}
+
+  /// Create the shared memory object `name` (see shm_open(3)), which must
+  /// not already exist, holding a pool of `count` objects.
+  static mempool create_shared(const char *name, size_type count,
+                               const mempool_options &options = {},
+                               mode_t mode = 0600) requires shareable {
+    const int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, mode);
+    if (fd == -1)
+      throw std::system_error{errno, std::generic_category(), name};
+    try {
+      return mempool{fd, count, options};
+    }
+    catch (...) {
+      ::shm_unlink(name);
+      throw;
+    }
+  }
+
+  /// Attach to a pool made by create_shared; the cache size of the options
+  /// applies to this process's caches.
+  static mempool open_shared(const char *name,
+                             const mempool_options &options = {})
+      requires shareable {
+    const int fd = ::shm_open(name, O_RDWR, 0);
+    if (fd == -1)
+      throw std::system_error{errno, std::generic_category(), name};
+    return mempool{attach_tag{}, fd, options};
+  }
+
+  /// Remove the name of a shared pool; the pool lives on until every
+  /// process has closed it.
+  static void unlink_shared(const char *name) noexcept { ::shm_unlink(name); }
+
+#if defined(__linux__)
+  /// Create a shared pool of `count` objects in an anonymous memfd.
+  static mempool create_anonymous(size_type count,
+                                  const mempool_options &options = {})
+      requires shareable {
+    const int fd = ::memfd_create("csg-mempool", MFD_CLOEXEC);
+    if (fd == -1)
+      throw std::system_error{errno, std::generic_category(), "memfd_create"};
+    return mempool{fd, count, options};
+  }
+#endif
+
+  /// Attach to the shared pool in the memory referred to by `fd` (e.g., one
+  /// made by create_anonymous in a parent process), taking ownership of the
+  /// descriptor.
+  static mempool attach(int fd, const mempool_options &options = {})
+      requires shareable {
+    return mempool{attach_tag{}, fd, options};
+  }
+
+  ~mempool() {
+    detach();
+    if (!m_shared)
+      std::destroy_n(m_objects, m_count);
+    m_region.unmap();
+  }
+
+  /// The descriptor of a shared pool's memory, or -1 for a private pool.
+  int fd() const noexcept { return m_region.fd; }
+
+  /// The number of bytes mapped for a pool of `count` objects (before any
+  /// rounding up to huge pages).
+  static std::size_t mapping_size(size_type count) noexcept {
+    return objectsOffset(count) + count * sizeof(T);
+  }
+
+  /// The number of objects in the pool.
+  size_type capacity() const noexcept { return m_count; }
+
+  size_type cache_size() const noexcept { return m_cacheSize; }
+
+  /// Whether the pool is backed by reserved huge pages.
+  bool hugepage_backed() const noexcept { return m_region.huge; }
+
+  /// The number of free objects, in the ring or in any thread's cache; only
+  /// a snapshot, if other threads are using the pool.
+  size_type available() const noexcept {
+    return std::min<size_type>(m_ring->size() + cachedCount(), m_count);
+  }
+
+  /// The number of objects handed out by get; also only a snapshot.
+  size_type in_use() const noexcept { return m_count - available(); }
+
+  /// The handle of the object `p`, which refers to the same object in
+  /// every process which maps the pool.
+  handle_type handle(const T *p) const noexcept {
+    CSG_ASSERT(contains(p), "%p is not a mempool object", p);
+    return indexOf(p);
+  }
+
+  T *from_handle(handle_type h) const noexcept {
+    CSG_ASSERT(h < m_count, "bad mempool handle %u", h);
+    return m_objects + h;
+  }
+
+  /// Whether `p` points to one of the pool's objects.
+  bool contains(const T *p) const noexcept {
+    return p >= m_objects && p < m_objects + m_count;
+  }
+
+  /// Take a free object, or return nullptr if there is none.
+  T *get() noexcept {
+    if (cache *const c = threadCache()) [[likely]] {
+      const std::uint32_t len = c->len.load(std::memory_order_relaxed);
+      if (len) [[likely]] {
+        c->len.store(len - 1, std::memory_order_relaxed);
+        return static_cast<T *>(c->objs[len - 1]);
+      }
+    }
+
+    T *p;
+    return get_bulk(std::span{&p, 1}) ? p : nullptr;
+  }
+
+  /// Take `objs.size()` free objects, or none if there are not that many;
+  /// returns whether the objects were taken.
+  bool get_bulk(std::span<T *> objs) noexcept {
+    const std::uint32_t n = narrow(objs.size());
+    cache *const c = threadCache();
+    if (!c || n > m_cacheSize)
+      return ringGet(objs.data(), n);
+
+    std::uint32_t len = c->len.load(std::memory_order_relaxed);
+    if (len < n) {
+      // Refill the cache to `cache_size` objects beyond the request.
+      const std::uint32_t want = m_cacheSize + n - len;
+      if (!ringGet(c->objs + len, want))
+        return ringGet(objs.data(), n);
+      len += want;
+    }
+
+    // Hand out the most recently cached objects first, as they are the most
+    // likely to still be in this CPU's cache.
+    for (std::uint32_t i = 0; i < n; ++i)
+      objs[i] = static_cast<T *>(c->objs[len - 1 - i]);
+    c->len.store(len - n, std::memory_order_relaxed);
+    return true;
+  }
+
+  /// Return an object taken with get.
+  void put(T *p) noexcept {
+    CSG_ASSERT(contains(p), "%p is not a mempool object", p);
+    if (cache *const c = threadCache()) [[likely]] {
+      const std::uint32_t len = c->len.load(std::memory_order_relaxed);
+      if (len < m_flushThreshold) [[likely]] {
+        c->objs[len] = p;
+        c->len.store(len + 1, std::memory_order_relaxed);
+        return;
+      }
+    }
+    put_bulk(std::span{&p, 1});
+  }
+
+  /// Return objects taken with get.
+  void put_bulk(std::span<T *const> objs) noexcept {
+    const std::uint32_t n = narrow(objs.size());
+    cache *const c = threadCache();
+    if (!c || n > m_flushThreshold) {
+      ringPut(objs.data(), n);
+      return;
+    }
+
+    std::uint32_t len = c->len.load(std::memory_order_relaxed);
+    if (len + n > m_flushThreshold) {
+      ringPut(c->objs, len);
+      len = 0;
+    }
+    for (std::uint32_t i = 0; i < n; ++i) {
+      CSG_ASSERT(contains(objs[i]), "%p is not a mempool object", objs[i]);
+      c->objs[len + i] = objs[i];
+    }
+    c->len.store(len + n, std::memory_order_relaxed);
+  }
+
+  /// Return the objects in the calling thread's cache to the ring, e.g.,
+  /// before the thread goes idle for a long time.
+  void flush_cache() noexcept {
+    if (cache *const c = threadCache())
+      flushCache(*c);
+  }
+
+private:
+  // The ring is read and written in chunks of this many indices, through a
+  // buffer on the stack.
+  constexpr static std::uint32_t chunk_size = 64;
+
+  // Create a pool of `count` objects in a private mapping if `fd` is -1,
+  // and otherwise in the (new) shared memory object `fd`.
+  mempool(int fd, size_type count, const mempool_options &options) {
+    m_region.fd = fd;
+    m_shared = fd != -1;
+    checkAttached();
+    CSG_ASSERT(count && count <= max_size(), "bad mempool size %zu", count);
+    if (!count || count > max_size())
+      fail("mempool size", EINVAL);
+
+    const std::size_t size = mapping_size(count);
+    try {
+      if (!m_shared)
+        m_region = detail::mempool_region::map(size, options.hugepages);
+      else {
+        if (::ftruncate(fd, static_cast<off_t>(size)) == -1)
+          fail("ftruncate");
+        m_region.mapShared(size);
+#if defined(MADV_HUGEPAGE)
+        if (options.hugepages)
+          ::madvise(m_region.addr, size, MADV_HUGEPAGE);
+#endif
+      }
+
+      m_count = narrow(count);
+      m_objects = reinterpret_cast<T *>(
+          static_cast<std::byte *>(m_region.addr) + objectsOffset(count));
+      std::uninitialized_value_construct_n(m_objects, count);
+    }
+    catch (...) {
+      m_region.unmap();
+      detach();
+      throw;
+    }
+
+    header *const h = new (m_region.addr) header{};
+    h->version = header::current_version;
+    h->object_size = sizeof(T);
+    h->object_align = alignof(T);
+    h->count = m_count;
+    h->objects_offset = objectsOffset(count);
+    h->mapping_size = size;
+
+    const auto ringCount = static_cast<std::uint32_t>(std::bit_ceil(count));
+    m_ring = new (h + 1) ring_block{ringCount};
+    std::uint32_t indices[chunk_size];
+    for (std::uint32_t i = 0; i < m_count; ) {
+      const std::uint32_t n = std::min(chunk_size, m_count - i);
+      for (std::uint32_t j = 0; j < n; ++j)
+        indices[j] = i + j;
+      m_ring->enqueue(indices, n, ring_behavior::fixed);
+      i += n;
+    }
+
+    h->magic.store(header::magic_value, std::memory_order_release);
+    setCacheSize(std::min(options.cache_size, count * 2 / 3));
+  }
+
+  struct attach_tag {};
+
+  // Map the existing shared pool in `fd`, checking that it matches this type.
+  mempool(attach_tag, int fd, const mempool_options &options) {
+    m_region.fd = fd;
+    m_shared = true;
+    checkAttached();
+
+    struct stat st;
+    if (::fstat(fd, &st) == -1)
+      fail("fstat");
+    const auto size = static_cast<std::size_t>(st.st_size);
+    if (size < sizeof(header))
+      fail("mempool header", EINVAL);
+    try {
+      m_region.mapShared(size);
+    }
+    catch (...) {
+      m_region.unmap();
+      detach();
+      throw;
+    }
+
+    const auto *const h = static_cast<const header *>(m_region.addr);
+    if (h->magic.load(std::memory_order_acquire) != header::magic_value ||
+        h->version != header::current_version ||
+        h->object_size != sizeof(T) || h->object_align != alignof(T) ||
+        !h->count || h->count > max_size() ||
+        h->objects_offset != objectsOffset(h->count) ||
+        h->mapping_size != mapping_size(h->count) || size < h->mapping_size)
+      fail("mempool header", EINVAL);
+
+    m_count = h->count;
+    m_ring = std::launder(reinterpret_cast<ring_block *>(
+        static_cast<std::byte *>(m_region.addr) + sizeof(header)));
+    m_objects = std::launder(reinterpret_cast<T *>(
+        static_cast<std::byte *>(m_region.addr) + h->objects_offset));
+    setCacheSize(std::min<size_type>(options.cache_size, m_count * 2 / 3));
+  }
+
+  void checkAttached() {
+    if (m_id == no_id) {
+      m_region.unmap();
+      throw std::length_error{"too many mempools"};
+    }
+  }
+
+  // Release what a constructor has acquired so far, and throw.
+  [[noreturn]] void fail(const char *what, int error = 0) {
+    if (!error)
+      error = errno;
+    m_region.unmap();
+    detach();
+    throw std::system_error{error, std::generic_category(), what};
+  }
+
+  static std::size_t alignUp(std::size_t n, std::size_t align) noexcept {
+    return (n + align - 1) & ~(align - 1);
+  }
+
+  static std::size_t objectsOffset(size_type count) noexcept {
+    return alignUp(sizeof(header) +
+                   ring_block::allocation_size(std::bit_ceil(count)),
+                   std::max(alignof(T), util::cache_line_size));
+  }
+
+  static std::uint32_t narrow(size_type n) noexcept {
+    CSG_ASSERT(n <= max_size(), "mempool request of %zu is too large", n);
+    return static_cast<std::uint32_t>(n);
+  }
+
+  std::uint32_t indexOf(const void *p) const noexcept {
+    return static_cast<std::uint32_t>(static_cast<const T *>(p) - m_objects);
+  }
+
+  // Take `n` objects from the ring, or none.
+  template <typename Ptr>
+  bool ringGet(Ptr *objs, std::uint32_t n) noexcept {
+    std::uint32_t indices[chunk_size];
+    for (std::uint32_t done = 0; done < n; ) {
+      const std::uint32_t m = std::min(chunk_size, n - done);
+      if (!m_ring->dequeue(indices, m, ring_behavior::fixed)) {
+        // Give back what we took; the ring always has room for it.
+        ringPut(objs, done);
+        return false;
+      }
+      for (std::uint32_t i = 0; i < m; ++i)
+        objs[done + i] = m_objects + indices[i];
+      done += m;
+    }
+    return true;
+  }
+
+  template <typename Ptr>
+  void ringPut(const Ptr *objs, std::uint32_t n) noexcept {
+    std::uint32_t indices[chunk_size];
+    for (std::uint32_t done = 0; done < n; ) {
+      const std::uint32_t m = std::min(chunk_size, n - done);
+      for (std::uint32_t i = 0; i < m; ++i)
+        indices[i] = indexOf(objs[done + i]);
+      m_ring->enqueue(indices, m, ring_behavior::fixed);
+      done += m;
+    }
+  }
+
+  void flushCache(cache &c) noexcept override {
+    ringPut(c.objs, c.len.load(std::memory_order_relaxed));
+    c.len.store(0, std::memory_order_relaxed);
+  }
+
+  std::uint32_t m_count = 0;
+  detail::mempool_region m_region;
+  ring_block *m_ring = nullptr;
+  T *m_objects = nullptr;
+};
+
+namespace detail {
+
+inline mempool_tls::~mempool_tls() {
+  if (caches)
+    mempool_registry::instance().detachThread(*caches);
+}
+
+inline mempool_base::mempool_base() noexcept {
+  m_id = mempool_registry::instance().attachPool(*this);
+}
+
+inline void mempool_base::detach() noexcept {
+  if (m_id != no_id)
+    mempool_registry::instance().detachPool(*this);
+  m_id = no_id;
+}
+
+inline mempool_cache *mempool_base::attachCache() noexcept {
+  return mempool_registry::instance().attachCache(*this);
+}
+
+inline std::size_t mempool_base::cachedCount() const noexcept {
+  return m_cacheSize ? mempool_registry::instance().cachedCount(*this) : 0;
+}
+
+inline std::uint16_t mempool_registry::attachPool(mempool_base &p) noexcept {
+  const std::lock_guard lock{m_mutex};
+
+  const std::ptrdiff_t id = m_usedIds.ffc();
+  if (id == bitstring::not_found)
+    return mempool_base::no_id;
+
+  m_usedIds.set(static_cast<std::size_t>(id));
+  m_pools[id] = &p;
+  return static_cast<std::uint16_t>(id);
+}
+
+inline void mempool_registry::detachPool(mempool_base &p) noexcept {
+  const std::lock_guard lock{m_mutex};
+  CSG_ASSERT(m_pools[p.m_id] == &p, "mempool %u not registered", p.m_id);
+
+  // Return the objects cached by all threads to the ring; this matters for
+  // a shared pool, which outlives this process's use of it.
+  for (mempool_thread_caches &t : m_threads) {
+    if (mempool_cache *const c = std::exchange(t.caches[p.m_id], nullptr)) {
+      p.flushCache(*c);
+      delete c;
+    }
+  }
+
+  m_pools[p.m_id] = nullptr;
+  m_usedIds.clear(p.m_id);
+}
+
+inline mempool_cache *mempool_registry::attachCache(mempool_base &p) noexcept {
+  auto &tls = mempool_thread_caches_tls;
+  const std::lock_guard lock{m_mutex};
+
+  if (!tls.caches) {
+    tls.caches.reset(new (std::nothrow) mempool_thread_caches);
+    if (!tls.caches)
+      return nullptr;
+    m_threads.push_back(tls.caches.get());
+  }
+
+  // Without a cache, the pool's operations use the ring directly.
+  mempool_cache *&c = tls.caches->caches[p.m_id];
+  if (!c)
+    c = new (std::nothrow) mempool_cache;
+  return c;
+}
+
+inline void
+mempool_registry::detachThread(mempool_thread_caches &t) noexcept {
+  const std::lock_guard lock{m_mutex};
+
+  for (std::size_t id = 0; id < max_mempools; ++id) {
+    if (mempool_cache *const c = t.caches[id]) {
+      m_pools[id]->flushCache(*c);
+      delete c;
+    }
+  }
+
+  m_threads.erase(m_threads.iter(&t));
+}
+
+inline void mempool_registry::childFork() noexcept {
+  mempool_registry &r = instance();
+
+  for (mempool_thread_caches &t : r.m_threads) {
+    for (std::ptrdiff_t id = r.m_usedIds.ffs(); id != bitstring::not_found;
+         id = r.m_usedIds.ffs_at(static_cast<std::size_t>(id) + 1)) {
+      if (r.m_pools[id]->m_shared && t.caches[id])
+        t.caches[id]->len.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  r.m_mutex.unlock();
+}
+
+inline std::size_t
+mempool_registry::cachedCount(const mempool_base &p) const noexcept {
+  const std::lock_guard lock{m_mutex};
+
+  std::size_t n = 0;
+  for (const mempool_thread_caches &t : m_threads) {
+    if (const mempool_cache *const c = t.caches[p.m_id])
+      n += c->len.load(std::memory_order_relaxed);
+  }
+  return n;
+}
+
+} // End of namespace detail
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,193 @@
+//==-- csg/core/reclaim.h - memory reclamation policies ---------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Defines the interface shared by the memory reclamation domains
+ *     (epoch and hazard_domain), through which a lock-free structure can
+ *     be parameterized by its reclamation policy.
+ */
+
+#ifndef CSG_CORE_RECLAIM_H
+#define CSG_CORE_RECLAIM_H
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <new>
+
+#include <csg/core/tailq.h>
+
+namespace csg {
+
+/// The number of pointers a reclamation guard can protect at once, e.g.,
+/// the current and next nodes of a hand-over-hand traversal.
+constexpr std::size_t reclaim_guard_slots = 2;
+
+/**
+ * @brief A memory reclamation domain, which a lock-free structure uses to
+ *     defer the freeing of the nodes it unlinks.
+ *
+ * Nodes derive from `D::node_type`. A reader constructs a `D::guard` from
+ * the domain, and loads every pointer to a node from a `std::atomic<T *>`
+ * through `guard.protect(src, slot)`, with `slot` less than
+ * reclaim_guard_slots; the node stays valid until the slot protects another
+ * node or the guard is destroyed. A writer passes each node it has unlinked to
+ * `domain.retire(node, fn)`, and `fn(node)` is called once no guard can
+ * still reach it.
+ *
+ * @code
+ *   template <csg::reclamation_domain Domain>
+ *   class stack {
+ *     struct node : Domain::node_type { node *next; T value; };
+ *
+ *     std::optional<T> pop() {
+ *       typename Domain::guard g{m_domain};
+ *       node *n;
+ *       do {
+ *         n = static_cast<node *>(g.protect(m_head, 0));
+ *       } while (n && !m_head.compare_exchange_weak(n, n->next));
+ *       ...
+ *       m_domain.retire(n, &free_node);
+ *     }
+ *   };
+ * @endcode
+ */
+template <typename D>
+concept reclamation_domain = requires(D &d, typename D::guard &g,
+                                      typename D::node_type *n,
+                                      void (*fn)(typename D::node_type *),
+                                      const std::atomic<typename D::node_type *>
+                                          &src) {
+  requires std::constructible_from<typename D::guard, D &>;
+  { g.protect(src, std::size_t{}) } -> std::same_as<typename D::node_type *>;
+  { d.retire(n, fn) } noexcept;
+};
+
+namespace detail {
+
+// Each reclamation domain keeps a record of every thread which uses it, as
+// rmlock keeps a tracker of every reader. A Record lives on the list of its
+// domain (through `domainLink`), which the domain scans, and on the list of
+// its thread (through `threadLink`), through which the thread finds it.
+// `domain` points to its Record::domain_type, and is cleared when the domain
+// is destroyed; the thread then frees the record the next time it looks
+// for one, or when it exits.
+template <typename Record>
+using reclaim_record_list = CSG_TAILQ_HEAD_OFFSET_T(Record, domainLink);
+
+template <typename Record>
+using reclaim_thread_list = CSG_TAILQ_HEAD_OFFSET_T(Record, threadLink);
+
+// Protects the lists of records of all the domains of a type, along with
+// whatever the domains keep with them (e.g., nodes orphaned by exited
+// threads).
+template <typename Record>
+inline std::mutex &reclaim_list_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+// On exit, a thread hands each of its records over to its domain, by
+// calling `domain->detachThread(record)` with the list mutex held; the
+// domain unlinks the record and takes over its retired nodes.
+template <typename Record>
+struct reclaim_tls {
+  ~reclaim_tls() {
+    const std::lock_guard lock{reclaim_list_mutex<Record>()};
+    while (!records.empty()) {
+      Record &r = records.front();
+      records.pop_front();
+      if (auto *const d = r.domain.load(std::memory_order_relaxed))
+        d->detachThread(r);
+      delete &r;
+    }
+  }
+
+  Record *last = nullptr;  // Most recently used.
+  reclaim_thread_list<Record> records;
+};
+
+// A function-local thread_local rather than a thread_local variable
+// template, which GCC 12 left uninitialized (and crashed on) when it was
+// first used from these function templates.
+template <typename Record>
+inline reclaim_tls<Record> &reclaim_thread_records() noexcept {
+  thread_local reclaim_tls<Record> tls;
+  return tls;
+}
+
+// Returns the calling thread's record for domain `d`, whose list of records
+// is `domainRecords` (a reclaim_record_list<Record>; the list type is a
+// template parameter, since GCC cannot mangle the offsetof in the alias
+// within a function signature). A new record is passed to `init` before it
+// is linked.
+template <typename Record, typename List, typename Init>
+Record &reclaim_find_record(typename Record::domain_type *d,
+                            List &domainRecords, Init init) noexcept {
+  reclaim_tls<Record> &tls = reclaim_thread_records<Record>();
+  auto &records = tls.records;
+  for (auto i = records.begin(); i != records.end(); ) {
+    const auto *const owner = i->domain.load(std::memory_order_acquire);
+    if (owner == d)
+      return *(tls.last = &*i);
+    if (!owner) {
+      Record *const dead = &*i;
+      i = records.erase(i);
+      delete dead;
+    }
+    else
+      ++i;
+  }
+
+  auto *const r = new (std::nothrow) Record;
+  if (!r) {
+    // Readers cannot fail, and there is no other way to track this thread.
+    std::terminate();
+  }
+  r->domain.store(d, std::memory_order_relaxed);
+  init(*r);
+  {
+    const std::lock_guard lock{reclaim_list_mutex<Record>()};
+    domainRecords.push_back(r);
+  }
+  records.push_front(r);
+  return *(tls.last = r);
+}
+
+// The fast path of reclaim_find_record.
+template <typename Record, typename List, typename Init>
+Record &reclaim_thread_record(typename Record::domain_type *d,
+                              List &domainRecords, Init init) noexcept {
+  reclaim_tls<Record> &tls = reclaim_thread_records<Record>();
+  if (tls.last && tls.last->domain.load(std::memory_order_relaxed) == d)
+    [[likely]]
+    return *tls.last;
+  return reclaim_find_record<Record>(d, domainRecords, init);
+}
+
+// Unlinks every record of a domain being destroyed, after passing it to
+// `fn`, which takes over its retired nodes; the caller holds the list
+// mutex.
+template <typename List, typename Fn>
+void reclaim_orphan_records(List &domainRecords, Fn fn) noexcept {
+  while (!domainRecords.empty()) {
+    auto &r = domainRecords.front();
+    domainRecords.pop_front();
+    fn(r);
+    r.domain.store(nullptr, std::memory_order_release);
+  }
+}
+
+} // End of namespace detail
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,258 @@
+//==-- csg/core/reorder_buffer.h - sequence reorder buffer ------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a buffer which restores the order of objects carrying
+ *     sequence numbers, in the style of DPDK's rte_reorder library.
+ */
+
+#ifndef CSG_CORE_REORDER_BUFFER_H
+#define CSG_CORE_REORDER_BUFFER_H
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include <csg/core/assert.h>
+#include <csg/core/listfwd.h>
+#include <csg/core/stailq.h>
+
+namespace csg {
+
+/// The outcome of reorder_buffer::insert.
+enum class reorder_status {
+  ordered,   ///< Stored in the window, to be drained in order.
+  overflow,  ///< Too early for the window; kept on the overflow list.
+  late,      ///< Older than the last drained sequence number; not stored.
+  duplicate  ///< Its sequence number is already in the buffer; not stored.
+};
+
+/**
+ * @brief Restores the sequence-number order of objects which were processed
+ *     out of order, e.g., packets spread over parallel worker threads.
+ *
+ * The buffer has a window of `window` slots, indexed by sequence number,
+ * starting at the next sequence number to be emitted. Inserting an object
+ * whose sequence number falls in the window stores it in its slot, in O(1);
+ * @ref drain then removes the run of consecutive objects at the start of the
+ * window, in bursts, and moves the window past them.
+ *
+ * An object which arrives too early for the window is linked onto an
+ * intrusive overflow list (an stailq, through an entry in the object), and
+ * moves into the window once the window reaches it, so a burst of early
+ * objects costs no allocation and is never dropped. An object older than
+ * the window cannot be emitted in order any more: insert hands it back as
+ * reorder_status::late, and the caller decides what to do with it, as it
+ * does for a duplicate (a duplicate found only when it leaves the overflow
+ * list is handed back by @ref take_rejected). If an object is lost,
+ * @ref skip_gap moves the window past the missing sequence numbers.
+ *
+ * Sequence numbers are 32-bit and wrap around; the object's number is read
+ * through the member pointer `SeqMember`:
+ *
+ * @code
+ *   struct packet {
+ *     std::uint32_t seq;
+ *     csg::stailq_entry<packet> link;
+ *     ...
+ *   };
+ *
+ *   csg::reorder_buffer<CSG_STAILQ_HEAD_OFFSET_T(packet, link),
+ *                       &packet::seq> rob{1024};
+ *
+ *   rob.insert(p);                  // as workers finish
+ *   packet *out[32];
+ *   std::size_t n = rob.drain(out); // in sequence order
+ * @endcode
+ *
+ * The buffer is not thread-safe.
+ */
+template <stailq OverflowList, auto SeqMember>
+  requires std::same_as<decltype(SeqMember),
+                        std::uint32_t OverflowList::value_type::*>
+class reorder_buffer {
+public:
+  using value_type = typename OverflowList::value_type;
+  using pointer = value_type *;
+  using size_type = std::size_t;
+  using seq_type = std::uint32_t;
+
+  /// Create a buffer of `window` slots (a power of two), which will emit
+  /// sequence numbers starting with `first`.
+  explicit reorder_buffer(size_type window, seq_type first = 0)
+      : m_slots{std::make_unique<pointer[]>(window)},
+        m_mask{static_cast<std::uint32_t>(window - 1)}, m_next{first} {
+    CSG_ASSERT(std::has_single_bit(window) && window <= max_window(),
+               "reorder window %zu is not a power of two", window);
+  }
+
+  reorder_buffer(const reorder_buffer &) = delete;
+
+  reorder_buffer &operator=(const reorder_buffer &) = delete;
+
+  /// The window must be much smaller than the sequence number space, so
+  /// that early and late objects can be told apart.
+  constexpr static size_type max_window() noexcept {
+    return size_type{1} << 30;
+  }
+
+  size_type window() const noexcept { return size_type{m_mask} + 1; }
+
+  /// The next sequence number to be drained.
+  seq_type next_seq() const noexcept { return m_next; }
+
+  /// The number of objects in the window.
+  size_type size() const noexcept { return m_count; }
+
+  /// Whether any objects wait on the overflow list.
+  bool has_overflow() const noexcept { return !m_overflow.empty(); }
+
+  bool empty() const noexcept { return !m_count && !has_overflow(); }
+
+  /// Remove and return an object which went to the overflow list but turned
+  /// out to duplicate an object in the window, or nullptr if there is none.
+  pointer take_rejected() noexcept {
+    if (m_rejected.empty())
+      return nullptr;
+    pointer const p = &m_rejected.front();
+    m_rejected.pop_front();
+    return p;
+  }
+
+  reorder_status insert(pointer p) noexcept {
+    const seq_type offset = p->*SeqMember - m_next;
+
+    // Sequence numbers less than half the number space behind m_next are
+    // late, and all the others early.
+    if (offset > seq_type{1} << 31)
+      return reorder_status::late;
+
+    if (offset > m_mask) {
+      if (m_overflow.empty() || isBefore(p->*SeqMember, m_overflowMin))
+        m_overflowMin = p->*SeqMember;
+      m_overflow.push_back(p);
+      return reorder_status::overflow;
+    }
+
+    pointer &slot = m_slots[(m_head + offset) & m_mask];
+    if (slot)
+      return reorder_status::duplicate;
+    slot = p;
+    ++m_count;
+    return reorder_status::ordered;
+  }
+
+  /// Remove up to `out.size()` objects with consecutive sequence numbers,
+  /// starting at next_seq(); returns the number removed.
+  size_type drain(std::span<pointer> out) noexcept {
+    size_type n = 0;
+
+    while (n < out.size()) {
+      pointer &slot = m_slots[m_head & m_mask];
+      if (!slot) {
+        // The next object may only now have entered the window.
+        if (!pullOverflow())
+          break;
+        continue;
+      }
+
+      out[n++] = slot;
+      slot = nullptr;
+      ++m_head;
+      ++m_next;
+      --m_count;
+    }
+
+    if (n)
+      pullOverflow();
+    return n;
+  }
+
+  /// Give up on the missing sequence numbers at the start of the window,
+  /// moving it up to the earliest stored object; returns the number of
+  /// sequence numbers skipped.
+  seq_type skip_gap() noexcept {
+    seq_type skipped = 0;
+
+    if (m_count) {
+      while (!m_slots[m_head & m_mask]) {
+        ++m_head;
+        ++skipped;
+      }
+    }
+    else if (has_overflow()) {
+      skipped = m_overflowMin - m_next;
+      m_head += skipped;
+    }
+
+    m_next += skipped;
+    pullOverflow();
+    return skipped;
+  }
+
+private:
+  static bool isBefore(seq_type a, seq_type b) noexcept {
+    return static_cast<std::int32_t>(a - b) < 0;
+  }
+
+  // Move the objects on the overflow list which now fall in the window into
+  // their slots; returns whether any were moved. The list is only scanned
+  // once its earliest object is in the window.
+  bool pullOverflow() noexcept {
+    if (m_overflow.empty() || m_overflowMin - m_next > m_mask)
+      return false;
+
+    bool moved = false;
+    bool haveMin = false;
+    auto prev = m_overflow.before_begin();
+
+    for (auto i = m_overflow.begin(); i != m_overflow.end();) {
+      const seq_type seq = (*i).*SeqMember;
+      const seq_type offset = seq - m_next;
+
+      if (offset <= m_mask) {
+        pointer &slot = m_slots[(m_head + offset) & m_mask];
+        pointer const p = &*i;
+        i = m_overflow.erase_after(prev);
+        if (slot)
+          m_rejected.push_back(p);
+        else {
+          slot = p;
+          ++m_count;
+          moved = true;
+        }
+        continue;
+      }
+
+      if (!haveMin || isBefore(seq, m_overflowMin)) {
+        m_overflowMin = seq;
+        haveMin = true;
+      }
+      prev = i++;
+    }
+
+    return moved;
+  }
+
+  std::unique_ptr<pointer[]> m_slots;
+  std::uint32_t m_mask;
+  std::uint32_t m_head = 0;      // Slot index of m_next, modulo the window.
+  seq_type m_next;
+  size_type m_count = 0;
+  OverflowList m_overflow;
+  OverflowList m_rejected;
+  seq_type m_overflowMin = 0;    // Earliest sequence number on m_overflow.
+};
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,797 @@
+//==-- csg/core/ring.h - DPDK rte_ring-style ring buffer --------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a lock-free ring buffer with bulk and burst operations,
+ *     based on DPDK's librte_ring, whose producer and consumer
+ *     synchronization is selected at compile time.
+ */
+
+#ifndef CSG_CORE_RING_H
+#define CSG_CORE_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include <csg/core/assert.h>
+#include <csg/core/futex.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+namespace detail {
+
+// The head and tail of one side (producer or consumer) of a ring. Each side
+// first moves its head to reserve slots, then accesses the slots, and then
+// moves its tail to hand the slots over to the other side.
+struct ring_headtail {
+  std::atomic<std::uint32_t> head = 0;
+  std::atomic<std::uint32_t> tail = 0;
+};
+
+} // End of namespace detail
+
+/**
+ * @brief Ring synchronization policy for a side of the ring which is only
+ *     ever used by one thread at a time; no atomic read-modify-write
+ *     operations are needed.
+ */
+struct ring_single {
+  using headtail = detail::ring_headtail;
+
+  constexpr static bool is_multi_thread = false;
+  constexpr static bool is_blocking = false;
+
+  static std::uint32_t load_tail(const headtail &ht) noexcept {
+    return ht.tail.load(std::memory_order_acquire);
+  }
+
+  // Reserve `amount(oldHead)` slots (which may be zero) by moving the head.
+  template <typename Fn>
+  static std::uint32_t move_head(headtail &ht, std::uint32_t &oldHead,
+                                 Fn amount) noexcept {
+    oldHead = ht.head.load(std::memory_order_relaxed);
+    const std::uint32_t n = amount(oldHead);
+    if (n)
+      ht.head.store(oldHead + n, std::memory_order_relaxed);
+    return n;
+  }
+
+  // Hand the `n` slots reserved at `oldHead` over to the other side.
+  static void update_tail(headtail &ht, std::uint32_t oldHead,
+                          std::uint32_t n) noexcept {
+    ht.tail.store(oldHead + n, std::memory_order_release);
+  }
+};
+
+/**
+ * @brief Ring synchronization policy for a side of the ring which is used
+ *     by many threads; this is the "classic" multi-producer/multi-consumer
+ *     synchronization of rte_ring.
+ *
+ * Threads reserve slots by a compare-and-swap on the head, and hand them over
+ * by updating the tail in the same order in which they were reserved, so a
+ * thread may have to wait for the threads which reserved before it.
+ */
+struct ring_multi {
+  using headtail = detail::ring_headtail;
+
+  constexpr static bool is_multi_thread = true;
+  constexpr static bool is_blocking = false;
+
+  static std::uint32_t load_tail(const headtail &ht) noexcept {
+    return ht.tail.load(std::memory_order_acquire);
+  }
+
+  template <typename Fn>
+  static std::uint32_t move_head(headtail &ht, std::uint32_t &oldHead,
+                                 Fn amount) noexcept {
+    // The acquire load keeps amount()'s read of the other side's tail from
+    // being ordered before the read of our head.
+    oldHead = ht.head.load(std::memory_order_acquire);
+    std::uint32_t n;
+
+    do {
+      n = amount(oldHead);
+      if (!n)
+        return 0;
+    } while (!ht.head.compare_exchange_weak(oldHead, oldHead + n,
+                                            std::memory_order_acquire,
+                                            std::memory_order_acquire));
+
+    return n;
+  }
+
+  static void update_tail(headtail &ht, std::uint32_t oldHead,
+                          std::uint32_t n) noexcept {
+    // Wait for the threads which reserved earlier slots to publish them.
+    // Acquire their tail, since our store does not continue their release
+    // sequence: whoever acquires our tail is then ordered after their slot
+    // accesses as well as ours.
+    util::spin_backoff backoff;
+    while (ht.tail.load(std::memory_order_acquire) != oldHead)
+      backoff.pause();
+    ht.tail.store(oldHead + n, std::memory_order_release);
+  }
+};
+
+namespace detail {
+
+// A 32-bit ring index and a 32-bit count (the RTS modes) or a second index
+// (HTS), updated together by 64-bit atomic operations.
+constexpr std::uint64_t ring_pack(std::uint32_t lo, std::uint32_t hi) noexcept {
+  return std::uint64_t{hi} << 32 | lo;
+}
+
+constexpr std::uint32_t ring_lo(std::uint64_t v) noexcept {
+  return static_cast<std::uint32_t>(v);
+}
+
+constexpr std::uint32_t ring_hi(std::uint64_t v) noexcept {
+  return static_cast<std::uint32_t>(v >> 32);
+}
+
+struct ring_rts_headtail {
+  // Each is an index (low half) and the number of operations which have
+  // moved it (high half).
+  std::atomic<std::uint64_t> head = 0;
+  std::atomic<std::uint64_t> tail = 0;
+};
+
+struct ring_hts_headtail {
+  // The head (low half) and the tail (high half).
+  std::atomic<std::uint64_t> headTail = 0;
+};
+
+} // End of namespace detail
+
+/**
+ * @brief Ring synchronization policy for many threads with "relaxed tail
+ *     sync" (RTS), as in DPDK's RTE_RING_SYNC_MT_RTS.
+ *
+ * Threads reserve slots as in ring_multi, but do not hand them over in
+ * reservation order: each finishing thread counts itself on the tail, and
+ * the one which finds that all the operations started on the head have
+ * finished moves the tail up to the head. So a thread preempted in the
+ * middle of an operation delays the hand-over of the slots, but the other
+ * threads of its side do not spin waiting for it. To bound that delay, a
+ * thread may not move the head more than `MaxDistance` slots beyond the
+ * tail.
+ */
+template <std::uint32_t MaxDistance>
+struct basic_ring_rts {
+  using headtail = detail::ring_rts_headtail;
+
+  constexpr static bool is_multi_thread = true;
+  constexpr static bool is_blocking = false;
+
+  static std::uint32_t load_tail(const headtail &ht) noexcept {
+    return detail::ring_lo(ht.tail.load(std::memory_order_acquire));
+  }
+
+  template <typename Fn>
+  static std::uint32_t move_head(headtail &ht, std::uint32_t &oldHead,
+                                 Fn amount) noexcept {
+    std::uint64_t h = ht.head.load(std::memory_order_acquire);
+    std::uint32_t n;
+
+    do {
+      util::spin_backoff backoff;
+      while (detail::ring_lo(h) - load_tail(ht) > MaxDistance) {
+        backoff.pause();
+        h = ht.head.load(std::memory_order_acquire);
+      }
+
+      n = amount(detail::ring_lo(h));
+      if (!n)
+        return 0;
+    } while (!ht.head.compare_exchange_weak(
+        h, detail::ring_pack(detail::ring_lo(h) + n, detail::ring_hi(h) + 1),
+        std::memory_order_acquire, std::memory_order_acquire));
+
+    oldHead = detail::ring_lo(h);
+    return n;
+  }
+
+  static void update_tail(headtail &ht, std::uint32_t,
+                          std::uint32_t) noexcept {
+    std::uint64_t t = ht.tail.load(std::memory_order_acquire);
+    std::uint64_t next;
+
+    do {
+      // If ours is the last unfinished operation, all slots up to the head
+      // are ready.
+      const std::uint64_t h = ht.head.load(std::memory_order_relaxed);
+      const std::uint32_t count = detail::ring_hi(t) + 1;
+      const std::uint32_t pos =
+          count == detail::ring_hi(h) ? detail::ring_lo(h)
+                                      : detail::ring_lo(t);
+      next = detail::ring_pack(pos, count);
+    } while (!ht.tail.compare_exchange_weak(t, next,
+                                            std::memory_order_release,
+                                            std::memory_order_acquire));
+  }
+};
+
+/// The RTS policy, with DPDK's default head-tail distance for a ring of
+/// 1024 slots.
+using ring_rts = basic_ring_rts<128>;
+
+/**
+ * @brief Ring synchronization policy for many threads with "head/tail sync"
+ *     (HTS), as in DPDK's RTE_RING_SYNC_MT_HTS.
+ *
+ * Operations on this side are serialized: a thread moves the head only when
+ * the tail has caught up with it, with a compare-and-swap on a single 64-bit
+ * word holding both. Since at most one operation is in progress at a time,
+ * a waiting thread only ever waits at the start of its operation, before it
+ * has reserved any slots, rather than after doing its work; and the
+ * hand-over is a plain store.
+ */
+struct ring_hts {
+  using headtail = detail::ring_hts_headtail;
+
+  constexpr static bool is_multi_thread = true;
+  constexpr static bool is_blocking = false;
+
+  static std::uint32_t load_tail(const headtail &ht) noexcept {
+    return detail::ring_hi(ht.headTail.load(std::memory_order_acquire));
+  }
+
+  template <typename Fn>
+  static std::uint32_t move_head(headtail &ht, std::uint32_t &oldHead,
+                                 Fn amount) noexcept {
+    std::uint64_t p = ht.headTail.load(std::memory_order_acquire);
+    std::uint32_t n;
+
+    do {
+      util::spin_backoff backoff;
+      while (detail::ring_lo(p) != detail::ring_hi(p)) {
+        backoff.pause();
+        p = ht.headTail.load(std::memory_order_acquire);
+      }
+
+      n = amount(detail::ring_lo(p));
+      if (!n)
+        return 0;
+    } while (!ht.headTail.compare_exchange_weak(
+        p, detail::ring_pack(detail::ring_lo(p) + n, detail::ring_hi(p)),
+        std::memory_order_acquire, std::memory_order_acquire));
+
+    oldHead = detail::ring_lo(p);
+    return n;
+  }
+
+  static void update_tail(headtail &ht, std::uint32_t oldHead,
+                          std::uint32_t n) noexcept {
+    ht.headTail.store(detail::ring_pack(oldHead + n, oldHead + n),
+                      std::memory_order_release);
+  }
+};
+
+/// Requirements for a ring synchronization policy.
+template <typename S>
+concept ring_sync_policy = requires (typename S::headtail &ht,
+                                     std::uint32_t &oldHead, std::uint32_t n) {
+  { S::is_multi_thread } -> std::convertible_to<bool>;
+  { S::is_blocking } -> std::convertible_to<bool>;
+  { S::load_tail(ht) } -> std::same_as<std::uint32_t>;
+  { S::move_head(ht, oldHead, [](std::uint32_t) { return 0u; }) }
+      -> std::same_as<std::uint32_t>;
+  S::update_tail(ht, oldHead, n);
+};
+
+/**
+ * @brief Wraps another ring synchronization policy, so that threads of the
+ *     other side of the ring can sleep until this side moves its tail.
+ *
+ * A thread which cannot proceed (e.g., a consumer of an empty ring, if the
+ * producer policy is blocking) first spins for a while, retrying. If that
+ * fails, it increments the "sleepers" count of this side and sleeps on a
+ * futex next to this side's tail. Updating the tail only issues a wake up
+ * system call if the sleepers count is non-zero, so there is no system call
+ * per element while the ring is busy.
+ *
+ * Both sides of a ring may be blocking, e.g.,
+ * `ring<T*, ring_blocking<ring_multi>, ring_blocking<ring_single>>`.
+ */
+template <ring_sync_policy Base>
+struct ring_blocking {
+  struct headtail : Base::headtail {
+    // Threads of the other side sleeping until this side's tail moves, and
+    // the futex word they sleep on, which is bumped to wake them. Both are
+    // on the same cache line as the tail, which the updating side owns.
+    std::atomic<std::uint32_t> sleepers = 0;
+    std::atomic<std::uint32_t> wakeups = 0;
+  };
+
+  constexpr static bool is_multi_thread = Base::is_multi_thread;
+  constexpr static bool is_blocking = true;
+
+  /// The number of times a waiting thread retries before it sleeps.
+  constexpr static unsigned spin_count = 512;
+
+  static std::uint32_t load_tail(const headtail &ht) noexcept {
+    return Base::load_tail(ht);
+  }
+
+  template <typename Fn>
+  static std::uint32_t move_head(headtail &ht, std::uint32_t &oldHead,
+                                 Fn amount) noexcept {
+    return Base::move_head(ht, oldHead, amount);
+  }
+
+  static void update_tail(headtail &ht, std::uint32_t oldHead,
+                          std::uint32_t n) noexcept {
+    Base::update_tail(ht, oldHead, n);
+
+    // Pairs with the fence in wait: either we see the sleeper, or it sees
+    // our new tail when it retries.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ht.sleepers.load(std::memory_order_relaxed)) [[unlikely]] {
+      ht.wakeups.fetch_add(1, std::memory_order_release);
+      util::futex_wake_all(ht.wakeups);
+    }
+  }
+
+  // Call `attempt` until it returns non-zero, sleeping until this side's
+  // tail moves whenever spinning has not helped.
+  template <typename Fn>
+  static std::uint32_t wait(headtail &ht, Fn attempt) noexcept {
+    for (unsigned spins = 0;; ++spins) {
+      if (const std::uint32_t n = attempt())
+        return n;
+
+      if (spins < spin_count) {
+        util::cpu_relax();
+        continue;
+      }
+
+      const std::uint32_t observed =
+          ht.wakeups.load(std::memory_order_acquire);
+      ht.sleepers.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+
+      // If the tail moved after `observed` was read, either the retry
+      // succeeds or futex_wait returns immediately.
+      const std::uint32_t n = attempt();
+      if (!n)
+        util::futex_wait(ht.wakeups, observed);
+
+      ht.sleepers.fetch_sub(1, std::memory_order_relaxed);
+      if (n)
+        return n;
+    }
+  }
+};
+
+/// Whether a bulk or burst operation accepts a partial transfer.
+enum class ring_behavior {
+  fixed,    ///< Bulk: transfer all the elements, or none of them.
+  variable  ///< Burst: transfer as many elements as possible.
+};
+
+/**
+ * @brief Up to two contiguous runs of ring slots, returned by the zero-copy
+ *     ring operations; the second run is non-empty only if the region wraps
+ *     around the end of the slot array.
+ */
+template <typename T>
+struct ring_region {
+  std::span<T> first;
+  std::span<T> second;
+
+  std::size_t size() const noexcept { return first.size() + second.size(); }
+
+  bool empty() const noexcept { return !size(); }
+
+  T &operator[](std::size_t i) const noexcept {
+    return i < first.size() ? first[i] : second[i - first.size()];
+  }
+};
+
+namespace detail {
+
+// The region of `n` slots starting at free-running index `idx`.
+template <typename T>
+ring_region<T> ring_region_at(T *slots, std::uint32_t mask, std::uint32_t idx,
+                              std::uint32_t n) noexcept {
+  const std::uint32_t pos = idx & mask;
+  const std::uint32_t first = std::min(n, mask + 1 - pos);
+  return {{slots + pos, first}, {slots, n - first}};
+}
+
+// Copy a run of `n` elements. For trivially copyable elements, std::copy_n
+// is a memmove, which the C library vectorizes for the CPU at hand; unlike
+// DPDK's rte_ring_elem, we do not inline 32 byte vector moves for small
+// elements, since memmove was as fast for short runs and faster for long
+// ones (see elem_ring_bench).
+template <typename T>
+void ring_copy_run(T *dst, const T *src, std::uint32_t n) noexcept {
+  std::copy_n(src, n, dst);
+}
+
+// Copy `n` elements into ring slots starting at free-running index `idx`.
+template <typename T>
+void ring_copy_in(T *slots, std::uint32_t mask, std::uint32_t idx,
+                  const T *src, std::uint32_t n) noexcept {
+  const std::uint32_t pos = idx & mask;
+  const std::uint32_t first = std::min(n, mask + 1 - pos);
+  ring_copy_run(slots + pos, src, first);
+  ring_copy_run(slots, src + first, n - first);
+}
+
+template <typename T>
+void ring_copy_out(const T *slots, std::uint32_t mask, std::uint32_t idx,
+                   T *dst, std::uint32_t n) noexcept {
+  const std::uint32_t pos = idx & mask;
+  const std::uint32_t first = std::min(n, mask + 1 - pos);
+  ring_copy_run(dst, slots + pos, first);
+  ring_copy_run(dst + first, slots, n - first);
+}
+
+/*
+ * The control block of a ring, immediately followed in memory by the ring's
+ * slots, as in DPDK. The block contains no pointers, so it may be placed in
+ * memory shared between processes and mapped at different addresses.
+ *
+ * The first cache line is read-only after construction; the producer and
+ * consumer head/tail pairs each have a cache line of their own.
+ */
+template <typename T, ring_sync_policy Prod, ring_sync_policy Cons>
+struct alignas(util::cache_line_size) ring_block {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "ring elements must be trivially copyable");
+
+  explicit ring_block(std::uint32_t count) noexcept
+      : mask{count - 1} {}
+
+  static std::size_t allocation_size(std::size_t count) noexcept {
+    return sizeof(ring_block) + count * sizeof(T);
+  }
+
+  T *slots() noexcept { return reinterpret_cast<T *>(this + 1); }
+
+  const T *slots() const noexcept {
+    return reinterpret_cast<const T *>(this + 1);
+  }
+
+  std::uint32_t capacity() const noexcept { return mask + 1; }
+
+  // Reserve up to `n` free slots for a producer, returning how many were
+  // reserved (and in `oldHead`, the index of the first).
+  std::uint32_t moveProdHead(std::uint32_t n, ring_behavior b,
+                             std::uint32_t &oldHead) noexcept {
+    return Prod::move_head(prod, oldHead, [&](std::uint32_t head) {
+      const std::uint32_t free = capacity() + Cons::load_tail(cons) - head;
+      return b == ring_behavior::fixed ? (n <= free ? n : 0)
+                                       : std::min(n, free);
+    });
+  }
+
+  // Reserve up to `n` filled slots for a consumer.
+  std::uint32_t moveConsHead(std::uint32_t n, ring_behavior b,
+                             std::uint32_t &oldHead) noexcept {
+    return Cons::move_head(cons, oldHead, [&](std::uint32_t head) {
+      const std::uint32_t used = Prod::load_tail(prod) - head;
+      return b == ring_behavior::fixed ? (n <= used ? n : 0)
+                                       : std::min(n, used);
+    });
+  }
+
+  std::uint32_t enqueue(const T *objs, std::uint32_t n,
+                        ring_behavior b) noexcept {
+    std::uint32_t head;
+    n = moveProdHead(n, b, head);
+    if (n) {
+      ring_copy_in(slots(), mask, head, objs, n);
+      Prod::update_tail(prod, head, n);
+    }
+    return n;
+  }
+
+  std::uint32_t dequeue(T *objs, std::uint32_t n, ring_behavior b) noexcept {
+    std::uint32_t head;
+    n = moveConsHead(n, b, head);
+    if (n) {
+      ring_copy_out(slots(), mask, head, objs, n);
+      Cons::update_tail(cons, head, n);
+    }
+    return n;
+  }
+
+  // Zero-copy producer: reserve up to `n` free slots, which the caller fills
+  // in place and then hands to the consumers with commitEnqueue. Each
+  // reserveEnqueue must be followed by a commitEnqueue, of at most the
+  // number of slots reserved; the unused slots are returned to the ring.
+  ring_region<T> reserveEnqueue(std::uint32_t n) noexcept {
+    std::uint32_t head;
+    n = moveProdHead(n, ring_behavior::variable, head);
+    return ring_region_at(slots(), mask, head, n);
+  }
+
+  void commitEnqueue(std::uint32_t n) noexcept {
+    const std::uint32_t tail = prod.tail.load(std::memory_order_relaxed);
+    CSG_ASSERT(n <= prod.head.load(std::memory_order_relaxed) - tail,
+               "committed more slots than were reserved");
+    prod.head.store(tail + n, std::memory_order_relaxed);
+    Prod::update_tail(prod, tail, n);
+  }
+
+  ring_region<T> peekDequeue(std::uint32_t n) noexcept {
+    std::uint32_t head;
+    n = moveConsHead(n, ring_behavior::variable, head);
+    return ring_region_at(slots(), mask, head, n);
+  }
+
+  void releaseDequeue(std::uint32_t n) noexcept {
+    const std::uint32_t tail = cons.tail.load(std::memory_order_relaxed);
+    CSG_ASSERT(n <= cons.head.load(std::memory_order_relaxed) - tail,
+               "released more slots than were peeked");
+    cons.head.store(tail + n, std::memory_order_relaxed);
+    Cons::update_tail(cons, tail, n);
+  }
+
+  std::uint32_t size() const noexcept {
+    const std::uint32_t used = Prod::load_tail(prod) - Cons::load_tail(cons);
+    // The tails are read separately, so the difference may be transiently
+    // out of range if the ring is in use.
+    return std::min(used, capacity());
+  }
+
+  const std::uint32_t mask;
+  alignas(util::cache_line_size) typename Prod::headtail prod;
+  alignas(util::cache_line_size) typename Cons::headtail cons;
+};
+
+template <typename Block>
+struct ring_block_deleter {
+  void operator()(Block *b) const noexcept {
+    b->~Block();
+    ::operator delete(b, std::align_val_t{alignof(Block)});
+  }
+};
+
+template <typename Block>
+using ring_block_ptr = std::unique_ptr<Block, ring_block_deleter<Block>>;
+
+// Allocate a ring_block together with its `count` slots.
+template <typename Block>
+ring_block_ptr<Block> make_ring_block(std::size_t count) {
+  void *const mem = ::operator new(Block::allocation_size(count),
+                                   std::align_val_t{alignof(Block)});
+  return ring_block_ptr<Block>{
+      new (mem) Block{static_cast<std::uint32_t>(count)}};
+}
+
+// The operations of the rings built on a ring_block, which differ only in
+// where the block is stored: csg::ring allocates it, and csg::shm_ring maps
+// it from shared memory.
+template <typename T, ring_sync_policy Prod, ring_sync_policy Cons>
+class ring_ops {
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using producer_sync = Prod;
+  using consumer_sync = Cons;
+
+  constexpr static size_type max_size() noexcept {
+    return size_type{1} << 31;
+  }
+
+  size_type capacity() const noexcept { return m_block->capacity(); }
+
+  /// The number of elements in the ring; only a snapshot, if other threads
+  /// are using the ring.
+  size_type size() const noexcept { return m_block->size(); }
+
+  size_type free_count() const noexcept { return capacity() - size(); }
+
+  bool empty() const noexcept { return !size(); }
+
+  bool full() const noexcept { return size() == capacity(); }
+
+  bool enqueue(const T &obj) noexcept {
+    return m_block->enqueue(&obj, 1, ring_behavior::fixed);
+  }
+
+  /// Enqueue all of `objs`, or nothing if there is not enough room; returns
+  /// the number of elements enqueued.
+  size_type enqueue_bulk(std::span<const T> objs) noexcept {
+    return m_block->enqueue(objs.data(), narrow(objs.size()),
+                            ring_behavior::fixed);
+  }
+
+  /// Enqueue as many of `objs` as there is room for, in order; returns the
+  /// number of elements enqueued.
+  size_type enqueue_burst(std::span<const T> objs) noexcept {
+    return m_block->enqueue(objs.data(), narrow(objs.size()),
+                            ring_behavior::variable);
+  }
+
+  bool dequeue(T &obj) noexcept {
+    return m_block->dequeue(&obj, 1, ring_behavior::fixed);
+  }
+
+  /// Fill all of `objs`, or dequeue nothing if there are not enough
+  /// elements; returns the number of elements dequeued.
+  size_type dequeue_bulk(std::span<T> objs) noexcept {
+    return m_block->dequeue(objs.data(), narrow(objs.size()),
+                            ring_behavior::fixed);
+  }
+
+  /// Dequeue up to `objs.size()` elements; returns the number dequeued.
+  size_type dequeue_burst(std::span<T> objs) noexcept {
+    return m_block->dequeue(objs.data(), narrow(objs.size()),
+                            ring_behavior::variable);
+  }
+
+  /// Enqueue `obj`, sleeping while the ring is full; requires a blocking
+  /// consumer policy, whose tail updates wake the producer.
+  void enqueue_wait(const T &obj) noexcept requires Cons::is_blocking {
+    Cons::wait(m_block->cons, [&] {
+      return m_block->enqueue(&obj, 1, ring_behavior::fixed);
+    });
+  }
+
+  /// Enqueue all of `objs`, sleeping until there is room for all of them;
+  /// returns at once if `objs` is empty, since a fixed enqueue of nothing
+  /// never succeeds.
+  size_type enqueue_bulk_wait(std::span<const T> objs) noexcept
+    requires Cons::is_blocking {
+    CSG_ASSERT(objs.size() <= capacity(), "bulk enqueue can never fit");
+    if (objs.empty())
+      return 0;
+    return Cons::wait(m_block->cons, [&] {
+      return m_block->enqueue(objs.data(), narrow(objs.size()),
+                              ring_behavior::fixed);
+    });
+  }
+
+  /// Dequeue one element, sleeping while the ring is empty; requires a
+  /// blocking producer policy.
+  void dequeue_wait(T &obj) noexcept requires Prod::is_blocking {
+    Prod::wait(m_block->prod, [&] {
+      return m_block->dequeue(&obj, 1, ring_behavior::fixed);
+    });
+  }
+
+  /// Dequeue between one and `objs.size()` elements, sleeping while the ring
+  /// is empty; returns the number dequeued.
+  size_type dequeue_burst_wait(std::span<T> objs) noexcept
+    requires Prod::is_blocking {
+    CSG_ASSERT(!objs.empty(), "empty burst would never return");
+    return Prod::wait(m_block->prod, [&] {
+      return m_block->dequeue(objs.data(), narrow(objs.size()),
+                              ring_behavior::variable);
+    });
+  }
+
+  /// Zero-copy enqueue, first step: reserve up to `n` free slots, to be
+  /// filled in place. Only a single-threaded producer side may do this,
+  /// since the reservation blocks other producers until it is committed.
+  ring_region<T> reserve(size_type n) noexcept
+    requires (!Prod::is_multi_thread) {
+    return m_block->reserveEnqueue(narrow(n));
+  }
+
+  /// Zero-copy enqueue, second step: make the first `n` reserved slots
+  /// visible to the consumers, and return any others to the ring.
+  void commit(size_type n) noexcept requires (!Prod::is_multi_thread) {
+    m_block->commitEnqueue(narrow(n));
+  }
+
+  /// Zero-copy dequeue, first step: up to `n` elements at the head of the
+  /// ring, which remain in their slots until released.
+  ring_region<T> peek(size_type n) noexcept
+    requires (!Cons::is_multi_thread) {
+    return m_block->peekDequeue(narrow(n));
+  }
+
+  /// Zero-copy dequeue, second step: remove the first `n` peeked elements,
+  /// returning their slots to the producers.
+  void release(size_type n) noexcept requires (!Cons::is_multi_thread) {
+    m_block->releaseDequeue(narrow(n));
+  }
+
+protected:
+  using block_type = ring_block<T, Prod, Cons>;
+
+  explicit ring_ops(block_type *block) noexcept : m_block{block} {}
+
+  ~ring_ops() = default;
+
+  static std::uint32_t narrow(size_type n) noexcept {
+    return static_cast<std::uint32_t>(std::min(n, max_size()));
+  }
+
+  block_type *m_block;
+};
+
+} // End of namespace detail
+
+/**
+ * @brief A fixed-capacity, lock-free FIFO queue of pointers, modeled after
+ *     DPDK's rte_ring.
+ *
+ * Like rte_ring, the ring gets its throughput from batching: a bulk or burst
+ * operation reserves space for all of its elements with a single head update
+ * (one compare-and-swap, for a multi-threaded side), copies them, and
+ * publishes them with a single tail update. The bulk operations transfer all
+ * the elements or none; the burst operations transfer as many as possible.
+ *
+ * Whether each side (producer or consumer) may be used by several threads at
+ * once is a compile-time policy, either ring_single or ring_multi, so that a
+ * single-threaded side pays no atomic read-modify-write operations:
+ *
+ * @code
+ *   csg::ring<packet *> rx{1024};                              // MP/MC
+ *   csg::ring<packet *, csg::ring_multi, csg::ring_single> tx{1024}; // MP/SC
+ * @endcode
+ *
+ * When a multi-threaded side has more threads than there are CPUs, a thread
+ * preempted between reserving and handing over its slots stalls every later
+ * thread of ring_multi. The ring_rts and ring_hts policies (DPDK's "relaxed
+ * tail sync" and "head/tail sync" modes) avoid spinning behind it.
+ *
+ * Wrapping a policy in ring_blocking makes the other side's threads able
+ * to sleep: e.g., with a `ring_blocking<ring_multi>` producer policy,
+ * @ref dequeue_wait and @ref dequeue_burst_wait sleep while the ring is
+ * empty, and with a blocking consumer policy @ref enqueue_wait and
+ * @ref enqueue_bulk_wait sleep while it is full.
+ *
+ * A single-threaded side may also use the zero-copy operations (as in
+ * DPDK's rte_ring_enqueue_zc_burst_start / _finish): @ref reserve returns a
+ * ring_region of free slots to fill in place, followed by @ref commit, and
+ * @ref peek and @ref release do the same for the consumer.
+ *
+ * The capacity must be a power of two; unlike rte_ring, all `count` slots
+ * may be used.
+ */
+template <typename T, ring_sync_policy Prod = ring_multi,
+          ring_sync_policy Cons = ring_multi>
+class ring : public detail::ring_ops<T, Prod, Cons> {
+  static_assert(std::is_pointer_v<T>, "ring elements must be pointers");
+
+  using base = detail::ring_ops<T, Prod, Cons>;
+  using block_type = typename base::block_type;
+
+public:
+  using typename base::size_type;
+
+  /// Create a ring with `count` slots, which must be a power of two.
+  explicit ring(size_type count)
+      : ring{detail::make_ring_block<block_type>(count)} {
+    CSG_ASSERT(std::has_single_bit(count) && count <= base::max_size(),
+               "ring size %zu is not a power of two", count);
+  }
+
+  ring(const ring &) = delete;
+
+  ring &operator=(const ring &) = delete;
+
+private:
+  explicit ring(detail::ring_block_ptr<block_type> b) noexcept
+      : base{b.get()}, m_storage{std::move(b)} {}
+
+  detail::ring_block_ptr<block_type> m_storage;
+};
+
+} // End of namespace csg
+
+#endif
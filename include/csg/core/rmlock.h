@@ -0,0 +1,377 @@
+//==-- csg/core/rmlock.h - read-mostly reader/writer lock -------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a reader/writer lock for read-mostly data, in the style of
+ *     FreeBSD's rmlock(9), which tracks every reader.
+ */
+
+#ifndef CSG_CORE_RMLOCK_H
+#define CSG_CORE_RMLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <source_location>
+#include <thread>
+#include <vector>
+
+#include <csg/core/assert.h>
+#include <csg/core/futex.h>
+#include <csg/core/lock_profile.h>
+#include <csg/core/membarrier.h>
+#include <csg/core/tailq.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+class rmlock;
+
+/// A thread holding an rmlock for reading, as reported by rmlock::readers.
+struct rmlock_reader {
+  std::thread::id thread;
+  std::uint32_t depth;  ///< The number of times the thread holds the lock.
+};
+
+namespace detail {
+
+// The state of one thread as a reader of one rmlock, as in FreeBSD's
+// rm_priotracker. It lives on the lock's list of trackers, through which
+// writers wait for readers, and on the thread's list of trackers, through
+// which the thread finds it. Only the owning thread writes `depth`.
+struct alignas(util::cache_line_size) rmlock_tracker {
+  tailq_entry<rmlock_tracker> lockLink;
+  tailq_entry<rmlock_tracker> threadLink;
+  std::atomic<std::uint32_t> depth = 0;
+  std::atomic<rmlock *> lock;  // nullptr once the lock is destroyed.
+  std::thread::id thread;
+};
+
+using rmlock_tracker_list = CSG_TAILQ_HEAD_OFFSET_T(rmlock_tracker, lockLink);
+
+using rmlock_thread_list = CSG_TAILQ_HEAD_OFFSET_T(rmlock_tracker, threadLink);
+
+struct rmlock_tls {
+  ~rmlock_tls();
+
+  rmlock_tracker *last = nullptr;  // Most recently used.
+  rmlock_thread_list trackers;
+};
+
+inline thread_local rmlock_tls rmlock_thread_trackers;
+
+// Protects the lists of trackers of all locks; only taken to add or remove
+// trackers, and by writers while they scan a lock's trackers.
+inline std::mutex &rmlock_list_mutex() {
+  static std::mutex m;
+  return m;
+}
+
+} // End of namespace detail
+
+/**
+ * @brief A reader/writer lock for data which is read far more often than
+ *     it is written, modeled after FreeBSD's rmlock(9).
+ *
+ * A thread reading under an rmlock writes only to a tracker of its own: the
+ * first time it reads, the thread allocates a tracker for the lock and links
+ * it onto the lock's list of trackers (taking a mutex), and thereafter
+ * @ref lock_shared and @ref unlock_shared only update the nesting depth in
+ * that tracker and check whether a writer is active. No cache line shared
+ * with other threads is written, so readers on different CPUs scale
+ * perfectly. A writer raises the writer flag and then waits for the depth of
+ * every tracker on the lock's list to drop to zero, so writes are slow; new
+ * readers sleep on a futex until the writer is done.
+ *
+ * On Linux, the store-load ordering between a reader's depth and the writer
+ * flag is enforced by the writer, with membarrier(2), so a reader only pays
+ * for a compiler barrier. Elsewhere, readers execute a full fence.
+ *
+ * Read locks may be recursive, and a recursive read lock succeeds even
+ * while a writer waits (as with RM_RECURSE). Taking the write lock while
+ * holding a read lock deadlocks, which is asserted against.
+ *
+ * The rmlock meets the requirements of the standard SharedMutex concept, so
+ * it can be used with std::shared_lock and std::unique_lock. The
+ * source_location parameters of the lock functions name the lock site when
+ * lock profiling is enabled (see lock_profile.h), and are otherwise unused.
+ * Because every reader is tracked, the threads holding the lock can be
+ * listed with @ref readers and @ref writer, e.g., by a watchdog which has
+ * detected a stall. In a debugger, the trackers are on the tailq `m_readers`
+ * of the lock, and on the thread-local tailq `rmlock_thread_trackers.trackers`
+ * of each thread.
+ *
+ * @code
+ *   csg::rmlock routes_lock{"routes"};
+ *
+ *   {
+ *     std::shared_lock guard{routes_lock};      // per packet
+ *     next_hop = lookup(routes, dst);
+ *   }
+ *
+ *   {
+ *     std::unique_lock guard{routes_lock};      // on a routing update
+ *     apply(routes, update);
+ *   }
+ * @endcode
+ */
+class rmlock {
+public:
+  explicit rmlock(const char *name = "rmlock") noexcept : m_name{name} {}
+
+  rmlock(const rmlock &) = delete;
+
+  ~rmlock();
+
+  rmlock &operator=(const rmlock &) = delete;
+
+  const char *name() const noexcept { return m_name; }
+
+  void lock_shared(std::source_location loc =
+                       std::source_location::current()) noexcept {
+    detail::rmlock_tracker &t = threadTracker();
+    const std::uint32_t depth = t.depth.load(std::memory_order_relaxed);
+    if (depth) {
+      t.depth.store(depth + 1, std::memory_order_relaxed);
+      return;
+    }
+
+    detail::lock_profile_attempt profile;
+    for (;;) {
+      t.depth.store(1, std::memory_order_relaxed);
+      util::asymmetric_light_fence();
+      if (!m_writer.load(std::memory_order_acquire)) [[likely]] {
+        profile.success(this, m_name, loc);
+        return;
+      }
+
+      // A writer is active; get out of its way until it is done.
+      t.depth.store(0, std::memory_order_release);
+      profile.failed();
+      waitForWriter();
+    }
+  }
+
+  bool try_lock_shared(std::source_location loc =
+                           std::source_location::current()) noexcept {
+    detail::rmlock_tracker &t = threadTracker();
+    const std::uint32_t depth = t.depth.load(std::memory_order_relaxed);
+    t.depth.store(depth + 1, std::memory_order_relaxed);
+    if (depth)
+      return true;
+
+    util::asymmetric_light_fence();
+    if (!m_writer.load(std::memory_order_acquire)) [[likely]] {
+      detail::lock_profile_attempt{}.success(this, m_name, loc);
+      return true;
+    }
+    t.depth.store(0, std::memory_order_release);
+    return false;
+  }
+
+  void unlock_shared() noexcept {
+    detail::rmlock_tracker &t = threadTracker();
+    const std::uint32_t depth = t.depth.load(std::memory_order_relaxed);
+    CSG_ASSERT(depth, "rmlock %s is not read-locked", m_name);
+    if (depth == 1)
+      detail::lock_profile_release(this);
+    t.depth.store(depth - 1, std::memory_order_release);
+  }
+
+  void lock(std::source_location loc = std::source_location::current()) {
+    CSG_ASSERT(!held_shared(), "rmlock %s: write lock while reading", m_name);
+    detail::lock_profile_attempt profile;
+    if (!m_writeMutex.try_lock()) {
+      profile.failed();
+      m_writeMutex.lock();
+    }
+    m_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    m_writer.store(1, std::memory_order_relaxed);
+    util::asymmetric_heavy_fence();
+
+    if (!readersDrained()) {
+      profile.failed();
+      util::spin_backoff backoff;
+      do
+        backoff.pause();
+      while (!readersDrained());
+    }
+    profile.success(this, m_name, loc);
+  }
+
+  bool try_lock(std::source_location loc = std::source_location::current()) {
+    if (!m_writeMutex.try_lock())
+      return false;
+    m_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+    m_writer.store(1, std::memory_order_relaxed);
+    util::asymmetric_heavy_fence();
+
+    if (!readersDrained()) {
+      releaseWriter();
+      return false;
+    }
+    detail::lock_profile_attempt{}.success(this, m_name, loc);
+    return true;
+  }
+
+  void unlock() noexcept {
+    CSG_ASSERT(held(), "rmlock %s is not write-locked by this thread", m_name);
+    detail::lock_profile_release(this);
+    releaseWriter();
+  }
+
+  /// Whether the calling thread holds the lock for reading.
+  bool held_shared() const noexcept {
+    const auto &tls = detail::rmlock_thread_trackers;
+    for (const detail::rmlock_tracker &t : tls.trackers) {
+      if (t.lock.load(std::memory_order_relaxed) == this)
+        return t.depth.load(std::memory_order_relaxed);
+    }
+    return false;
+  }
+
+  /// Whether the calling thread holds the lock for writing.
+  bool held() const noexcept {
+    return m_owner.load(std::memory_order_relaxed) ==
+        std::this_thread::get_id();
+  }
+
+  /// The thread which holds the lock for writing, or has raised the writer
+  /// flag and is waiting for the readers to leave, if any.
+  std::thread::id writer() const noexcept {
+    return m_owner.load(std::memory_order_relaxed);
+  }
+
+  /// The threads which hold the lock for reading; only a snapshot, unless
+  /// the caller holds the write lock (when there are none).
+  std::vector<rmlock_reader> readers() const;
+
+private:
+  friend struct detail::rmlock_tls;
+
+  detail::rmlock_tracker &threadTracker() noexcept {
+    detail::rmlock_tls &tls = detail::rmlock_thread_trackers;
+    if (tls.last && tls.last->lock.load(std::memory_order_relaxed) == this)
+      [[likely]]
+      return *tls.last;
+    return findTracker(tls);
+  }
+
+  detail::rmlock_tracker &findTracker(detail::rmlock_tls &tls) noexcept;
+
+  bool readersDrained() const noexcept {
+    const std::lock_guard lock{detail::rmlock_list_mutex()};
+    for (const detail::rmlock_tracker &t : m_readers) {
+      if (t.depth.load(std::memory_order_acquire))
+        return false;
+    }
+    return true;
+  }
+
+  void waitForWriter() noexcept {
+    // 1 is a writer, 2 a writer which must wake sleeping readers.
+    std::uint32_t w = m_writer.load(std::memory_order_relaxed);
+    while (w) {
+      if (w == 2 || m_writer.compare_exchange_weak(w, 2,
+                                                   std::memory_order_relaxed)) {
+        util::futex_wait(m_writer, 2);
+        w = m_writer.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void releaseWriter() noexcept {
+    m_owner.store(std::thread::id{}, std::memory_order_relaxed);
+    if (m_writer.exchange(0, std::memory_order_release) == 2)
+      util::futex_wake_all(m_writer);
+    m_writeMutex.unlock();
+  }
+
+  const char *m_name;
+  alignas(util::cache_line_size) std::atomic<std::uint32_t> m_writer = 0;
+  std::atomic<std::thread::id> m_owner;
+  std::mutex m_writeMutex;
+  detail::rmlock_tracker_list m_readers;  // Protected by rmlock_list_mutex.
+};
+
+inline rmlock::~rmlock() {
+  const std::lock_guard lock{detail::rmlock_list_mutex()};
+
+  // The trackers belong to their threads, which free them when they next
+  // look for a tracker, or exit.
+  while (!m_readers.empty()) {
+    detail::rmlock_tracker &t = m_readers.front();
+    CSG_ASSERT(!t.depth.load(std::memory_order_relaxed),
+               "rmlock %s destroyed while read-locked", m_name);
+    m_readers.pop_front();
+    t.lock.store(nullptr, std::memory_order_release);
+  }
+}
+
+inline detail::rmlock_tracker &
+rmlock::findTracker(detail::rmlock_tls &tls) noexcept {
+  auto &trackers = tls.trackers;
+  for (auto i = trackers.begin(); i != trackers.end(); ) {
+    const rmlock *const l = (*i).lock.load(std::memory_order_acquire);
+    if (l == this)
+      return *(tls.last = &*i);
+    if (!l) {
+      detail::rmlock_tracker *const dead = &*i;
+      i = trackers.erase(i);
+      delete dead;
+    }
+    else
+      ++i;
+  }
+
+  auto *const t = new (std::nothrow) detail::rmlock_tracker;
+  if (!t) {
+    // Readers cannot fail, and there is no other way to track this one.
+    std::terminate();
+  }
+  t->lock.store(this, std::memory_order_relaxed);
+  t->thread = std::this_thread::get_id();
+  {
+    const std::lock_guard lock{detail::rmlock_list_mutex()};
+    m_readers.push_back(t);
+  }
+  trackers.push_front(t);
+  return *(tls.last = t);
+}
+
+inline std::vector<rmlock_reader> rmlock::readers() const {
+  std::vector<rmlock_reader> r;
+  const std::lock_guard lock{detail::rmlock_list_mutex()};
+  for (const detail::rmlock_tracker &t : m_readers) {
+    if (const std::uint32_t depth = t.depth.load(std::memory_order_relaxed))
+      r.push_back({t.thread, depth});
+  }
+  return r;
+}
+
+namespace detail {
+
+inline rmlock_tls::~rmlock_tls() {
+  const std::lock_guard lock{rmlock_list_mutex()};
+  while (!trackers.empty()) {
+    rmlock_tracker &t = trackers.front();
+    trackers.pop_front();
+    if (rmlock *const l = t.lock.load(std::memory_order_relaxed))
+      l->m_readers.erase(l->m_readers.iter(&t));
+    delete &t;
+  }
+}
+
+} // End of namespace detail
+
+} // End of namespace csg
+
+#endif
@@ -0,0 +1,193 @@
+//==-- csg/core/seqlock.h - sequence lock for small records -----*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a sequence lock which protects a small, trivially copyable
+ *     record, modeled after FreeBSD's seq(9), whose readers never write to
+ *     shared memory.
+ */
+
+#ifndef CSG_CORE_SEQLOCK_H
+#define CSG_CORE_SEQLOCK_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include <csg/core/utility.h>
+
+namespace csg {
+
+/**
+ * @brief A record of type T, whose readers copy it optimistically and retry
+ *     if a writer changed it meanwhile, modeled after FreeBSD's seq(9).
+ *
+ * The record is guarded by a sequence number, which is odd while a writer
+ * is changing the record. A reader reads the sequence number, copies the
+ * record, and reads the sequence number again; if it was odd, or has
+ * changed, the copy may be torn and the reader retries. Readers only load
+ * from shared memory, so any number of them can read at once without
+ * bouncing cache lines between their CPUs, but they can starve while
+ * writers keep changing the record. It suits small records which are read
+ * often and written rarely, such as statistics and configuration.
+ *
+ * The record is stored as an array of 64-bit atomic words, which readers
+ * copy with relaxed loads into a local buffer before converting it to T;
+ * so there is no data race, and a torn value is never returned (or even
+ * constructed). For the copy to be cheap, T must be trivially copyable and
+ * at most @ref max_size bytes.
+ *
+ * Unlike seq(9), whose writers must be serialized by another lock, writers
+ * serialize themselves by atomically making the sequence number odd; a
+ * writer spins while another writes.
+ *
+ * @code
+ *   struct if_stats { std::uint64_t packets, bytes, drops; };
+ *   csg::seqlock<if_stats> stats;
+ *
+ *   stats.update([&](if_stats &s) { s.packets++; s.bytes += len; });
+ *   const if_stats snapshot = stats.load();
+ * @endcode
+ */
+template <typename T>
+class seqlock {
+public:
+  constexpr static std::size_t max_size = 128;
+
+  static_assert(std::is_trivially_copyable_v<T>,
+                "seqlock records are copied word by word");
+  static_assert(sizeof(T) <= max_size, "seqlock records must be small");
+
+  using value_type = T;
+
+  seqlock() noexcept : seqlock{T{}} {}
+
+  explicit seqlock(const T &value) noexcept { storeWords(value); }
+
+  seqlock(const seqlock &) = delete;
+
+  seqlock &operator=(const seqlock &) = delete;
+
+  /// Returns a consistent copy of the record, retrying while writers
+  /// change it.
+  T load() const noexcept {
+    T value;
+    util::spin_backoff backoff;
+    while (!try_load(value))
+      backoff.pause();
+    return value;
+  }
+
+  /// Copies the record into `value` and returns true, unless a writer
+  /// changed it during the copy (when `value` is left unchanged).
+  bool try_load(T &value) const noexcept {
+    const std::uint32_t seq = m_seq.load(std::memory_order_acquire);
+    if (seq & 1)
+      return false;
+
+    std::uint64_t words[word_count];
+    for (std::size_t i = 0; i < word_count; ++i)
+      words[i] = m_words[i].load(std::memory_order_relaxed);
+
+    // The copy must complete before the sequence number is read again;
+    // like seq_consistent, pairs with the writer's release fence.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_seq.load(std::memory_order_relaxed) != seq)
+      return false;
+
+    std::memcpy(&value, words, sizeof(T));
+    return true;
+  }
+
+  void store(const T &value) noexcept {
+    const std::uint32_t seq = writeBegin();
+    storeWords(value);
+    writeEnd(seq);
+  }
+
+  /// Calls `fn(T &)` on a copy of the record and stores the result, with
+  /// no other writer in between.
+  template <typename Fn>
+  void update(Fn fn) noexcept(noexcept(fn(std::declval<T &>()))) {
+    const std::uint32_t seq = writeBegin();
+    std::uint64_t words[word_count];
+    for (std::size_t i = 0; i < word_count; ++i)
+      words[i] = m_words[i].load(std::memory_order_relaxed);
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+
+    if constexpr (noexcept(fn(value)))
+      fn(value);
+    else {
+      try {
+        fn(value);
+      }
+      catch (...) {
+        // Nothing was stored; put the sequence number back to even, so the
+        // readers' copies of the old record stay valid.
+        m_seq.store(seq, std::memory_order_release);
+        throw;
+      }
+    }
+    storeWords(value);
+    writeEnd(seq);
+  }
+
+  /// The sequence number; even when no writer is active, and advanced by
+  /// two by each write.
+  std::uint32_t sequence() const noexcept {
+    return m_seq.load(std::memory_order_relaxed);
+  }
+
+private:
+  constexpr static std::size_t word_count =
+      (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+  // Makes the sequence number odd, waiting for other writers; returns the
+  // (even) value before.
+  std::uint32_t writeBegin() noexcept {
+    util::spin_backoff backoff;
+    std::uint32_t seq = m_seq.load(std::memory_order_relaxed);
+    for (;;) {
+      if (!(seq & 1) &&
+          m_seq.compare_exchange_weak(seq, seq + 1,
+                                      std::memory_order_relaxed)) {
+        break;
+      }
+      backoff.pause();
+      seq = m_seq.load(std::memory_order_relaxed);
+    }
+
+    // Readers must see the odd number before any changed word; pairs with
+    // the readers' acquire fence. The acquire half orders this write after
+    // the previous writer's.
+    std::atomic_thread_fence(std::memory_order_acq_rel);
+    return seq;
+  }
+
+  void writeEnd(std::uint32_t seq) noexcept {
+    m_seq.store(seq + 2, std::memory_order_release);
+  }
+
+  void storeWords(const T &value) noexcept {
+    std::uint64_t words[word_count] = {};
+    std::memcpy(words, &value, sizeof(T));
+    for (std::size_t i = 0; i < word_count; ++i)
+      m_words[i].store(words[i], std::memory_order_relaxed);
+  }
+
+  alignas(util::cache_line_size) std::atomic<std::uint32_t> m_seq = 0;
+  std::atomic<std::uint64_t> m_words[word_count];
+};
+
+} // End of namespace csg
+
+#endif
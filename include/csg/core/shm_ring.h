@@ -0,0 +1,248 @@
+//==-- csg/core/shm_ring.h - ring in shared memory --------------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a ring buffer which lives in a POSIX shared memory object,
+ *     for passing messages between processes.
+ */
+
+#ifndef CSG_CORE_SHM_RING_H
+#define CSG_CORE_SHM_RING_H
+
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <csg/core/assert.h>
+#include <csg/core/ring.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+namespace detail {
+
+// The first cache line of a shm_ring mapping, before the ring_block. It lets
+// a process attaching to the mapping check that it holds the kind of ring
+// the process expects; `magic` is stored last, once the ring is constructed.
+struct alignas(util::cache_line_size) shm_ring_header {
+  constexpr static std::uint64_t magic_value = 0x676e69722d677363; // csg-ring
+  constexpr static std::uint32_t current_version = 1;
+
+  std::atomic<std::uint64_t> magic;
+  std::uint32_t version;
+  std::uint32_t elem_size;
+  std::uint32_t block_size;
+  std::uint32_t count;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "shm_ring needs address-free 64-bit atomics");
+
+} // End of namespace detail
+
+/**
+ * @brief A csg::ring of trivially copyable elements whose control block and
+ *     slots live in a shared memory object, so that separate processes can
+ *     use it as a message queue.
+ *
+ * The shared memory holds a small header, followed by the same pointer-free
+ * control block and slots that csg::ring allocates on the heap, so each
+ * process may map it at a different address. The operations are those of
+ * csg::ring, with the same producer and consumer policies. With
+ * ring_blocking policies, a process sleeps on a futex in the shared memory
+ * and is woken by another process.
+ *
+ * A named ring is made with @ref create and attached to by other processes
+ * with @ref open (the processes must agree on T and the policies, which is
+ * checked only as far as their sizes); the name stays until @ref unlink.
+ * @ref create_anonymous makes a ring in a memfd, whose descriptor (see
+ * @ref fd) is passed on to a child process, or over a Unix socket, and
+ * attached to with @ref attach.
+ *
+ * @code
+ *   using msg_ring = csg::shm_ring<message, csg::ring_multi,
+ *                                  csg::ring_blocking<csg::ring_single>>;
+ *
+ *   auto r = msg_ring::create("/ingest", 4096);    // in the ingest process
+ *   auto r = msg_ring::open("/ingest");            // in the analytics one
+ * @endcode
+ *
+ * Errors from the system calls are thrown as std::system_error.
+ */
+template <typename T, ring_sync_policy Prod = ring_multi,
+          ring_sync_policy Cons = ring_multi>
+class shm_ring : public detail::ring_ops<T, Prod, Cons> {
+  using base = detail::ring_ops<T, Prod, Cons>;
+  using block_type = typename base::block_type;
+  using header = detail::shm_ring_header;
+
+public:
+  using typename base::size_type;
+
+  /// Create the shared memory object `name` (see shm_open(3)), which must
+  /// not already exist, holding an empty ring of `count` slots.
+  static shm_ring create(const char *name, size_type count,
+                         mode_t mode = 0600) {
+    const int fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, mode);
+    if (fd == -1)
+      throw std::system_error{errno, std::generic_category(), name};
+    try {
+      return shm_ring{fd, count};
+    }
+    catch (...) {
+      ::shm_unlink(name);
+      throw;
+    }
+  }
+
+  /// Attach to a ring made by create.
+  static shm_ring open(const char *name) {
+    const int fd = ::shm_open(name, O_RDWR, 0);
+    if (fd == -1)
+      throw std::system_error{errno, std::generic_category(), name};
+    return shm_ring{fd};
+  }
+
+  /// Remove the name of a shared memory ring; the ring lives on until every
+  /// process has closed it.
+  static void unlink(const char *name) noexcept { ::shm_unlink(name); }
+
+#if defined(__linux__)
+  /// Create a ring of `count` slots in an anonymous memfd.
+  static shm_ring create_anonymous(size_type count) {
+    const int fd = ::memfd_create("csg-shm-ring", MFD_CLOEXEC);
+    if (fd == -1)
+      throw std::system_error{errno, std::generic_category(), "memfd_create"};
+    return shm_ring{fd, count};
+  }
+#endif
+
+  /// Attach to the ring in the shared memory referred to by `fd` (e.g., one
+  /// made by create_anonymous in a parent process), taking ownership of the
+  /// descriptor.
+  static shm_ring attach(int fd) { return shm_ring{fd}; }
+
+  shm_ring(shm_ring &&other) noexcept
+      : base{std::exchange(other.m_block, nullptr)},
+        m_fd{std::exchange(other.m_fd, -1)},
+        m_mapping{std::exchange(other.m_mapping, nullptr)},
+        m_mappingSize{other.m_mappingSize} {}
+
+  shm_ring &operator=(shm_ring &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      this->m_block = std::exchange(other.m_block, nullptr);
+      m_fd = std::exchange(other.m_fd, -1);
+      m_mapping = std::exchange(other.m_mapping, nullptr);
+      m_mappingSize = other.m_mappingSize;
+    }
+    return *this;
+  }
+
+  ~shm_ring() { unmap(); }
+
+  /// The shared memory object's descriptor, which remains owned by the ring.
+  int fd() const noexcept { return m_fd; }
+
+  /// The number of bytes of shared memory used by a ring of `count` slots.
+  static std::size_t mapping_size(size_type count) noexcept {
+    return sizeof(header) + block_type::allocation_size(count);
+  }
+
+private:
+  // Size the new object `fd` and construct a ring in it.
+  shm_ring(int fd, size_type count) : base{nullptr}, m_fd{fd} {
+    CSG_ASSERT(std::has_single_bit(count) && count <= base::max_size(),
+               "shm_ring size %zu is not a power of two", count);
+    if (!std::has_single_bit(count) || count > base::max_size()) {
+      ::close(fd);
+      throw std::system_error{std::make_error_code(
+          std::errc::invalid_argument), "shm_ring size"};
+    }
+
+    const std::size_t size = mapping_size(count);
+    if (::ftruncate(fd, static_cast<off_t>(size)) == -1)
+      fail("ftruncate");
+    map(size);
+
+    header *const h = new (m_mapping) header{};
+    h->version = header::current_version;
+    h->elem_size = sizeof(T);
+    h->block_size = sizeof(block_type);
+    h->count = static_cast<std::uint32_t>(count);
+    this->m_block =
+        new (h + 1) block_type{static_cast<std::uint32_t>(count)};
+    h->magic.store(header::magic_value, std::memory_order_release);
+  }
+
+  // Map the existing ring in `fd`, checking that it matches this type.
+  explicit shm_ring(int fd) : base{nullptr}, m_fd{fd} {
+    struct stat st;
+    if (::fstat(fd, &st) == -1)
+      fail("fstat");
+    const auto size = static_cast<std::size_t>(st.st_size);
+    if (size < sizeof(header))
+      fail("shm_ring header", EINVAL);
+    map(size);
+
+    const auto *const h = static_cast<const header *>(m_mapping);
+    if (h->magic.load(std::memory_order_acquire) != header::magic_value ||
+        h->version != header::current_version ||
+        h->elem_size != sizeof(T) || h->block_size != sizeof(block_type) ||
+        !std::has_single_bit(h->count) || size < mapping_size(h->count))
+      fail("shm_ring header", EINVAL);
+    this->m_block = std::launder(reinterpret_cast<block_type *>(
+        static_cast<std::byte *>(m_mapping) + sizeof(header)));
+  }
+
+  void map(std::size_t size) {
+    void *const p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                           m_fd, 0);
+    if (p == MAP_FAILED)
+      fail("mmap");
+    m_mapping = p;
+    m_mappingSize = size;
+  }
+
+  // Release what a constructor has acquired so far, and throw.
+  [[noreturn]] void fail(const char *what, int error = 0) {
+    if (!error)
+      error = errno;
+    unmap();
+    throw std::system_error{error, std::generic_category(), what};
+  }
+
+  void unmap() noexcept {
+    if (m_mapping)
+      ::munmap(m_mapping, m_mappingSize);
+    if (m_fd != -1)
+      ::close(m_fd);
+    m_mapping = nullptr;
+    m_fd = -1;
+    this->m_block = nullptr;
+  }
+
+  int m_fd = -1;
+  void *m_mapping = nullptr;
+  std::size_t m_mappingSize = 0;
+};
+
+} // End of namespace csg
+
+#endif
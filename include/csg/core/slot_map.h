@@ -0,0 +1,452 @@
+//==-- csg/core/slot_map.h - generation-checked slot map --------*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a slot map container, which stores objects in stable,
+ *     contiguous storage and refers to them with compact handles made of an
+ *     index and a generation counter.
+ */
+
+#ifndef CSG_CORE_SLOT_MAP_H
+#define CSG_CORE_SLOT_MAP_H
+
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <csg/core/assert.h>
+#include <csg/core/stailq.h>
+
+namespace csg {
+
+/**
+ * @brief A handle to an object in a @ref slot_map, packing a slot index into
+ *     the low `IndexBits` bits of an unsigned integer and a generation
+ *     counter into the remaining high bits.
+ *
+ * The generation is never zero in a handle returned by a slot map, so a
+ * default-constructed (all zero) handle is a "null" handle which never refers
+ * to any object.
+ */
+template <std::unsigned_integral Rep, unsigned IndexBits>
+class slot_handle {
+public:
+  using rep_type = Rep;
+
+  constexpr static unsigned index_bits = IndexBits;
+  constexpr static unsigned generation_bits =
+      std::numeric_limits<Rep>::digits - IndexBits;
+
+  static_assert(index_bits > 0 && generation_bits > 0,
+                "both the index and the generation need at least one bit");
+
+  constexpr static Rep index_mask = (Rep{1} << index_bits) - 1;
+  constexpr static Rep generation_mask = (Rep{1} << generation_bits) - 1;
+
+  constexpr slot_handle() noexcept : m_rep{0} {}
+
+  constexpr slot_handle(Rep index, Rep generation) noexcept
+      : m_rep{static_cast<Rep>((generation << index_bits) | index)} {
+    CSG_ASSERT(index <= index_mask && generation <= generation_mask);
+  }
+
+  constexpr static slot_handle from_raw(Rep r) noexcept {
+    slot_handle h;
+    h.m_rep = r;
+    return h;
+  }
+
+  constexpr Rep index() const noexcept { return m_rep & index_mask; }
+
+  constexpr Rep generation() const noexcept { return m_rep >> index_bits; }
+
+  constexpr Rep raw() const noexcept { return m_rep; }
+
+  constexpr explicit operator bool() const noexcept { return generation(); }
+
+  constexpr bool operator==(const slot_handle &) const noexcept = default;
+
+  /// Return the generation which follows `g`, skipping zero on wraparound.
+  constexpr static Rep next_generation(Rep g) noexcept {
+    g = (g + 1) & generation_mask;
+    return g ? g : 1;
+  }
+
+private:
+  Rep m_rep;
+};
+
+/// 32-bit handle: up to 1M slots, each of which can be reused 4095 times
+/// before a stale handle could alias a live object.
+using slot_handle32 = slot_handle<std::uint32_t, 20>;
+
+/// 64-bit handle: up to 4G slots with a 32-bit generation counter.
+using slot_handle64 = slot_handle<std::uint64_t, 32>;
+
+template <typename H>
+concept slot_handle_type = std::regular<H> &&
+    std::unsigned_integral<typename H::rep_type> &&
+    std::constructible_from<H, typename H::rep_type, typename H::rep_type> &&
+    requires(const H h, typename H::rep_type r) {
+      { H::index_mask } -> std::convertible_to<typename H::rep_type>;
+      { h.index() } -> std::same_as<typename H::rep_type>;
+      { h.generation() } -> std::same_as<typename H::rep_type>;
+      { H::next_generation(r) } -> std::same_as<typename H::rep_type>;
+    };
+
+/**
+ * @brief Fixed-capacity container providing O(1) insert, erase and lookup
+ *     through generation-checked handles.
+ *
+ * All slots are allocated once, when the slot map is constructed, so objects
+ * never move; their addresses remain valid until they are erased. Objects in
+ * a slot map can therefore be linked into CSD intrusive lists (e.g., by
+ * embedding a tailq_entry) while they are simultaneously referred to by
+ * handle elsewhere.
+ *
+ * Each slot has a generation counter that is advanced when the slot's
+ * object is erased. A handle records the generation at the time of
+ * insertion, so a lookup with a stale handle is detected by one comparison
+ * and returns nullptr instead of a pointer to a recycled object. Free slots
+ * are kept on an intrusive stailq and reused in FIFO order, which spreads
+ * reuse across all free slots and so delays the point at which a generation
+ * counter wraps around.
+ *
+ * Iteration visits the live objects through a dense array of slot indices,
+ * so its cost is proportional to size() rather than capacity(). Erasing an
+ * object moves the last dense index into its place, so iteration order is
+ * unspecified and erasure invalidates iterators (but not other handles or
+ * pointers).
+ *
+ * Like the STL containers, the slot map is not synchronized; generation
+ * checks detect stale handles but do not make concurrent erase and lookup
+ * safe.
+ */
+template <typename T, slot_handle_type Handle = slot_handle32>
+class slot_map {
+  struct slot;
+
+public:
+  using value_type = T;
+  using reference = T &;
+  using const_reference = const T &;
+  using pointer = T *;
+  using const_pointer = const T *;
+  using size_type = std::size_t;
+  using difference_type = std::ptrdiff_t;
+  using handle_type = Handle;
+  using index_type = typename Handle::rep_type;
+
+  template <bool Const>
+  class basic_iterator;
+
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  constexpr static size_type max_capacity =
+      static_cast<size_type>(Handle::index_mask) + 1;
+
+  slot_map() noexcept : m_capacity{0}, m_size{0} {}
+
+  explicit slot_map(size_type capacity)
+      : m_slots{std::make_unique<slot[]>(capacity)},
+        m_dense{std::make_unique_for_overwrite<index_type[]>(capacity)},
+        m_capacity{capacity}, m_size{0} {
+    CSG_ASSERT(capacity <= max_capacity, "capacity %zu exceeds handle range",
+               capacity);
+    for (size_type i = 0; i < capacity; ++i)
+      m_freeList.push_back(&m_slots[i]);
+  }
+
+  slot_map(const slot_map &) = delete;
+
+  slot_map(slot_map &&other) noexcept : slot_map{} { swap(other); }
+
+  ~slot_map() { clear(); }
+
+  slot_map &operator=(const slot_map &) = delete;
+
+  slot_map &operator=(slot_map &&other) noexcept {
+    slot_map{std::move(other)}.swap(*this);
+    return *this;
+  }
+
+  void swap(slot_map &other) noexcept {
+    std::ranges::swap(m_slots, other.m_slots);
+    std::ranges::swap(m_dense, other.m_dense);
+    std::ranges::swap(m_capacity, other.m_capacity);
+    std::ranges::swap(m_size, other.m_size);
+    m_freeList.swap(other.m_freeList);
+  }
+
+  size_type size() const noexcept { return m_size; }
+
+  size_type capacity() const noexcept { return m_capacity; }
+
+  [[nodiscard]] bool empty() const noexcept { return !m_size; }
+
+  bool full() const noexcept { return m_size == m_capacity; }
+
+  /// Construct a new object in a free slot and return its handle, or return
+  /// a null handle if the slot map is full.
+  template <typename... Args>
+      requires std::constructible_from<T, Args...>
+  handle_type emplace(Args &&...args)
+      noexcept(std::is_nothrow_constructible_v<T, Args...>) {
+    if (m_freeList.empty())
+      return {};
+
+    slot &s = m_freeList.front();
+    ::new (s.storage) T(std::forward<Args>(args)...);
+    m_freeList.pop_front();
+
+    const auto index = slotIndex(s);
+    s.denseIndex = static_cast<index_type>(m_size);
+    m_dense[m_size++] = index;
+    return {index, s.generation};
+  }
+
+  handle_type insert(const T &value)
+      noexcept(std::is_nothrow_copy_constructible_v<T>) {
+    return emplace(value);
+  }
+
+  handle_type insert(T &&value)
+      noexcept(std::is_nothrow_move_constructible_v<T>) {
+    return emplace(std::move(value));
+  }
+
+  /// Destroy the object referred to by `h`; returns false if `h` is stale.
+  bool erase(handle_type h) noexcept {
+    slot *const s = findSlot(h);
+    if (!s)
+      return false;
+
+    eraseSlot(*s);
+    return true;
+  }
+
+  iterator erase(const_iterator pos) noexcept {
+    CSG_ASSERT(pos != end(), "end() iterator passed to erase");
+    const auto denseIndex = pos.m_denseIndex;
+    eraseSlot(m_slots[m_dense[denseIndex]]);
+    return {this, denseIndex};
+  }
+
+  void clear() noexcept {
+    while (m_size)
+      eraseSlot(m_slots[m_dense[m_size - 1]]);
+  }
+
+  bool contains(handle_type h) const noexcept { return findSlot(h); }
+
+  /// Return a pointer to the object referred to by `h`, or nullptr if `h`
+  /// is stale or null.
+  pointer get(handle_type h) noexcept {
+    slot *const s = findSlot(h);
+    return s ? s->value() : nullptr;
+  }
+
+  const_pointer get(handle_type h) const noexcept {
+    return const_cast<slot_map *>(this)->get(h);
+  }
+
+  /// Access the object referred to by `h`, which must not be stale.
+  reference operator[](handle_type h) noexcept {
+    pointer const p = get(h);
+    CSG_ASSERT(p, "stale slot_map handle %#jx",
+               static_cast<std::uintmax_t>(h.raw()));
+    return *p;
+  }
+
+  const_reference operator[](handle_type h) const noexcept {
+    return const_cast<slot_map &>(*this)[h];
+  }
+
+  /// Return the handle for an object stored in this slot map.
+  handle_type get_handle(const_reference value) const noexcept {
+    const slot &s = *std::launder(reinterpret_cast<const slot *>(
+        std::addressof(value)));
+    return {slotIndex(s), s.generation};
+  }
+
+  iterator begin() noexcept { return {this, 0}; }
+  const_iterator begin() const noexcept { return {this, 0}; }
+  const_iterator cbegin() const noexcept { return begin(); }
+
+  iterator end() noexcept { return {this, m_size}; }
+  const_iterator end() const noexcept { return {this, m_size}; }
+  const_iterator cend() const noexcept { return end(); }
+
+private:
+  // The object storage is the first member, so that a pointer to the object
+  // can be converted back into a pointer to its slot.
+  struct slot {
+    alignas(T) std::byte storage[sizeof(T)];
+    stailq_entry<slot> freeEntry;
+    index_type generation = 1;
+    index_type denseIndex;
+
+    T *value() noexcept {
+      return std::launder(reinterpret_cast<T *>(storage));
+    }
+  };
+
+  using free_list_type = CSG_STAILQ_HEAD_OFFSET_T(slot, freeEntry);
+
+  index_type slotIndex(const slot &s) const noexcept {
+    return static_cast<index_type>(&s - m_slots.get());
+  }
+
+  slot *findSlot(handle_type h) const noexcept {
+    if (h.index() >= m_capacity)
+      return nullptr;
+    slot &s = m_slots[h.index()];
+    return s.generation == h.generation() && s.denseIndex < m_size &&
+        m_dense[s.denseIndex] == h.index() ? &s : nullptr;
+  }
+
+  void eraseSlot(slot &s) noexcept {
+    std::destroy_at(s.value());
+    s.generation = static_cast<index_type>(
+        handle_type::next_generation(s.generation));
+
+    // Move the last dense entry into the erased entry's position.
+    const index_type last = m_dense[--m_size];
+    m_dense[s.denseIndex] = last;
+    m_slots[last].denseIndex = s.denseIndex;
+
+    m_freeList.push_back(&s);
+  }
+
+  std::unique_ptr<slot[]> m_slots;
+  std::unique_ptr<index_type[]> m_dense;
+  size_type m_capacity;
+  size_type m_size;
+  free_list_type m_freeList;
+};
+
+/// Random access iterator over the live objects of a slot_map, in dense
+/// (unspecified) order.
+template <typename T, slot_handle_type Handle>
+template <bool Const>
+class slot_map<T, Handle>::basic_iterator {
+  using map_type = std::conditional_t<Const, const slot_map, slot_map>;
+
+public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = T;
+  using difference_type = std::ptrdiff_t;
+  using pointer = std::conditional_t<Const, const T *, T *>;
+  using reference = std::conditional_t<Const, const T &, T &>;
+
+  constexpr basic_iterator() noexcept : m_map{nullptr}, m_denseIndex{0} {}
+
+  constexpr basic_iterator(const basic_iterator &) = default;
+
+  constexpr basic_iterator(const basic_iterator<false> &i) noexcept
+      requires Const
+      : m_map{i.m_map}, m_denseIndex{i.m_denseIndex} {}
+
+  reference operator*() const noexcept {
+    return *m_map->m_slots[m_map->m_dense[m_denseIndex]].value();
+  }
+
+  pointer operator->() const noexcept { return std::addressof(**this); }
+
+  reference operator[](difference_type n) const noexcept {
+    return *(*this + n);
+  }
+
+  /// The handle of the object the iterator refers to.
+  handle_type handle() const noexcept {
+    const auto index = m_map->m_dense[m_denseIndex];
+    return {index, m_map->m_slots[index].generation};
+  }
+
+  constexpr basic_iterator &operator=(const basic_iterator &) = default;
+
+  basic_iterator &operator++() noexcept { ++m_denseIndex; return *this; }
+  basic_iterator &operator--() noexcept { --m_denseIndex; return *this; }
+
+  basic_iterator operator++(int) noexcept {
+    auto i = *this;
+    ++*this;
+    return i;
+  }
+
+  basic_iterator operator--(int) noexcept {
+    auto i = *this;
+    --*this;
+    return i;
+  }
+
+  basic_iterator &operator+=(difference_type n) noexcept {
+    m_denseIndex = static_cast<size_type>(
+        static_cast<difference_type>(m_denseIndex) + n);
+    return *this;
+  }
+
+  basic_iterator &operator-=(difference_type n) noexcept {
+    return *this += -n;
+  }
+
+  friend basic_iterator operator+(basic_iterator i, difference_type n) noexcept {
+    return i += n;
+  }
+
+  friend basic_iterator operator+(difference_type n, basic_iterator i) noexcept {
+    return i += n;
+  }
+
+  friend basic_iterator operator-(basic_iterator i, difference_type n) noexcept {
+    return i -= n;
+  }
+
+  friend difference_type operator-(const basic_iterator &lhs,
+                                   const basic_iterator &rhs) noexcept {
+    return static_cast<difference_type>(lhs.m_denseIndex) -
+        static_cast<difference_type>(rhs.m_denseIndex);
+  }
+
+  bool operator==(const basic_iterator &rhs) const noexcept {
+    return m_denseIndex == rhs.m_denseIndex;
+  }
+
+  auto operator<=>(const basic_iterator &rhs) const noexcept {
+    return m_denseIndex <=> rhs.m_denseIndex;
+  }
+
+private:
+  friend class slot_map;
+
+  template <bool>
+  friend class basic_iterator;
+
+  basic_iterator(map_type *m, size_type denseIndex) noexcept
+      : m_map{m}, m_denseIndex{denseIndex} {}
+
+  map_type *m_map;
+  size_type m_denseIndex;
+};
+
+template <typename T, slot_handle_type H>
+void swap(slot_map<T, H> &lhs, slot_map<T, H> &rhs) noexcept {
+  lhs.swap(rhs);
+}
+
+} // End of namespace csg
+
+#endif
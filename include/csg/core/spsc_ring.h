@@ -0,0 +1,274 @@
+//==-- csg/core/spsc_ring.h - single-producer/consumer ring -----*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains a cache-optimized ring buffer for exactly one producer
+ *     thread and one consumer thread.
+ */
+
+#ifndef CSG_CORE_SPSC_RING_H
+#define CSG_CORE_SPSC_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include <csg/core/assert.h>
+#include <csg/core/ring.h>
+#include <csg/core/utility.h>
+
+namespace csg {
+
+/**
+ * @brief A fixed-capacity FIFO queue for one producer thread and one
+ *     consumer thread, designed to minimize cache-line transfers between
+ *     them.
+ *
+ * Each side publishes its index on a cache line of its own, and keeps a
+ * private copy (on yet another line) of the last index it read from the
+ * other side. A side only reloads the other side's index when its cached
+ * copy makes the ring look full (for the producer) or empty (for the
+ * consumer), so while the ring is neither, the two threads share no cache
+ * lines except the slots themselves.
+ *
+ * In addition, each side may publish its index only once every
+ * `publish_batch` operations, so that under load the index line moves
+ * between the cores about once per batch rather than once per element. A
+ * side with unpublished operations publishes them when it would otherwise
+ * fail (a push to a full ring, or a pop from an empty one), so the two
+ * threads cannot wait for each other forever; but a producer which stops
+ * pushing should call @ref flush_pushes so that the consumer sees its last
+ * elements, and likewise a consumer should call @ref flush_pops before it
+ * goes idle.
+ *
+ * Slots hold default-constructed T objects for the whole life of the ring;
+ * push assigns to a slot, and pop move-assigns out of it. Large elements
+ * can avoid both copies with the zero-copy operations: @ref reserve returns
+ * a ring_region of free slots for the producer to fill in place, and
+ * @ref commit pushes them; @ref peek and @ref release do the same for the
+ * consumer.
+ */
+template <typename T>
+  requires std::default_initializable<T> && std::movable<T>
+class spsc_ring {
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+
+  /// Create a ring of `count` slots, which must be a power of two; each
+  /// side publishes its index every `publish_batch` operations.
+  explicit spsc_ring(size_type count, size_type publish_batch = 1)
+      : m_shared{std::make_unique<T[]>(count),
+                 static_cast<std::uint32_t>(count - 1),
+                 static_cast<std::uint32_t>(std::clamp<size_type>(
+                     publish_batch, 1, count))} {
+    CSG_ASSERT(std::has_single_bit(count) && count <= max_size(),
+               "spsc_ring size %zu is not a power of two", count);
+  }
+
+  spsc_ring(const spsc_ring &) = delete;
+
+  spsc_ring &operator=(const spsc_ring &) = delete;
+
+  constexpr static size_type max_size() noexcept {
+    return size_type{1} << 31;
+  }
+
+  size_type capacity() const noexcept { return size_type{m_shared.mask} + 1; }
+
+  size_type publish_batch() const noexcept { return m_shared.batch; }
+
+  /// The number of published elements; only a snapshot, since the other
+  /// side may be running.
+  size_type size() const noexcept {
+    return m_writeIdx.value.load(std::memory_order_relaxed) -
+           m_readIdx.value.load(std::memory_order_relaxed);
+  }
+
+  bool empty() const noexcept { return !size(); }
+
+  //===---------------------------- Producer -----------------------------===//
+
+  template <typename U>
+    requires std::assignable_from<T &, U &&>
+  bool push(U &&value) noexcept(std::is_nothrow_assignable_v<T &, U &&>) {
+    if (!reserveFree(1))
+      return false;
+    m_shared.slots[m_prod.head & m_shared.mask] = std::forward<U>(value);
+    ++m_prod.head;
+    maybePublishPushes();
+    return true;
+  }
+
+  /// Push as many of `values` as fit; returns the number pushed.
+  size_type push_burst(std::span<const T> values) {
+    const std::uint32_t n = reserveFree(narrow(values.size()));
+    for (std::uint32_t i = 0; i < n; ++i)
+      m_shared.slots[(m_prod.head + i) & m_shared.mask] = values[i];
+    m_prod.head += n;
+    maybePublishPushes();
+    return n;
+  }
+
+  /// Zero-copy push, first step: up to `n` free slots, which the producer
+  /// assigns in place before calling @ref commit.
+  ring_region<T> reserve(size_type n) noexcept {
+    return detail::ring_region_at(m_shared.slots.get(), m_shared.mask,
+                                  m_prod.head, reserveFree(narrow(n)));
+  }
+
+  /// Zero-copy push, second step: push the first `n` slots of the last
+  /// reserved region.
+  void commit(size_type n) noexcept {
+    CSG_ASSERT(n <= capacity() - (m_prod.head - m_prod.cachedRead),
+               "committed more slots than were reserved");
+    m_prod.head += static_cast<std::uint32_t>(n);
+    maybePublishPushes();
+  }
+
+  /// Make all pushed elements visible to the consumer.
+  void flush_pushes() noexcept {
+    if (m_prod.head != m_prod.published) {
+      m_prod.published = m_prod.head;
+      m_writeIdx.value.store(m_prod.head, std::memory_order_release);
+    }
+  }
+
+  //===---------------------------- Consumer -----------------------------===//
+
+  bool pop(T &value) noexcept(std::is_nothrow_move_assignable_v<T>) {
+    if (!reserveFilled(1))
+      return false;
+    value = std::move(m_shared.slots[m_cons.head & m_shared.mask]);
+    ++m_cons.head;
+    maybePublishPops();
+    return true;
+  }
+
+  /// Pop up to `values.size()` elements; returns the number popped.
+  size_type pop_burst(std::span<T> values) {
+    const std::uint32_t n = reserveFilled(narrow(values.size()));
+    for (std::uint32_t i = 0; i < n; ++i)
+      values[i] = std::move(m_shared.slots[(m_cons.head + i) & m_shared.mask]);
+    m_cons.head += n;
+    maybePublishPops();
+    return n;
+  }
+
+  /// Zero-copy pop, first step: up to `n` elements at the head of the ring,
+  /// which the consumer may use (or move from) in place, until it calls
+  /// @ref release.
+  ring_region<T> peek(size_type n) noexcept {
+    return detail::ring_region_at(m_shared.slots.get(), m_shared.mask,
+                                  m_cons.head, reserveFilled(narrow(n)));
+  }
+
+  /// Zero-copy pop, second step: pop the first `n` peeked elements.
+  void release(size_type n) noexcept {
+    CSG_ASSERT(n <= m_cons.cachedWrite - m_cons.head,
+               "released more slots than were peeked");
+    m_cons.head += static_cast<std::uint32_t>(n);
+    maybePublishPops();
+  }
+
+  /// Make all popped slots available to the producer.
+  void flush_pops() noexcept {
+    if (m_cons.head != m_cons.published) {
+      m_cons.published = m_cons.head;
+      m_readIdx.value.store(m_cons.head, std::memory_order_release);
+    }
+  }
+
+private:
+  static std::uint32_t narrow(size_type n) noexcept {
+    return static_cast<std::uint32_t>(std::min(n, max_size()));
+  }
+
+  // Returns min(n, free slots), reloading the consumer's index only if the
+  // cached copy does not show enough room.
+  std::uint32_t reserveFree(std::uint32_t n) noexcept {
+    const std::uint32_t cap = m_shared.mask + 1;
+    std::uint32_t free = cap - (m_prod.head - m_prod.cachedRead);
+
+    if (free < n) [[unlikely]] {
+      m_prod.cachedRead = m_readIdx.value.load(std::memory_order_acquire);
+      free = cap - (m_prod.head - m_prod.cachedRead);
+      if (!free)
+        flush_pushes();
+    }
+
+    return std::min(n, free);
+  }
+
+  std::uint32_t reserveFilled(std::uint32_t n) noexcept {
+    std::uint32_t used = m_cons.cachedWrite - m_cons.head;
+
+    if (used < n) [[unlikely]] {
+      m_cons.cachedWrite = m_writeIdx.value.load(std::memory_order_acquire);
+      used = m_cons.cachedWrite - m_cons.head;
+      if (!used)
+        flush_pops();
+    }
+
+    return std::min(n, used);
+  }
+
+  void maybePublishPushes() noexcept {
+    if (m_prod.head - m_prod.published >= m_shared.batch)
+      flush_pushes();
+  }
+
+  void maybePublishPops() noexcept {
+    if (m_cons.head - m_cons.published >= m_shared.batch)
+      flush_pops();
+  }
+
+  // Read-only after construction.
+  struct alignas(util::cache_line_size) shared_state {
+    std::unique_ptr<T[]> slots;
+    std::uint32_t mask;
+    std::uint32_t batch;
+  };
+
+  struct alignas(util::cache_line_size) published_index {
+    std::atomic<std::uint32_t> value = 0;
+  };
+
+  // Private to one side; `head` is the next index to use, `published` the
+  // value last stored to this side's published_index, and `cachedRead` /
+  // `cachedWrite` the other side's index as last loaded.
+  struct alignas(util::cache_line_size) producer_state {
+    std::uint32_t head = 0;
+    std::uint32_t published = 0;
+    std::uint32_t cachedRead = 0;
+  };
+
+  struct alignas(util::cache_line_size) consumer_state {
+    std::uint32_t head = 0;
+    std::uint32_t published = 0;
+    std::uint32_t cachedWrite = 0;
+  };
+
+  shared_state m_shared;
+  published_index m_writeIdx;
+  published_index m_readIdx;
+  producer_state m_prod;
+  consumer_state m_cons;
+};
+
+} // End of namespace csg
+
+#endif
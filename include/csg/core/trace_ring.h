@@ -0,0 +1,389 @@
+//==-- csg/core/trace_ring.h - per-thread event trace rings -----*- C++ -*-==//
+//
+//                Cyril Software Data Structures (CSD) Library
+//
+// This file is distributed under the 2-clause BSD Open Source License. See
+// LICENSE.TXT for details.
+//==-----------------------------------------------------------------------==//
+
+/**
+ * @file
+ * @brief Contains an always-on, in-memory event trace in the style of
+ *     FreeBSD's ktr(4), kept in an overwrite-oldest ring per thread.
+ */
+
+#ifndef CSG_CORE_TRACE_RING_H
+#define CSG_CORE_TRACE_RING_H
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <csg/core/utility.h>
+
+/// The number of entries in each thread's trace ring; a power of two.
+#ifndef CSG_TRACE_RING_ENTRIES
+#define CSG_TRACE_RING_ENTRIES 1024
+#endif
+
+/// Record a trace event, formatted with printf-style `fmt` when dumped.
+#define CSG_TRACE(fmt, ...) \
+  ::csg::trace(__FILE__, __LINE__, fmt __VA_OPT__(,) __VA_ARGS__)
+
+namespace csg {
+
+/**
+ * @brief One trace event: a timestamp, where it was recorded, and the format
+ *     string and arguments of its message, which is only formatted when the
+ *     trace is dumped.
+ *
+ * The format must be a string literal (or otherwise outlive the process),
+ * and so must any `%s` argument. Each argument is stored in 64 bits:
+ * integers, enums and pointers as their value, and floating-point numbers
+ * as the bits of a double.
+ */
+struct trace_entry {
+  constexpr static std::size_t max_args = 4;
+
+  std::uint64_t timestamp;
+  const char *format;
+  const char *file;
+  std::uint32_t line;
+  std::uint32_t thread;
+  std::uint64_t args[max_args];
+};
+
+static_assert(sizeof(trace_entry) == 64);
+
+/// The number of threads whose trace rings are kept; the threads started
+/// after the first `max_trace_threads` record nothing.
+constexpr std::size_t max_trace_threads = 256;
+
+namespace detail {
+
+// The trace ring of one thread. Only its owner writes entries and `head`;
+// a dump may run concurrently (from another thread, or a signal handler),
+// and may then see a torn copy of the oldest entry, as ktr(4) does.
+struct alignas(util::cache_line_size) trace_ring_buffer {
+  constexpr static std::size_t capacity = CSG_TRACE_RING_ENTRIES;
+  constexpr static std::size_t mask = capacity - 1;
+
+  static_assert(std::has_single_bit(capacity),
+                "CSG_TRACE_RING_ENTRIES must be a power of two");
+
+  std::atomic<std::uint64_t> head = 0;     // Entries ever written.
+  std::atomic<bool> inUse = false;         // Owned by a live thread.
+  std::uint32_t thread = 0;                // Index of the current owner.
+  std::uint64_t dumpCursor = 0;            // Only used while dumping.
+  trace_entry entries[capacity];
+};
+
+// All trace rings ever made. Rings are never freed: the ring of a thread
+// which exits keeps its entries for postmortem dumps, until another thread
+// takes it over. The registry is a fixed array so that a signal handler or
+// a debugger can walk it without locks.
+struct trace_registry {
+  std::atomic<trace_ring_buffer *> rings[max_trace_threads] = {};
+  std::atomic<std::uint32_t> ringCount = 0;
+  std::atomic<std::uint32_t> nextThread = 0;
+  std::atomic_flag dumping = ATOMIC_FLAG_INIT;
+};
+
+inline constinit trace_registry trace_registry_instance{};
+
+struct trace_tls {
+  ~trace_tls() {
+    if (ring)
+      ring->inUse.store(false, std::memory_order_release);
+  }
+
+  trace_ring_buffer *ring = nullptr;
+  bool exhausted = false;
+};
+
+inline thread_local trace_tls trace_thread_ring;
+
+inline std::uint64_t trace_timestamp() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return static_cast<std::uint64_t>(
+      std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+// Take over the ring of an exited thread, or register a new one.
+inline trace_ring_buffer *attach_trace_ring() noexcept {
+  trace_registry &reg = trace_registry_instance;
+  trace_tls &tls = trace_thread_ring;
+  const std::uint32_t count = reg.ringCount.load(std::memory_order_acquire);
+  trace_ring_buffer *ring = nullptr;
+
+  for (std::uint32_t i = 0; i < count && !ring; ++i) {
+    trace_ring_buffer *const r = reg.rings[i].load(std::memory_order_acquire);
+    bool expected = false;
+    if (r && r->inUse.compare_exchange_strong(expected, true,
+                                              std::memory_order_acquire))
+      ring = r;
+  }
+
+  if (!ring) {
+    const std::uint32_t slot =
+        reg.ringCount.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= max_trace_threads) {
+      reg.ringCount.store(max_trace_threads, std::memory_order_relaxed);
+      tls.exhausted = true;
+      return nullptr;
+    }
+
+    // Tracing is a diagnostic facility, so if we cannot even allocate the
+    // ring there is nothing sensible to do but stop.
+    ring = new (std::nothrow) trace_ring_buffer;
+    if (!ring)
+      std::terminate();
+    ring->inUse.store(true, std::memory_order_relaxed);
+    reg.rings[slot].store(ring, std::memory_order_release);
+  }
+
+  ring->thread = reg.nextThread.fetch_add(1, std::memory_order_relaxed);
+  tls.ring = ring;
+  return ring;
+}
+
+template <typename T>
+std::uint64_t trace_arg(T value) noexcept {
+  if constexpr (std::is_floating_point_v<T>)
+    return std::bit_cast<std::uint64_t>(static_cast<double>(value));
+  else if constexpr (std::is_pointer_v<T> || std::is_null_pointer_v<T>)
+    return reinterpret_cast<std::uintptr_t>(value);
+  else if constexpr (std::is_enum_v<T>)
+    return static_cast<std::uint64_t>(
+        static_cast<std::underlying_type_t<T>>(value));
+  else
+    return static_cast<std::uint64_t>(value);
+}
+
+// Format one entry's message into `buf` without allocating, by formatting
+// each conversion separately with its argument converted to the type the
+// conversion expects. Returns the length, truncated to `size - 1`.
+inline std::size_t format_trace_message(const trace_entry &e, char *buf,
+                                        std::size_t size) noexcept {
+  std::size_t len = 0;
+  std::size_t arg = 0;
+  auto room = [&] { return size - 1 - len; };
+
+  for (const char *f = e.format; *f && room(); ) {
+    if (*f != '%' || f[1] == '%') {
+      buf[len++] = *f;
+      f += *f == '%' ? 2 : 1;
+      continue;
+    }
+
+    // Copy the flags, width and precision of the conversion, drop its
+    // length modifier, and then add the one matching our argument type.
+    char spec[24] = {'%'};
+    std::size_t specLen = 1;
+    ++f;
+    while (*f && std::strchr("-+ #0123456789.", *f) && specLen < 16)
+      spec[specLen++] = *f++;
+    while (*f && std::strchr("hljztL", *f))
+      ++f;
+    const char conv = *f ? *f++ : 's';
+
+    const std::uint64_t a = arg < trace_entry::max_args ? e.args[arg++] : 0;
+    int n;
+    if (std::strchr("diouxX", conv)) {
+      spec[specLen++] = 'l';
+      spec[specLen++] = 'l';
+      spec[specLen++] = conv;
+      n = conv == 'd' || conv == 'i'
+          ? std::snprintf(buf + len, room() + 1, spec,
+                          static_cast<long long>(a))
+          : std::snprintf(buf + len, room() + 1, spec,
+                          static_cast<unsigned long long>(a));
+    }
+    else if (std::strchr("fFeEgGaA", conv)) {
+      spec[specLen++] = conv;
+      n = std::snprintf(buf + len, room() + 1, spec,
+                        std::bit_cast<double>(a));
+    }
+    else if (conv == 'c') {
+      spec[specLen++] = conv;
+      n = std::snprintf(buf + len, room() + 1, spec, static_cast<int>(a));
+    }
+    else if (conv == 's') {
+      spec[specLen++] = conv;
+      const char *const s = reinterpret_cast<const char *>(a);
+      n = std::snprintf(buf + len, room() + 1, spec, s ? s : "(null)");
+    }
+    else {
+      // %p, and anything unknown (including %n, which is never honored).
+      n = std::snprintf(buf + len, room() + 1, "%#llx",
+                        static_cast<unsigned long long>(a));
+    }
+
+    if (n > 0)
+      len += std::min(static_cast<std::size_t>(n), room());
+  }
+
+  buf[len] = '\0';
+  return len;
+}
+
+// Call `fn` on every retained entry of every ring, oldest first across all
+// threads, without locking or allocating. Returns the number of entries, or
+// zero if another dump is in progress.
+template <std::invocable<const trace_entry &> Fn>
+std::size_t for_each_trace_entry(Fn fn) noexcept {
+  trace_registry &reg = trace_registry_instance;
+  if (reg.dumping.test_and_set(std::memory_order_acquire))
+    return 0;
+
+  const std::uint32_t count = std::min<std::uint32_t>(
+      reg.ringCount.load(std::memory_order_acquire), max_trace_threads);
+  std::uint64_t heads[max_trace_threads];
+
+  for (std::uint32_t i = 0; i < count; ++i) {
+    if (trace_ring_buffer *const r =
+            reg.rings[i].load(std::memory_order_acquire)) {
+      heads[i] = r->head.load(std::memory_order_acquire);
+      r->dumpCursor = heads[i] - std::min<std::uint64_t>(
+          heads[i], trace_ring_buffer::capacity);
+    }
+  }
+
+  // A k-way merge by timestamp; O(entries * threads), which is fine for a
+  // postmortem dump and needs no memory.
+  std::size_t n = 0;
+  for (;;) {
+    trace_ring_buffer *next = nullptr;
+    for (std::uint32_t i = 0; i < count; ++i) {
+      trace_ring_buffer *const r = reg.rings[i].load(std::memory_order_relaxed);
+      if (r && r->dumpCursor != heads[i] &&
+          (!next || r->entries[r->dumpCursor & trace_ring_buffer::mask]
+                        .timestamp <
+                    next->entries[next->dumpCursor & trace_ring_buffer::mask]
+                        .timestamp))
+        next = r;
+    }
+    if (!next)
+      break;
+    fn(next->entries[next->dumpCursor++ & trace_ring_buffer::mask]);
+    ++n;
+  }
+
+  reg.dumping.clear(std::memory_order_release);
+  return n;
+}
+
+} // End of namespace detail
+
+/**
+ * @brief Record a trace event in the calling thread's trace ring; usually
+ *     called through the CSG_TRACE macro.
+ *
+ * This never blocks and, after the thread's first event, never allocates: it
+ * reads the timestamp counter and writes one 64 byte entry, overwriting the
+ * thread's oldest entry once its ring is full.
+ */
+template <typename... Args>
+  requires (sizeof...(Args) <= trace_entry::max_args)
+void trace(const char *file, unsigned line, const char *format,
+           Args... args) noexcept {
+  detail::trace_tls &tls = detail::trace_thread_ring;
+  detail::trace_ring_buffer *ring = tls.ring;
+  if (!ring) [[unlikely]] {
+    if (tls.exhausted || !(ring = detail::attach_trace_ring()))
+      return;
+  }
+
+  const std::uint64_t head = ring->head.load(std::memory_order_relaxed);
+  trace_entry &e = ring->entries[head & detail::trace_ring_buffer::mask];
+  e.timestamp = detail::trace_timestamp();
+  e.format = format;
+  e.file = file;
+  e.line = line;
+  e.thread = ring->thread;
+  const std::uint64_t values[trace_entry::max_args] = {
+      detail::trace_arg(args)...};
+  std::memcpy(e.args, values, sizeof values);
+  ring->head.store(head + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Write all retained trace events of all threads to `fd`, one per
+ *     line, merged in timestamp order.
+ *
+ * The dump takes no locks and does not allocate, so it may be called from a
+ * signal handler (e.g., for SIGSEGV or SIGABRT) as well as from a debugger;
+ * it formats with snprintf, which is not formally async-signal-safe, but
+ * only with integer, floating-point and string conversions. Returns the
+ * number of events written, or zero if another dump is in progress.
+ */
+inline std::size_t trace_dump(int fd) noexcept {
+  return detail::for_each_trace_entry([fd](const trace_entry &e) {
+    char line[512];
+    int n = std::snprintf(line, sizeof line, "%20llu %4u %s:%u: ",
+                          static_cast<unsigned long long>(e.timestamp),
+                          e.thread, e.file, e.line);
+    n = std::clamp(n, 0, static_cast<int>(sizeof line) - 2);
+    std::size_t len = static_cast<std::size_t>(n);
+    len += detail::format_trace_message(e, line + len, sizeof line - 1 - len);
+    line[len++] = '\n';
+    for (const char *p = line; len;) {
+      const ssize_t w = ::write(fd, p, len);
+      if (w <= 0)
+        break;
+      p += w;
+      len -= static_cast<std::size_t>(w);
+    }
+  });
+}
+
+/// Copy all retained trace events, in timestamp order.
+inline std::vector<trace_entry> trace_snapshot() {
+  // The walk must not throw, or the dump in progress would never end; a
+  // failed allocation skips the remaining entries and is rethrown after it.
+  std::vector<trace_entry> entries;
+  std::exception_ptr error;
+  detail::for_each_trace_entry([&](const trace_entry &e) {
+    if (error)
+      return;
+    try {
+      entries.push_back(e);
+    }
+    catch (...) {
+      error = std::current_exception();
+    }
+  });
+  if (error)
+    std::rethrow_exception(error);
+  return entries;
+}
+
+/// Format the message of `e` into `buf`, as trace_dump does; returns the
+/// length, truncated to `size - 1`.
+inline std::size_t format_trace_message(const trace_entry &e, char *buf,
+                                        std::size_t size) noexcept {
+  return size ? detail::format_trace_message(e, buf, size) : 0;
+}
+
+} // End of namespace csg
+
+#endif
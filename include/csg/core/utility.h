@@ -20,15 +20,62 @@
 #ifndef CSG_CORE_UTILITY_H
 #define CSG_CORE_UTILITY_H
 
+#include <bit>
 #include <compare>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iterator>
 #include <new>
+#include <type_traits>
+
+#include <sched.h>
 
 namespace csg::util {
 
+// The size of a cache line, used to align data that would otherwise suffer
+// from false sharing. std::hardware_destructive_interference_size is not
+// used because gcc warns that its value may change between compiler
+// versions (and thus between translation units), which would make the
+// layouts that depend on it ABI-unstable.
+constexpr std::size_t cache_line_size = 64;
+
+// Hint to the CPU that the caller is busy-waiting, e.g., for another thread
+// to publish a ring index; this saves power and, on SMT cores, yields
+// execution resources to the sibling thread.
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+// Busy-wait helper for short waits on other threads, e.g., for a ring
+// producer to publish its tail. It spins with cpu_relax for a while, and
+// then yields the CPU on each further call, so that a waiter does not burn
+// its whole time slice when the thread it waits for has been preempted
+// (which is common when there are more threads than CPUs).
+class spin_backoff {
+public:
+  constexpr static unsigned spin_limit = 64;
+
+  void pause() noexcept {
+    if (m_spins < spin_limit) {
+      ++m_spins;
+      cpu_relax();
+    }
+    else
+      sched_yield();
+  }
+
+  void reset() noexcept { m_spins = 0; }
+
+private:
+  unsigned m_spins = 0;
+};
+
 constexpr std::ptrdiff_t type_not_found = -1;
 
 template <typename T, typename U, typename... Us>
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+
+#include <catch2/catch.hpp>
+#include <csg/core/adaptive_mutex.h>
+
+using namespace csg;
+
+TEST_CASE("adaptive_mutex.basic", "[adaptive_mutex][basic]") {
+  adaptive_mutex m{"test"};
+  REQUIRE( m.name() == std::string_view{"test"} );
+  REQUIRE( !m.held() );
+  REQUIRE( m.owner() == std::thread::id{} );
+
+  {
+    const std::lock_guard guard{m};
+    REQUIRE( m.held() );
+    REQUIRE( m.owner() == std::this_thread::get_id() );
+    REQUIRE( !m.contested() );
+
+    bool locked = true;
+    bool held = true;
+    std::thread{[&] {
+      locked = m.try_lock();
+      held = m.held();
+    }}.join();
+    REQUIRE( !locked );
+    REQUIRE( !held );
+  }
+  REQUIRE( !m.held() );
+  REQUIRE( m.try_lock() );
+  m.unlock();
+}
+
+TEST_CASE("adaptive_mutex.handoff", "[adaptive_mutex][handoff]") {
+  constexpr int Waiters = 4;
+
+  // Waiters which cannot spin sleep on the queue, and are woken one at a
+  // time as the mutex is released.
+  adaptive_mutex m;
+  std::vector<int> order;
+  std::vector<std::thread> threads;
+  m.lock();
+  for (int i = 0; i < Waiters; ++i) {
+    threads.emplace_back([&, i] {
+      const std::lock_guard guard{m};
+      order.push_back(i);
+    });
+
+    // A spinning waiter queues once its spin limit is reached.
+    while (!m.contested())
+      std::this_thread::yield();
+  }
+  REQUIRE( m.contested() );
+  m.unlock();
+  for (auto &t : threads)
+    t.join();
+  REQUIRE( order.size() == Waiters );
+  REQUIRE( !m.contested() );
+  REQUIRE( !m.held() );
+}
+
+TEST_CASE("adaptive_mutex.requeue", "[adaptive_mutex][handoff]") {
+  constexpr int Rounds = 1000;
+  constexpr int Lost = 10;
+
+  // A woken waiter which loses the mutex to a running thread requeues with
+  // the handoff bit, and the next unlock makes it the owner directly, so the
+  // mutex is never free in between. The waiter may win the race instead, in
+  // which case there is nothing to check for that round.
+  adaptive_mutex m;
+  int lost = 0;
+  int handedOff = 0;
+  for (int round = 0; round < Rounds && lost < Lost; ++round) {
+    std::atomic<bool> release = false;
+    m.lock();
+    std::thread waiter{[&] {
+#if defined(__linux__)
+      // At idle priority, the waiter does not preempt this thread when it
+      // is woken, so that this thread can take the mutex back.
+      const sched_param param{};
+      sched_setscheduler(0, SCHED_IDLE, &param);
+#endif
+      const std::lock_guard guard{m};
+      while (!release.load(std::memory_order_relaxed))
+        std::this_thread::yield();
+    }};
+    while (!m.contested())
+      std::this_thread::yield();
+
+    // Wake the waiter, and take the mutex back before it runs.
+    m.unlock();
+    if (m.try_lock()) {
+      ++lost;
+      while (!m.contested())
+        std::this_thread::yield();
+      m.unlock();
+      if (!m.try_lock())
+        handedOff += m.owner() == waiter.get_id();
+      else
+        m.unlock();
+    }
+    release = true;
+    waiter.join();
+  }
+  REQUIRE( lost > 0 );
+  REQUIRE( handedOff == lost );
+  REQUIRE( !m.contested() );
+  REQUIRE( !m.held() );
+}
+
+TEST_CASE("adaptive_mutex.exclusion", "[adaptive_mutex][exclusion]") {
+  constexpr int Threads = 6;
+  constexpr int Rounds = 5000;
+
+  // A plain counter, incremented under the mutex, loses no increment, with
+  // threads both spinning and sleeping.
+  adaptive_mutex m;
+  std::uint64_t count = 0;
+  std::atomic<int> inside = 0;
+  std::atomic<int> errors = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < Threads; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < Rounds; ++i) {
+        const std::lock_guard guard{m};
+        errors += inside.fetch_add(1, std::memory_order_relaxed) != 0;
+        ++count;
+        inside.fetch_sub(1, std::memory_order_relaxed);
+        if (i % 64 == 0)
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  REQUIRE( errors == 0 );
+  REQUIRE( count == Threads * Rounds );
+  REQUIRE( !m.contested() );
+
+  // Exited threads' records are reused, and a new thread can take the mutex.
+  std::thread{[&] { const std::lock_guard guard{m}; ++count; }}.join();
+  REQUIRE( count == Threads * Rounds + 1 );
+}
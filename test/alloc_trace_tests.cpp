@@ -0,0 +1,140 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/alloc_trace.h>
+
+using namespace csg;
+
+TEST_CASE("alloc_trace.event", "[alloc_trace][event]") {
+  int x = 0;
+  const auto e = alloc_trace_event::make(alloc_trace_kind::deallocate, 12345,
+                                         &x, 1000, 64, 7);
+
+  REQUIRE( e.timestamp == 12345 );
+  REQUIRE( e.address == reinterpret_cast<std::uintptr_t>(&x) );
+  REQUIRE( e.size() == 1000 );
+  REQUIRE( e.alignment() == 64 );
+  REQUIRE( e.kind() == alloc_trace_kind::deallocate );
+  REQUIRE( e.thread() == 7 );
+}
+
+TEST_CASE("alloc_trace.record", "[alloc_trace][record]") {
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{std::tmpfile(),
+                                                           &std::fclose};
+  REQUIRE( f );
+
+  constexpr int PerThread = 10000;
+  {
+    alloc_trace_log log{f.get()};
+    trace_resource r{log};
+
+    // Two threads allocate from the traced resource, to check that the
+    // per-thread buffers are merged correctly.
+    auto work = [&r] {
+      std::vector<void *> ptrs;
+      for (int i = 0; i < PerThread; ++i)
+        ptrs.push_back(r.allocate(16 + i % 100, 16));
+      for (int i = 0; i < PerThread; ++i)
+        r.deallocate(ptrs[i], 16 + i % 100, 16);
+    };
+
+    std::thread t{work};
+    work();
+    t.join();
+
+    REQUIRE( log.thread_count() == 2 );
+  }
+
+  std::rewind(f.get());
+  const auto events = read_alloc_trace(f.get());
+  REQUIRE( events.size() == 4 * PerThread );
+
+  // Events are in timestamp order, every deallocation matches a preceding
+  // allocation of the same size, and each thread performed half the work.
+  std::map<std::uint64_t, alloc_trace_event> live;
+  std::size_t perThread[2] = {};
+  std::uint64_t lastTimestamp = 0;
+
+  for (const auto &e : events) {
+    REQUIRE( e.timestamp >= lastTimestamp );
+    lastTimestamp = e.timestamp;
+    REQUIRE( e.alignment() == 16 );
+    REQUIRE( e.thread() < 2 );
+    ++perThread[e.thread()];
+
+    if (e.kind() == alloc_trace_kind::allocate)
+      REQUIRE( live.emplace(e.address, e).second );
+    else {
+      const auto i = live.find(e.address);
+      REQUIRE( i != live.end() );
+      REQUIRE( i->second.size() == e.size() );
+      REQUIRE( i->second.thread() == e.thread() );
+      live.erase(i);
+    }
+  }
+
+  REQUIRE( live.empty() );
+  REQUIRE( perThread[0] == 2 * PerThread );
+  REQUIRE( perThread[1] == 2 * PerThread );
+}
+
+TEST_CASE("alloc_trace.two_logs", "[alloc_trace][record]") {
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> f1{std::tmpfile(),
+                                                            &std::fclose};
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> f2{std::tmpfile(),
+                                                            &std::fclose};
+  REQUIRE( f1 );
+  REQUIRE( f2 );
+
+  // A thread alternating between two logs keeps one buffer and one thread
+  // index in each, however often it switches.
+  constexpr int Events = 100000;
+  {
+    alloc_trace_log log1{f1.get()};
+    alloc_trace_log log2{f2.get()};
+    trace_resource r1{log1};
+    trace_resource r2{log2};
+
+    std::thread{[&] {
+      for (int i = 0; i < Events; ++i) {
+        r1.deallocate(r1.allocate(16, 16), 16, 16);
+        r2.deallocate(r2.allocate(32, 16), 32, 16);
+      }
+    }}.join();
+    REQUIRE( log1.thread_count() == 1 );
+    REQUIRE( log2.thread_count() == 1 );
+
+    // Another thread takes the next index.
+    std::thread{[&] {
+      r1.deallocate(r1.allocate(16, 16), 16, 16);
+    }}.join();
+    REQUIRE( log1.thread_count() == 2 );
+  }
+
+  std::rewind(f1.get());
+  const auto events1 = read_alloc_trace(f1.get());
+  REQUIRE( events1.size() == 2 * Events + 2 );
+  REQUIRE( events1.front().thread() == 0 );
+  REQUIRE( events1.back().thread() == 1 );
+
+  std::rewind(f2.get());
+  const auto events2 = read_alloc_trace(f2.get());
+  REQUIRE( events2.size() == 2 * Events );
+  REQUIRE( events2.front().size() == 32 );
+  REQUIRE( events2.back().thread() == 0 );
+}
+
+TEST_CASE("alloc_trace.bad_file", "[alloc_trace][error]") {
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{std::tmpfile(),
+                                                           &std::fclose};
+  std::fputs("this is not a trace file", f.get());
+  std::rewind(f.get());
+  REQUIRE_THROWS_AS( read_alloc_trace(f.get()), std::system_error );
+}
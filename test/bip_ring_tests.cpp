@@ -0,0 +1,191 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/bip_ring.h>
+
+using namespace csg;
+
+namespace {
+
+std::vector<std::byte> make_record(std::size_t length, std::uint8_t seed) {
+  std::vector<std::byte> r(length);
+  for (std::size_t i = 0; i < length; ++i)
+    r[i] = static_cast<std::byte>(seed + i);
+  return r;
+}
+
+bool equal(std::span<const std::byte> a, std::span<const std::byte> b) {
+  return a.size() == b.size() &&
+         (a.empty() || !std::memcmp(a.data(), b.data(), a.size()));
+}
+
+} // End of anonymous namespace
+
+TEMPLATE_TEST_CASE("bip_ring.basic", "[bip_ring][basic][template]",
+                   ring_single, ring_multi) {
+  bip_ring<TestType> r{256};
+  std::span<std::byte> rec;
+
+  REQUIRE( r.capacity() == 256 );
+  REQUIRE( r.max_record_size() == 120 );
+  REQUIRE( !r.peek(rec) );
+
+  const auto a = make_record(10, 1);
+  const auto b = make_record(0, 2);
+  const auto c = make_record(100, 3);
+
+  REQUIRE( r.write(a) );
+  REQUIRE( r.write(b) );
+  REQUIRE( r.write(c) );
+  REQUIRE( r.bytes_used() == 24 + 8 + 112 );
+
+  for (const auto *expected : {&a, &b, &c}) {
+    REQUIRE( r.peek(rec) );
+    REQUIRE( equal(rec, *expected) );
+    REQUIRE( reinterpret_cast<std::uintptr_t>(rec.data()) %
+             bip_ring<TestType>::record_alignment == 0 );
+    r.release();
+  }
+
+  REQUIRE( !r.peek(rec) );
+  REQUIRE( r.empty() );
+}
+
+TEMPLATE_TEST_CASE("bip_ring.wrap", "[bip_ring][wrap][template]",
+                   ring_single, ring_multi) {
+  bip_ring<TestType> r{256};
+  std::span<std::byte> rec;
+
+  // Write and remove two records of 112 bytes each (with their headers), so
+  // that the next 64 byte record (72 with its header) does not fit before
+  // the end of the buffer.
+  const auto filler = make_record(100, 0);
+  for (int i = 0; i < 2; ++i) {
+    REQUIRE( r.write(filler) );
+    REQUIRE( r.peek(rec) );
+    r.release();
+  }
+  REQUIRE( r.empty() );
+
+  const auto a = make_record(64, 7);
+  auto res = r.reserve(a.size());
+  REQUIRE( res );
+  REQUIRE( res.data().size() == 64 );
+
+  // The record was placed at the start of the buffer, after padding out the
+  // 32 bytes at the end: it is never split.
+  std::memcpy(res.data().data(), a.data(), a.size());
+  r.commit(res);
+  REQUIRE( r.bytes_used() == 32 + 72 );
+
+  REQUIRE( r.peek(rec) );
+  REQUIRE( equal(rec, a) );
+  r.release();
+  REQUIRE( r.empty() );
+}
+
+TEST_CASE("bip_ring.full", "[bip_ring][full]") {
+  bip_ring<ring_single> r{128};
+  std::span<std::byte> rec;
+
+  const auto a = make_record(56, 1);
+  REQUIRE( r.write(a) );
+  REQUIRE( r.write(a) );
+  REQUIRE( !r.write(make_record(1, 0)) );
+  REQUIRE( !r.reserve(0) );
+
+  REQUIRE( r.peek(rec) );
+  r.release();
+  REQUIRE( r.write(make_record(1, 0)) );
+}
+
+TEST_CASE("bip_ring.mpsc", "[bip_ring][threads]") {
+  constexpr std::size_t Producers = 3;
+  constexpr std::uint32_t PerProducer = 5000;
+
+  bip_ring<ring_multi> r{4096};
+
+  // Each record holds the producer number, its sequence number, and then
+  // filler bytes derived from both, for a length of 8 to 200 bytes.
+  std::vector<std::thread> producers;
+  for (std::uint32_t p = 0; p < Producers; ++p) {
+    producers.emplace_back([&r, p] {
+      for (std::uint32_t seq = 0; seq < PerProducer;) {
+        const std::size_t length = 8 + (seq * 7 + p) % 193;
+        auto res = r.reserve(length);
+        if (!res) {
+          std::this_thread::yield();
+          continue;
+        }
+        std::byte *const d = res.data().data();
+        std::memcpy(d, &p, 4);
+        std::memcpy(d + 4, &seq, 4);
+        for (std::size_t i = 8; i < length; ++i)
+          d[i] = static_cast<std::byte>(p + seq + i);
+        r.commit(res);
+        ++seq;
+      }
+    });
+  }
+
+  std::vector<std::uint32_t> next(Producers);
+  bool ok = true;
+  std::span<std::byte> rec;
+
+  for (std::size_t n = 0; n < Producers * PerProducer;) {
+    if (!r.peek(rec)) {
+      std::this_thread::yield();
+      continue;
+    }
+
+    std::uint32_t p, seq;
+    std::memcpy(&p, rec.data(), 4);
+    std::memcpy(&seq, rec.data() + 4, 4);
+    ok &= p < Producers && seq == next[p]++;
+    ok &= rec.size() == 8 + (seq * 7 + p) % 193;
+    for (std::size_t i = 8; i < rec.size(); ++i)
+      ok &= rec[i] == static_cast<std::byte>(p + seq + i);
+
+    r.release();
+    ++n;
+  }
+
+  for (auto &t : producers)
+    t.join();
+
+  REQUIRE( ok );
+  REQUIRE( r.empty() );
+}
+
+TEST_CASE("bip_ring.blocking", "[bip_ring][blocking][threads]") {
+  constexpr std::size_t Records = 20000;
+  bip_ring<ring_blocking<ring_single>, ring_blocking<ring_single>> r{256};
+
+  std::thread producer{[&] {
+    for (std::uint32_t seq = 0; seq < Records; ++seq) {
+      const std::size_t length = 4 + seq % 97;
+      const auto res = r.reserve_wait(length);
+      std::memcpy(res.data().data(), &seq, 4);
+      r.commit(res);
+    }
+  }};
+
+  bool ok = true;
+  std::span<std::byte> rec;
+  for (std::uint32_t seq = 0; seq < Records; ++seq) {
+    r.peek_wait(rec);
+    std::uint32_t got;
+    std::memcpy(&got, rec.data(), 4);
+    ok &= got == seq && rec.size() == 4 + seq % 97;
+    r.release();
+  }
+
+  producer.join();
+  REQUIRE( ok );
+  REQUIRE( r.empty() );
+}
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/bitstring.h>
+
+using namespace csg;
+
+// Sizes chosen to exercise partial words, partial vector blocks, and multiple
+// whole cache lines.
+constexpr std::size_t TestSizes[] = { 1, 63, 64, 65, 255, 256, 257, 511, 512,
+                                      1000, 4096, 5000 };
+
+namespace {
+
+// Reference implementations of the searches, used to validate the
+// vectorized implementation on random bit strings.
+std::ptrdiff_t naive_find(const std::vector<bool> &v, std::size_t start,
+                          bool value) {
+  for (std::size_t i = start; i < v.size(); ++i) {
+    if (v[i] == value)
+      return static_cast<std::ptrdiff_t>(i);
+  }
+  return bitstring::not_found;
+}
+
+std::ptrdiff_t naive_find_area(const std::vector<bool> &v, std::size_t start,
+                               std::size_t n, bool value) {
+  std::size_t run = 0;
+  for (std::size_t i = start; i < v.size(); ++i) {
+    run = (v[i] == value) ? run + 1 : 0;
+    if (run == n)
+      return static_cast<std::ptrdiff_t>(i + 1 - n);
+  }
+  return bitstring::not_found;
+}
+
+std::size_t naive_count(const std::vector<bool> &v, std::size_t start,
+                        std::size_t n) {
+  std::size_t c = 0;
+  for (std::size_t i = start; i < start + n; ++i)
+    c += v[i];
+  return c;
+}
+
+// Fill a bit string with runs of random length, so there are long runs of
+// both values (which exercise the word skipping code) as well as short ones.
+std::vector<bool> random_runs(bitstring &b, std::mt19937 &gen,
+                              std::size_t maxRun) {
+  std::vector<bool> v(b.size());
+  std::uniform_int_distribution<std::size_t> runLen{1, maxRun};
+  bool value = gen() & 1;
+
+  for (std::size_t i = 0; i < b.size(); value = !value) {
+    const std::size_t n = std::min(runLen(gen), b.size() - i);
+    if (value)
+      b.nset(i, i + n - 1);
+    for (std::size_t j = 0; j < n; ++j)
+      v[i + j] = value;
+    i += n;
+  }
+
+  return v;
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("bitstring.empty", "[bitstring][empty]") {
+  bitstring b;
+
+  REQUIRE( b.size() == 0 );
+  REQUIRE( b.empty() );
+  REQUIRE( b.words().empty() );
+  REQUIRE( b.ffs() == bitstring::not_found );
+  REQUIRE( b.ffc() == bitstring::not_found );
+  REQUIRE( b.ffc_area(1) == bitstring::not_found );
+  REQUIRE( b.count() == 0 );
+}
+
+TEST_CASE("bitstring.basic", "[bitstring][basic]") {
+  for (const std::size_t size : TestSizes) {
+    bitstring b{size};
+    INFO("size: " << size);
+
+    REQUIRE( b.size() == size );
+    REQUIRE( b.words().size() == (size + 63) / 64 );
+    REQUIRE( b.ffs() == bitstring::not_found );
+    REQUIRE( b.ffc() == 0 );
+    REQUIRE( b.count() == 0 );
+
+    b.set(size - 1);
+    REQUIRE( b.test(size - 1) );
+    REQUIRE( b[size - 1] );
+    REQUIRE( b.ffs() == static_cast<std::ptrdiff_t>(size - 1) );
+    REQUIRE( b.count() == 1 );
+
+    b.set_all();
+    REQUIRE( b.count() == size );
+    REQUIRE( b.ffs() == 0 );
+    REQUIRE( b.ffc() == bitstring::not_found );
+    REQUIRE( b.ffs_area(size) == 0 );
+    REQUIRE( b.ffs_area(size + 1) == bitstring::not_found );
+
+    b.clear(size - 1);
+    REQUIRE( !b.test(size - 1) );
+    REQUIRE( b.ffc() == static_cast<std::ptrdiff_t>(size - 1) );
+    REQUIRE( b.ffc_area(1) == static_cast<std::ptrdiff_t>(size - 1) );
+    REQUIRE( b.ffc_area(2) == bitstring::not_found );
+    REQUIRE( b.count() == size - 1 );
+
+    b.clear_all();
+    REQUIRE( b.count() == 0 );
+    REQUIRE( b.ffc_area(size) == 0 );
+  }
+}
+
+TEST_CASE("bitstring.nset_nclear", "[bitstring][nset][nclear]") {
+  bitstring b{1000};
+
+  b.nset(10, 10);
+  REQUIRE( b.count() == 1 );
+  REQUIRE( b.test(10) );
+
+  b.nset(60, 200);
+  REQUIRE( b.count() == 142 );
+  REQUIRE( b.ffs_at(11) == 60 );
+  REQUIRE( b.ffc_at(60) == 201 );
+  REQUIRE( b.count(60, 141) == 141 );
+  REQUIRE( b.count(59, 143) == 141 );
+
+  b.nclear(64, 127);
+  REQUIRE( b.count() == 78 );
+  REQUIRE( b.ffc_at(60) == 64 );
+  REQUIRE( b.ffs_at(64) == 128 );
+  REQUIRE( b.ffc_area_at(11, 64) == 64 );
+  REQUIRE( b.ffc_area_at(11, 65) == 201 );
+  REQUIRE( b.ffs_area(73) == 128 );
+  REQUIRE( b.ffs_area(74) == bitstring::not_found );
+}
+
+TEST_CASE("bitstring.copy_move", "[bitstring][copy][move]") {
+  bitstring b{300};
+  b.nset(100, 299);
+
+  bitstring c{b};
+  REQUIRE( c == b );
+  c.clear(299);
+  REQUIRE( c != b );
+
+  bitstring d{std::move(c)};
+  REQUIRE( c.empty() );
+  REQUIRE( d.count() == 199 );
+
+  c = b;
+  REQUIRE( c == b );
+
+  swap(c, d);
+  REQUIRE( c.count() == 199 );
+  REQUIRE( d == b );
+}
+
+TEST_CASE("bitstring.random", "[bitstring][random]") {
+  std::mt19937 gen{1234};
+
+  for (const std::size_t size : TestSizes) {
+    for (const std::size_t maxRun : { 3, 70, 700 }) {
+      bitstring b{size};
+      const auto v = random_runs(b, gen, maxRun);
+      INFO("size: " << size << ", maxRun: " << maxRun);
+
+      REQUIRE( b.count() == naive_count(v, 0, size) );
+
+      std::uniform_int_distribution<std::size_t> pos{0, size - 1};
+      for (int trial = 0; trial < 50; ++trial) {
+        const std::size_t start = pos(gen);
+        const std::size_t n = 1 + pos(gen) % 200;
+        INFO("start: " << start << ", n: " << n);
+
+        REQUIRE( b.ffs_at(start) == naive_find(v, start, true) );
+        REQUIRE( b.ffc_at(start) == naive_find(v, start, false) );
+        REQUIRE( b.ffs_area_at(start, n) == naive_find_area(v, start, n, true) );
+        REQUIRE( b.ffc_area_at(start, n) == naive_find_area(v, start, n, false) );
+
+        const std::size_t len = std::min(n * 10, size - start);
+        REQUIRE( b.count(start, len) == naive_count(v, start, len) );
+      }
+    }
+  }
+}
@@ -0,0 +1,162 @@
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/buf_ring.h>
+
+using namespace csg;
+
+namespace {
+
+struct message {
+  std::size_t producer;
+  std::size_t seq;
+};
+
+} // End of anonymous namespace
+
+TEST_CASE("buf_ring.basic", "[buf_ring][basic]") {
+  buf_ring<int *> ring{4};
+  int v[5];
+
+  REQUIRE( ring.capacity() == 4 );
+  REQUIRE( ring.empty() );
+  REQUIRE( ring.dequeue_sc() == nullptr );
+  REQUIRE( ring.peek() == nullptr );
+
+  for (int i = 0; i < 4; ++i)
+    REQUIRE( ring.enqueue(&v[i]) );
+
+  REQUIRE( ring.full() );
+  REQUIRE( ring.size() == 4 );
+  REQUIRE( !ring.enqueue(&v[4]) );
+  REQUIRE( ring.drops() == 1 );
+
+  REQUIRE( ring.dequeue_sc() == &v[0] );
+  REQUIRE( ring.enqueue(&v[4]) );
+
+  for (int i = 1; i < 5; ++i)
+    REQUIRE( ring.dequeue_sc() == &v[i] );
+  REQUIRE( ring.empty() );
+}
+
+TEST_CASE("buf_ring.peek", "[buf_ring][peek]") {
+  buf_ring<int *> ring{8};
+  int v[3];
+
+  for (int &i : v)
+    ring.enqueue(&i);
+
+  REQUIRE( ring.peek() == &v[0] );
+  REQUIRE( ring.peek() == &v[0] );
+  ring.advance_sc();
+  REQUIRE( ring.size() == 2 );
+
+  int replacement;
+  REQUIRE( ring.peek() == &v[1] );
+  ring.putback_sc(&replacement);
+  REQUIRE( ring.size() == 2 );
+  REQUIRE( ring.dequeue_sc() == &replacement );
+  REQUIRE( ring.dequeue_sc() == &v[2] );
+  REQUIRE( ring.peek() == nullptr );
+}
+
+TEST_CASE("buf_ring.wraparound", "[buf_ring][basic]") {
+  buf_ring<int *> ring{4};
+  int v[3];
+
+  // Move the indices through many laps of the ring.
+  for (int lap = 0; lap < 1000; ++lap) {
+    for (int &i : v)
+      REQUIRE( ring.enqueue(&i) );
+    for (int &i : v)
+      REQUIRE( ring.dequeue_sc() == &i );
+  }
+  REQUIRE( ring.empty() );
+}
+
+TEST_CASE("buf_ring.mp_sc", "[buf_ring][threads]") {
+  constexpr std::size_t Producers = 4;
+  constexpr std::size_t PerProducer = 20000;
+
+  buf_ring<message *> ring{64};
+  std::vector<message> msgs(Producers * PerProducer);
+
+  std::vector<std::thread> producers;
+  for (std::size_t p = 0; p < Producers; ++p) {
+    producers.emplace_back([&, p] {
+      for (std::size_t i = 0; i < PerProducer; ++i) {
+        message *const m = &msgs[p * PerProducer + i];
+        *m = {p, i};
+        while (!ring.enqueue(m))
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  // Each producer's messages must arrive in the order it sent them.
+  std::vector<std::size_t> nextSeq(Producers);
+  std::size_t received = 0;
+  bool ordered = true;
+
+  while (received < msgs.size()) {
+    if (message *const m = ring.dequeue_sc()) {
+      ordered &= m->seq == nextSeq[m->producer]++;
+      ++received;
+    }
+    else
+      std::this_thread::yield();
+  }
+
+  for (auto &t : producers)
+    t.join();
+
+  REQUIRE( ordered );
+  REQUIRE( ring.empty() );
+}
+
+TEST_CASE("buf_ring.mp_mc", "[buf_ring][threads]") {
+  constexpr std::size_t Threads = 3;
+  constexpr std::size_t PerThread = 20000;
+
+  buf_ring<message *> ring{16};
+  std::vector<message> msgs(Threads * PerThread);
+  std::vector<std::vector<std::uint8_t>> seen(Threads,
+      std::vector<std::uint8_t>(msgs.size()));
+
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < Threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (std::size_t i = 0; i < PerThread; ++i) {
+        message *const m = &msgs[t * PerThread + i];
+        while (!ring.enqueue(m))
+          std::this_thread::yield();
+      }
+    });
+    threads.emplace_back([&, t] {
+      for (std::size_t n = 0; n < PerThread;) {
+        if (message *const m = ring.dequeue_mc()) {
+          ++seen[t][static_cast<std::size_t>(m - msgs.data())];
+          ++n;
+        }
+        else
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  for (auto &t : threads)
+    t.join();
+
+  // Every message was dequeued exactly once.
+  bool once = true;
+  for (std::size_t i = 0; i < msgs.size(); ++i) {
+    std::size_t count = 0;
+    for (const auto &s : seen)
+      count += s[i];
+    once &= count == 1;
+  }
+  REQUIRE( once );
+}
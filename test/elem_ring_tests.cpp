@@ -0,0 +1,140 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/elem_ring.h>
+
+using namespace csg;
+
+namespace {
+
+// Elements of `N` bytes, which hold a sequence number and fill the rest with
+// bytes derived from it; N = 4, 8, 16 and 32 take the chunked copy, 24 and 64
+// the memmove one.
+template <std::size_t N>
+struct elem {
+  std::uint32_t seq;
+  std::array<std::uint8_t, N - 4> fill;
+
+  static elem make(std::uint32_t seq) {
+    elem e{seq, {}};
+    for (std::size_t i = 0; i < e.fill.size(); ++i)
+      e.fill[i] = static_cast<std::uint8_t>(seq + i);
+    return e;
+  }
+
+  bool valid(std::uint32_t expected) const {
+    return *this == make(expected);
+  }
+
+  bool operator==(const elem &) const = default;
+};
+
+template <std::size_t N>
+struct elem_test {
+  using value_type = elem<N>;
+};
+
+// Transfer elements through `Ring` with three producers and one consumer.
+template <typename Ring>
+bool transfer() {
+  constexpr std::uint32_t PerProducer = 20000;
+  constexpr std::uint32_t Producers = 3;
+  using E = typename Ring::value_type;
+  Ring r{64};
+
+  std::vector<std::thread> producers;
+  for (std::uint32_t p = 0; p < Producers; ++p) {
+    producers.emplace_back([&, p] {
+      std::array<E, 5> burst;
+      for (std::uint32_t i = 0; i < PerProducer;) {
+        const std::uint32_t n = std::min<std::uint32_t>(5, PerProducer - i);
+        for (std::uint32_t j = 0; j < n; ++j)
+          burst[j] = E::make((i + j) * Producers + p);
+        const std::size_t sent = r.enqueue_burst(std::span{burst.data(), n});
+        i += static_cast<std::uint32_t>(sent);
+        if (!sent)
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  std::vector<std::uint32_t> next(Producers);
+  for (std::uint32_t p = 0; p < Producers; ++p)
+    next[p] = p;
+  bool ok = true;
+  std::array<E, 7> burst;
+
+  for (std::uint32_t n = 0; n < Producers * PerProducer;) {
+    const std::size_t got = r.dequeue_burst(burst);
+    for (std::size_t i = 0; i < got; ++i) {
+      const std::uint32_t p = burst[i].seq % Producers;
+      ok &= burst[i].valid(next[p]);
+      next[p] += Producers;
+    }
+    n += static_cast<std::uint32_t>(got);
+    if (!got)
+      std::this_thread::yield();
+  }
+
+  for (auto &t : producers)
+    t.join();
+  return ok && r.empty();
+}
+
+} // End of anonymous namespace
+
+TEMPLATE_TEST_CASE("elem_ring.bulk", "[elem_ring][bulk][template]",
+                   elem_test<4>, elem_test<8>, elem_test<16>, elem_test<24>,
+                   elem_test<32>, elem_test<64>) {
+  using E = typename TestType::value_type;
+  elem_ring<E, ring_single, ring_single> r{8};
+  std::array<E, 12> in, out;
+
+  for (std::uint32_t i = 0; i < in.size(); ++i)
+    in[i] = E::make(i);
+
+  REQUIRE( r.enqueue_bulk(std::span{in.data(), 6}) == 6 );
+  REQUIRE( r.enqueue_bulk(std::span{in.data() + 6, 3}) == 0 );
+  REQUIRE( r.dequeue_bulk(std::span{out.data(), 4}) == 4 );
+  for (std::uint32_t i = 0; i < 4; ++i)
+    REQUIRE( out[i].valid(i) );
+
+  // Wraps around the end of the slots, and copies more than one chunk.
+  REQUIRE( r.enqueue_burst(std::span{in.data() + 6, 6}) == 6 );
+  REQUIRE( r.full() );
+  REQUIRE( r.dequeue_burst(out) == 8 );
+  for (std::uint32_t i = 0; i < 8; ++i)
+    REQUIRE( out[i].valid(i + 4) );
+
+  REQUIRE( r.enqueue(E::make(99)) );
+  E one;
+  REQUIRE( r.dequeue(one) );
+  REQUIRE( one.valid(99) );
+  REQUIRE( r.empty() );
+}
+
+TEST_CASE("elem_ring.zero_copy", "[elem_ring][zero_copy]") {
+  elem_ring<elem<64>, ring_single, ring_single> r{4};
+
+  auto region = r.reserve(3);
+  REQUIRE( region.size() == 3 );
+  for (std::uint32_t i = 0; i < 3; ++i)
+    region[i] = elem<64>::make(i);
+  r.commit(3);
+
+  auto peeked = r.peek(4);
+  REQUIRE( peeked.size() == 3 );
+  REQUIRE( peeked[2].valid(2) );
+  r.release(3);
+  REQUIRE( r.empty() );
+}
+
+TEST_CASE("elem_ring.threads", "[elem_ring][threads]") {
+  REQUIRE( transfer<elem_ring<elem<16>, ring_multi, ring_single>>() );
+  REQUIRE( transfer<elem_ring<elem<24>, ring_rts, ring_hts>>() );
+}
@@ -0,0 +1,187 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/epoch.h>
+
+using namespace csg;
+
+namespace {
+
+struct node : epoch_context {
+  std::uint64_t value = 0;
+  std::atomic<bool> freed = false;
+  std::atomic<int> *counter = nullptr;
+};
+
+// Marks the node freed rather than deleting it, so readers can check that
+// no node they can reach has been freed.
+void mark_freed(epoch_context *c) {
+  node *const n = static_cast<node *>(c);
+  n->freed.store(true, std::memory_order_relaxed);
+  if (n->counter)
+    ++*n->counter;
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("epoch.basic", "[epoch][basic]") {
+  epoch e;
+  std::atomic<int> freed = 0;
+
+  REQUIRE( !e.in_section() );
+  {
+    epoch_guard g{e};
+    REQUIRE( e.in_section() );
+    e.enter();
+    e.exit();
+    REQUIRE( e.in_section() );
+  }
+  REQUIRE( !e.in_section() );
+
+  // Nodes are freed only after a grace period, in batches.
+  std::vector<node> nodes(epoch::batch_size - 1);
+  const std::uint64_t start = e.current();
+  for (node &n : nodes) {
+    n.counter = &freed;
+    e.call_epoch(&n, mark_freed);
+  }
+  REQUIRE( freed == 0 );
+  REQUIRE( e.current() == start );
+
+  e.drain_callbacks();
+  REQUIRE( freed == epoch::batch_size - 1 );
+  REQUIRE( e.current() >= start + 2 );
+}
+
+TEST_CASE("epoch.reader_blocks", "[epoch][reader]") {
+  epoch e;
+  std::atomic<int> freed = 0;
+  std::atomic<bool> entered = false;
+  std::atomic<bool> release = false;
+
+  // A section in another thread keeps every node retired after it entered
+  // from being freed, however many batches are retired.
+  std::thread reader{[&] {
+    epoch_guard g{e};
+    entered = true;
+    while (!release)
+      std::this_thread::yield();
+  }};
+  while (!entered)
+    std::this_thread::yield();
+
+  std::vector<node> nodes(4 * epoch::batch_size);
+  for (node &n : nodes) {
+    n.counter = &freed;
+    e.call_epoch(&n, mark_freed);
+  }
+  REQUIRE( freed == 0 );
+
+  // The writer waits for the reader to exit.
+  std::atomic<bool> waited = false;
+  std::thread waiter{[&] {
+    e.wait_for_grace_period();
+    waited = true;
+  }};
+  for (int i = 0; i < 100; ++i)
+    std::this_thread::yield();
+  REQUIRE( !waited );
+
+  release = true;
+  reader.join();
+  waiter.join();
+  REQUIRE( waited );
+  e.drain_callbacks();
+  REQUIRE( freed == static_cast<int>(nodes.size()) );
+}
+
+TEST_CASE("epoch.threads", "[epoch][threads]") {
+  constexpr int Readers = 3;
+  constexpr int Updates = 5000;
+
+  // The writer keeps replacing the current node and retiring the old one;
+  // readers must never reach a node which has been freed.
+  epoch e;
+  std::vector<std::unique_ptr<node>> all;
+  all.push_back(std::make_unique<node>());
+  std::atomic<node *> current = all.back().get();
+  std::atomic<bool> done = false;
+  std::atomic<int> errors = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < Readers; ++t) {
+    threads.emplace_back([&] {
+      std::uint64_t last = 0;
+      for (std::uint64_t n = 1; !done; ++n) {
+        {
+          epoch_guard g{e};
+          const node *const p = current.load(std::memory_order_acquire);
+          errors += p->freed.load(std::memory_order_relaxed);
+          errors += p->value < last;
+          last = p->value;
+          if (n % 32 == 0)
+            std::this_thread::yield();
+          errors += p->freed.load(std::memory_order_relaxed);
+        }
+        if (n % 16 == 0)
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  for (int i = 1; i <= Updates; ++i) {
+    all.push_back(std::make_unique<node>());
+    all.back()->value = static_cast<std::uint64_t>(i);
+    node *const old = current.exchange(all.back().get(),
+                                       std::memory_order_acq_rel);
+    e.call_epoch(old, mark_freed);
+    if (i % 64 == 0)
+      std::this_thread::yield();
+  }
+  done = true;
+  for (auto &t : threads)
+    t.join();
+
+  REQUIRE( errors == 0 );
+  e.drain_callbacks();
+  for (int i = 0; i < Updates; ++i)
+    REQUIRE( all[i]->freed );
+  REQUIRE( !all.back()->freed );
+}
+
+TEST_CASE("epoch.lifetime", "[epoch][lifetime]") {
+  std::atomic<int> freed = 0;
+  std::vector<node> nodes(10);
+  for (node &n : nodes)
+    n.counter = &freed;
+
+  {
+    // The nodes retired by an exited thread are freed by another thread.
+    epoch e;
+    std::thread{[&] {
+      for (int i = 0; i < 5; ++i)
+        e.call_epoch(&nodes[i], mark_freed);
+    }}.join();
+    REQUIRE( freed == 0 );
+    e.drain_callbacks();
+    REQUIRE( freed == 5 );
+
+    // The destructor frees the nodes which are still pending.
+    for (int i = 5; i < 10; ++i)
+      e.call_epoch(&nodes[i], mark_freed);
+  }
+  REQUIRE( freed == 10 );
+
+  // A thread's records of destroyed domains are reclaimed, and a new domain
+  // (perhaps at the same address) gets a new record.
+  for (int i = 0; i < 100; ++i) {
+    auto e = std::make_unique<epoch>();
+    epoch_guard g{*e};
+    REQUIRE( e->in_section() );
+  }
+}
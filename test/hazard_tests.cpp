@@ -0,0 +1,237 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/epoch.h>
+#include <csg/core/hazard.h>
+
+using namespace csg;
+
+namespace {
+
+struct node : hazard_context {
+  std::atomic<bool> freed = false;
+  std::atomic<int> *counter = nullptr;
+};
+
+void mark_freed(hazard_context *c) {
+  node *const n = static_cast<node *>(c);
+  n->freed.store(true, std::memory_order_relaxed);
+  if (n->counter)
+    ++*n->counter;
+}
+
+// A Treiber stack parameterized by its reclamation policy. Nodes are never
+// deleted, only marked freed, so that poppers can check that no node they
+// reach has been freed.
+template <reclamation_domain Domain>
+class stack {
+public:
+  struct node : Domain::node_type {
+    node *next;
+    int value;
+    std::atomic<bool> freed = false;
+  };
+
+  explicit stack(Domain &d) noexcept : m_domain{d} {}
+
+  void push(node *n) noexcept {
+    n->next = m_head.load(std::memory_order_relaxed);
+    while (!m_head.compare_exchange_weak(n->next, n,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed));
+  }
+
+  std::optional<int> pop() noexcept {
+    typename Domain::guard g{m_domain};
+    node *n = g.protect(m_head, 0);
+    while (n) {
+      errors += n->freed.load(std::memory_order_relaxed);
+      if (m_head.compare_exchange_weak(n, n->next, std::memory_order_acquire,
+                                       std::memory_order_relaxed))
+        break;
+      n = g.protect(m_head, 0);
+    }
+    if (!n)
+      return std::nullopt;
+
+    const int v = n->value;
+    m_domain.retire(n, [](typename Domain::node_type *c) {
+      static_cast<node *>(c)->freed.store(true, std::memory_order_relaxed);
+    });
+    return v;
+  }
+
+  std::atomic<int> errors = 0;
+
+private:
+  Domain &m_domain;
+  std::atomic<node *> m_head = nullptr;
+};
+
+} // End of anonymous namespace
+
+TEST_CASE("hazard.basic", "[hazard][basic]") {
+  hazard_domain d;
+  std::atomic<int> freed = 0;
+  node a, b;
+  a.counter = b.counter = &freed;
+  std::atomic<node *> src = &a;
+
+  // A protected node is not freed until its hazard pointer lets go of it.
+  hazard_pointer hp{d};
+  REQUIRE( hp.protect(src) == &a );
+  src = &b;
+  d.retire(&a, mark_freed);
+  d.reclaim();
+  REQUIRE( freed == 0 );
+  REQUIRE( d.retired_count() == 1 );
+
+  REQUIRE( hp.protect(src) == &b );
+  d.reclaim();
+  REQUIRE( a.freed );
+  REQUIRE( d.retired_count() == 0 );
+
+  hp.reset();
+  d.retire(&b, mark_freed);
+  d.reclaim();
+  REQUIRE( b.freed );
+  REQUIRE( freed == 2 );
+}
+
+TEST_CASE("hazard.threshold", "[hazard][threshold]") {
+  hazard_domain d{16};
+  REQUIRE( d.scan_threshold() == 16 );
+  std::atomic<int> freed = 0;
+  std::vector<node> nodes(16);
+  for (node &n : nodes)
+    n.counter = &freed;
+
+  // Retired nodes are freed in batches of the scan threshold.
+  for (std::size_t i = 0; i < 15; ++i)
+    d.retire(&nodes[i], mark_freed);
+  REQUIRE( freed == 0 );
+  REQUIRE( d.retired_count() == 15 );
+  d.retire(&nodes[15], mark_freed);
+  REQUIRE( freed == 16 );
+  REQUIRE( d.retired_count() == 0 );
+}
+
+TEST_CASE("hazard.stalled_reader", "[hazard][stalled]") {
+  hazard_domain d{32};
+  std::vector<std::unique_ptr<node>> all;
+  all.push_back(std::make_unique<node>());
+  std::atomic<node *> current = all.back().get();
+  std::atomic<bool> protecting = false;
+  std::atomic<bool> release = false;
+  std::atomic<bool> survived = false;
+
+  // A reader which stalls while it holds a hazard pointer keeps only that
+  // node from being freed.
+  std::thread reader{[&] {
+    hazard_pointer hp{d};
+    node *const n = hp.protect(current);
+    protecting = true;
+    while (!release)
+      std::this_thread::yield();
+    survived = !n->freed;
+  }};
+  while (!protecting)
+    std::this_thread::yield();
+
+  std::size_t maxRetired = 0;
+  for (int i = 0; i < 1000; ++i) {
+    all.push_back(std::make_unique<node>());
+    node *const old = current.exchange(all.back().get());
+    d.retire(old, mark_freed);
+    maxRetired = std::max(maxRetired, d.retired_count());
+  }
+  REQUIRE( maxRetired <= d.scan_threshold() + 1 );
+  REQUIRE( !all.front()->freed );
+
+  release = true;
+  reader.join();
+  REQUIRE( survived );
+  d.reclaim();
+  REQUIRE( all.front()->freed );
+  REQUIRE( d.retired_count() == 0 );
+}
+
+TEST_CASE("hazard.lifetime", "[hazard][lifetime]") {
+  std::atomic<int> freed = 0;
+  std::vector<node> nodes(10);
+  for (node &n : nodes)
+    n.counter = &freed;
+
+  {
+    // The nodes retired by an exited thread are freed by another thread.
+    hazard_domain d;
+    std::thread{[&] {
+      for (int i = 0; i < 5; ++i)
+        d.retire(&nodes[i], mark_freed);
+    }}.join();
+    REQUIRE( freed == 0 );
+    d.reclaim();
+    REQUIRE( freed == 5 );
+
+    // The destructor frees the nodes which are still pending.
+    for (int i = 5; i < 10; ++i)
+      d.retire(&nodes[i], mark_freed);
+  }
+  REQUIRE( freed == 10 );
+
+  // A thread's records of destroyed domains are reclaimed.
+  for (int i = 0; i < 100; ++i) {
+    auto d = std::make_unique<hazard_domain>();
+    hazard_guard g{*d};
+    std::atomic<node *> src = nullptr;
+    REQUIRE( !g.protect(src, 1) );
+  }
+}
+
+TEMPLATE_TEST_CASE("hazard.policy", "[hazard][policy]", hazard_domain,
+                   epoch) {
+  constexpr int Threads = 4;
+  constexpr int Rounds = 2000;
+  using stack_type = stack<TestType>;
+
+  // The same lock-free structure works with either reclamation policy.
+  TestType domain;
+  stack_type s{domain};
+  std::vector<std::vector<typename stack_type::node>> nodes(Threads);
+  std::atomic<int> popped = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < Threads; ++t) {
+    nodes[t] = std::vector<typename stack_type::node>(Rounds);
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < Rounds; ++i) {
+        nodes[t][i].value = i;
+        s.push(&nodes[t][i]);
+        popped += s.pop().has_value();
+        if (i % 32 == 0)
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &th : threads)
+    th.join();
+
+  REQUIRE( s.errors == 0 );
+  REQUIRE( popped == Threads * Rounds );
+  REQUIRE( !s.pop() );
+
+  if constexpr (std::is_same_v<TestType, epoch>)
+    domain.drain_callbacks();
+  else
+    domain.reclaim();
+  for (const auto &v : nodes)
+    for (const auto &n : v)
+      REQUIRE( n.freed );
+}
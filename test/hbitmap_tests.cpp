@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <random>
+#include <ranges>
+#include <set>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/hbitmap.h>
+
+using namespace csg;
+
+static_assert(std::forward_iterator<hbitmap::iterator>);
+static_assert(std::ranges::forward_range<const hbitmap>);
+
+TEST_CASE("hbitmap.basic", "[hbitmap][basic]") {
+  hbitmap b{5000};
+
+  REQUIRE( b.size() == 5000 );
+  REQUIRE( b.summary().size() == 10 );
+  REQUIRE( b.none() );
+  REQUIRE( b.ffs() == hbitmap::not_found );
+  REQUIRE( b.begin() == b.end() );
+
+  b.set(4999);
+  REQUIRE( b.any() );
+  REQUIRE( b.test(4999) );
+  REQUIRE( b.summary().test(9) );
+  REQUIRE( b.ffs() == 4999 );
+
+  // Two bits in the same cache line; the summary bit must remain set until
+  // both are clear.
+  b.set(600);
+  b.set(1000);
+  REQUIRE( b.summary().count() == 2 );
+  REQUIRE( b.ffs_at(601) == 1000 );
+  REQUIRE( b.ffs_at(1001) == 4999 );
+
+  b.clear(600);
+  REQUIRE( b.summary().test(1) );
+  REQUIRE( b.ffs() == 1000 );
+
+  b.clear(1000);
+  REQUIRE( !b.summary().test(1) );
+  REQUIRE( b.ffs() == 4999 );
+  REQUIRE( b.count() == 1 );
+
+  b.clear_all();
+  REQUIRE( b.none() );
+  REQUIRE( b.summary().count() == 0 );
+}
+
+TEST_CASE("hbitmap.iterate", "[hbitmap][iterate]") {
+  // A sparse bitmap whose final cache line is partial.
+  constexpr std::size_t Size = (1 << 16) + 100;
+  std::mt19937 gen{4321};
+  std::uniform_int_distribution<std::size_t> pos{0, Size - 1};
+
+  hbitmap b{Size};
+  std::set<std::size_t> expected;
+
+  for (int i = 0; i < 500; ++i) {
+    const std::size_t bit = pos(gen);
+    b.set(bit);
+    expected.insert(bit);
+  }
+
+  // Clear about half of them again, to check summary maintenance.
+  for (auto i = expected.begin(); i != expected.end(); ) {
+    if (gen() & 1) {
+      b.clear(*i);
+      i = expected.erase(i);
+    }
+    else
+      ++i;
+  }
+
+  const std::vector<std::size_t> found{b.begin(), b.end()};
+  REQUIRE( std::ranges::equal(found, expected) );
+  REQUIRE( b.count() == expected.size() );
+
+  for (std::size_t line = 0; line < b.summary().size(); ++line) {
+    const std::size_t first = line * hbitmap::bits_per_line;
+    const auto i = expected.lower_bound(first);
+    const bool lineHasBits = i != expected.end() &&
+        *i < first + hbitmap::bits_per_line;
+    REQUIRE( b.summary().test(line) == lineHasBits );
+  }
+
+  for (int trial = 0; trial < 200; ++trial) {
+    const std::size_t start = pos(gen);
+    const auto i = expected.lower_bound(start);
+    const std::ptrdiff_t expectBit = i == expected.end()
+        ? hbitmap::not_found : static_cast<std::ptrdiff_t>(*i);
+    REQUIRE( b.ffs_at(start) == expectBit );
+  }
+}
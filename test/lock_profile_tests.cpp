@@ -0,0 +1,162 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/lock_profile.h>
+#include <csg/core/rmlock.h>
+
+using namespace csg;
+using namespace std::chrono_literals;
+
+// This file is built twice, with and without CSG_LOCK_PROFILING.
+
+namespace {
+
+// The statistics of lock `name` at `line` of this file, if recorded.
+std::optional<lock_profile_record> site(const char *name, std::uint32_t line) {
+  for (const lock_profile_record &r : lock_profile_snapshot()) {
+    if (std::strcmp(r.name, name) == 0 && r.line == line &&
+        std::strstr(r.file, "lock_profile_tests.cpp"))
+      return r;
+  }
+  return std::nullopt;
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("lock_profile.disabled", "[lock_profile][disabled]") {
+  if constexpr (lock_profiling)
+    return;
+
+  // Profiling compiles to nothing.
+  REQUIRE( std::is_empty_v<detail::lock_profile_attempt> );
+  rmlock l{"profile.disabled"};
+  l.lock();
+  l.unlock();
+  REQUIRE( lock_profile_snapshot().empty() );
+}
+
+TEST_CASE("lock_profile.sites", "[lock_profile][sites]") {
+  if constexpr (!lock_profiling)
+    return;
+
+  rmlock l{"profile.sites"};
+  std::uint32_t readLine = 0;
+  std::uint32_t writeLine = 0;
+  for (int i = 0; i < 3; ++i) {
+    readLine = __LINE__; l.lock_shared();
+    l.lock_shared();  // Recursive acquisitions are not counted.
+    l.unlock_shared();
+    l.unlock_shared();
+  }
+  writeLine = __LINE__; l.lock();
+  std::this_thread::sleep_for(2ms);
+  l.unlock();
+
+  const auto r = site("profile.sites", readLine);
+  REQUIRE( r );
+  REQUIRE( r->acquisitions == 3 );
+  REQUIRE( r->contentions == 0 );
+  REQUIRE( r->wait_total == 0 );
+
+  const auto w = site("profile.sites", writeLine);
+  REQUIRE( w );
+  REQUIRE( w->acquisitions == 1 );
+  REQUIRE( w->hold_max >= 2'000'000 );
+  REQUIRE( w->hold_total == w->hold_max );
+
+  // Guards acquire the lock from within the standard library, so all their
+  // acquisitions of a lock are one site per guard type.
+  { std::unique_lock g{l}; }
+  { std::shared_lock g{l}; }
+  std::size_t sites = 0;
+  for (const lock_profile_record &s : lock_profile_snapshot())
+    sites += std::strcmp(s.name, "profile.sites") == 0;
+  REQUIRE( sites == 4 );
+}
+
+TEST_CASE("lock_profile.contention", "[lock_profile][contention]") {
+  if constexpr (!lock_profiling)
+    return;
+
+  rmlock l{"profile.contention"};
+  std::atomic<bool> started = false;
+  std::uint32_t readLine = 0;
+
+  // The reader finds the writer active, and waits until it is done.
+  l.lock();
+  std::thread reader{[&] {
+    started = true;
+    readLine = __LINE__; l.lock_shared();
+    l.unlock_shared();
+  }};
+  while (!started)
+    std::this_thread::yield();
+  std::this_thread::sleep_for(20ms);
+  l.unlock();
+  reader.join();
+
+  const auto r = site("profile.contention", readLine);
+  REQUIRE( r );
+  REQUIRE( r->acquisitions == 1 );
+  REQUIRE( r->contentions == 1 );
+  REQUIRE( r->wait_max > 0 );
+  REQUIRE( r->wait_total == r->wait_max );
+}
+
+TEST_CASE("lock_profile.threads", "[lock_profile][threads]") {
+  if constexpr (!lock_profiling)
+    return;
+
+  constexpr int Threads = 4;
+  constexpr int PerThread = 100;
+  rmlock l{"profile.threads"};
+  std::atomic<std::uint32_t> line = 0;
+
+  // Each thread counts in its own buffer; the snapshot sums them, including
+  // those of exited threads.
+  std::vector<std::thread> threads;
+  for (int t = 0; t < Threads; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < PerThread; ++i) {
+        line = __LINE__; l.lock_shared();
+        l.unlock_shared();
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  const auto r = site("profile.threads", line);
+  REQUIRE( r );
+  REQUIRE( r->acquisitions == Threads * PerThread );
+}
+
+TEST_CASE("lock_profile.report", "[lock_profile][report]") {
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{std::tmpfile(),
+                                                           &std::fclose};
+  REQUIRE( f );
+
+  rmlock l{"profile.report"};
+  l.lock();
+  l.unlock();
+  lock_profile_report(f.get());
+
+  std::rewind(f.get());
+  bool found = false;
+  char line[1024];
+  while (std::fgets(line, sizeof line, f.get()))
+    found |= std::strstr(line, "lock_profile_tests.cpp:") &&
+             std::strstr(line, "(profile.report)\n");
+  REQUIRE( found == lock_profiling );
+}
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/malloc_type.h>
+
+using namespace csg;
+
+TEST_CASE("malloc_type.basic", "[malloc_type][basic]") {
+  malloc_type type{"test_basic"};
+  malloc_type_resource r{type};
+
+  void *const p = r.allocate(100);
+  void *const q = r.allocate(1000);
+
+  auto u = type.usage();
+  REQUIRE( std::strcmp(u.name, "test_basic") == 0 );
+  REQUIRE( u.in_use == 2 );
+  REQUIRE( u.mem_use == 1100 );
+  REQUIRE( u.requests == 2 );
+  REQUIRE( u.size_mask == (std::uint64_t{1} << 7 | std::uint64_t{1} << 10) );
+
+  r.deallocate(p, 100);
+  u = type.usage();
+  REQUIRE( u.in_use == 1 );
+  REQUIRE( u.mem_use == 1000 );
+  REQUIRE( u.requests == 2 );
+
+  r.deallocate(q, 1000);
+  REQUIRE( type.usage().mem_use == 0 );
+}
+
+TEST_CASE("malloc_type.threads", "[malloc_type][threads]") {
+  malloc_type type{"test_threads"};
+  malloc_type_resource r{type};
+  std::vector<void *> kept(4);
+
+  // Each thread leaves one allocation live when it exits, so the counts of
+  // exited threads must be folded into the type.
+  std::vector<std::thread> threads;
+  for (std::size_t t = 0; t < kept.size(); ++t) {
+    threads.emplace_back([&r, &kept, t] {
+      for (int i = 0; i < 1000; ++i)
+        r.deallocate(r.allocate(64), 64);
+      kept[t] = r.allocate(32);
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  auto u = type.usage();
+  REQUIRE( u.in_use == 4 );
+  REQUIRE( u.mem_use == 4 * 32 );
+  REQUIRE( u.requests == 4 * 1001 );
+
+  for (void *p : kept)
+    r.deallocate(p, 32);
+  u = type.usage();
+  REQUIRE( u.in_use == 0 );
+  REQUIRE( u.mem_use == 0 );
+}
+
+TEST_CASE("malloc_type.hard_limit", "[malloc_type][limits]") {
+  constexpr std::size_t Limit = 4 * malloc_type::publish_threshold;
+  malloc_type type{"test_hard", {.hard_limit = Limit}};
+  malloc_type_resource r{type};
+
+  // Allocations of publish_threshold bytes are published immediately, so
+  // the limit is exact for them.
+  std::vector<void *> blocks;
+  for (int i = 0; i < 4; ++i)
+    blocks.push_back(r.allocate(malloc_type::publish_threshold));
+
+  REQUIRE_THROWS_AS( r.allocate(malloc_type::publish_threshold),
+                     std::bad_alloc );
+  REQUIRE( type.usage().limit_failures == 1 );
+  REQUIRE( type.usage().in_use == 4 );
+
+  r.deallocate(blocks.back(), malloc_type::publish_threshold);
+  blocks.pop_back();
+  blocks.push_back(r.allocate(malloc_type::publish_threshold));
+
+  for (void *p : blocks)
+    r.deallocate(p, malloc_type::publish_threshold);
+}
+
+namespace {
+
+const malloc_type *softType;
+std::size_t softUsage;
+int softCalls;
+
+void on_soft(const malloc_type &t, std::size_t usage) {
+  softType = &t;
+  softUsage = usage;
+  ++softCalls;
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("malloc_type.soft_limit", "[malloc_type][limits]") {
+  malloc_type type{"test_soft",
+                   {.soft_limit = 2 * malloc_type::publish_threshold,
+                    .on_soft_limit = on_soft}};
+  malloc_type_resource r{type};
+  softCalls = 0;
+
+  void *const a = r.allocate(malloc_type::publish_threshold);
+  void *const b = r.allocate(malloc_type::publish_threshold);
+  REQUIRE( softCalls == 0 );
+
+  // Soft limits never refuse an allocation, and the handler is only called
+  // when the limit is crossed, not for every allocation above it.
+  void *const c = r.allocate(malloc_type::publish_threshold);
+  void *const d = r.allocate(malloc_type::publish_threshold);
+  REQUIRE( softCalls == 1 );
+  REQUIRE( softType == &type );
+  REQUIRE( softUsage == 3 * malloc_type::publish_threshold );
+
+  for (void *p : {a, b, c, d})
+    r.deallocate(p, malloc_type::publish_threshold);
+}
+
+TEST_CASE("malloc_type.dump", "[malloc_type][dump]") {
+  malloc_type z{"test_dump_z"};
+  malloc_type a{"test_dump_a"};
+  malloc_type_resource r{a};
+  void *const p = r.allocate(4096);
+
+  const auto stats = malloc_type_statistics();
+  const auto ia = std::ranges::find(stats, std::string_view{"test_dump_a"},
+                                    &malloc_type_usage::name);
+  const auto iz = std::ranges::find(stats, std::string_view{"test_dump_z"},
+                                    &malloc_type_usage::name);
+  REQUIRE( ia != stats.end() );
+  REQUIRE( iz != stats.end() );
+  REQUIRE( ia < iz );
+  REQUIRE( ia->mem_use == 4096 );
+
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{std::tmpfile(),
+                                                           &std::fclose};
+  REQUIRE( f );
+  dump_malloc_types(f.get());
+  std::rewind(f.get());
+
+  std::string text(4096, '\0');
+  text.resize(std::fread(text.data(), 1, text.size(), f.get()));
+  REQUIRE( text.find("test_dump_a") != std::string::npos );
+  REQUIRE( text.find("4096") != std::string::npos );
+
+  r.deallocate(p, 4096);
+}
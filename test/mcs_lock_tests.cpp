@@ -0,0 +1,107 @@
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/mcs_lock.h>
+
+using namespace csg;
+
+namespace {
+
+// The cohort lock uses clusters of one CPU, so that the lock also passes
+// between clusters.
+template <typename Lock>
+Lock make_lock() {
+  if constexpr (std::is_same_v<Lock, cohort_lock>)
+    return cohort_lock{"exclusion", 1};
+  else
+    return Lock{"exclusion"};
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("mcs_lock.basic", "[mcs_lock][basic]") {
+  mcs_lock m{"test"};
+  REQUIRE( m.name() == std::string_view{"test"} );
+  REQUIRE( !m.is_locked() );
+
+  {
+    std::unique_lock guard{m};
+    REQUIRE( m.is_locked() );
+    REQUIRE( !m.has_waiters() );
+    REQUIRE( !m.try_lock() );
+  }
+  REQUIRE( !m.is_locked() );
+  REQUIRE( m.try_lock() );
+  m.unlock();
+
+  // A waiter is queued behind the owner, and then handed the lock.
+  std::atomic<bool> acquired = false;
+  m.lock();
+  std::thread waiter{[&] {
+    const std::lock_guard guard{m};
+    acquired = true;
+  }};
+  while (!m.has_waiters())
+    std::this_thread::yield();
+  REQUIRE( !acquired );
+  m.unlock();
+  waiter.join();
+  REQUIRE( acquired );
+  REQUIRE( !m.is_locked() );
+}
+
+TEST_CASE("cohort_lock.basic", "[cohort_lock][basic]") {
+  cohort_lock c{"cohort", 2, 4};
+  REQUIRE( c.cluster_count() >= 1 );
+
+  // Another thread, from whichever cluster, cannot take a held lock.
+  bool locked = true;
+  REQUIRE( c.try_lock() );
+  std::thread{[&] { locked = c.try_lock(); }}.join();
+  REQUIRE( !locked );
+  c.unlock();
+  {
+    const std::scoped_lock guard{c};
+    std::thread{[&] { locked = c.try_lock(); }}.join();
+    REQUIRE( !locked );
+  }
+  REQUIRE( c.try_lock() );
+  c.unlock();
+}
+
+TEMPLATE_TEST_CASE("mcs_lock.exclusion", "[mcs_lock][exclusion]", mcs_lock,
+                   cohort_lock) {
+  constexpr int Threads = 6;
+  constexpr int Rounds = 5000;
+
+  // A plain counter, incremented under the lock, loses no increment.
+  TestType m = make_lock<TestType>();
+  std::uint64_t count = 0;
+  std::atomic<int> inside = 0;
+  std::atomic<int> errors = 0;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < Threads; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < Rounds; ++i) {
+        const std::lock_guard guard{m};
+        errors += inside.fetch_add(1, std::memory_order_relaxed) != 0;
+        ++count;
+        inside.fetch_sub(1, std::memory_order_relaxed);
+        if (i % 64 == 0)
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  REQUIRE( errors == 0 );
+  REQUIRE( count == Threads * Rounds );
+}
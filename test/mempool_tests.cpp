@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <csg/core/mempool.h>
+
+using namespace csg;
+
+namespace {
+
+struct alignas(64) object {
+  std::uint64_t id = 7;
+  std::uint64_t owner;
+};
+
+std::string unique_name() {
+  return "/csg-mempool-test-" + std::to_string(::getpid());
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("mempool.basic", "[mempool][basic]") {
+  mempool<object> pool{100, {.cache_size = 16}};
+
+  REQUIRE( pool.capacity() == 100 );
+  REQUIRE( pool.cache_size() == 16 );
+  REQUIRE( pool.available() == 100 );
+  REQUIRE( pool.in_use() == 0 );
+
+  // Objects are constructed once, when the pool is.
+  object *const p = pool.get();
+  REQUIRE( p );
+  REQUIRE( pool.contains(p) );
+  REQUIRE( p->id == 7 );
+  REQUIRE( reinterpret_cast<std::uintptr_t>(p) % alignof(object) == 0 );
+  REQUIRE( pool.in_use() == 1 );
+
+  // A get refilled the cache, so a put goes to the cache and the next get
+  // returns the same object.
+  p->id = 42;
+  pool.put(p);
+  REQUIRE( pool.available() == 100 );
+  object *const q = pool.get();
+  REQUIRE( q == p );
+  REQUIRE( q->id == 42 );
+  pool.put(q);
+
+  object outside;
+  REQUIRE( !pool.contains(&outside) );
+}
+
+TEST_CASE("mempool.exhaust", "[mempool][exhaust]") {
+  const std::size_t CacheSize = GENERATE(0, 8, 64);
+  mempool<object> pool{1000, {.cache_size = CacheSize}};
+
+  // Every object can be taken, in bulk and singly, exactly once.
+  std::set<object *> taken;
+  std::array<object *, 30> burst;
+  while (pool.get_bulk(burst))
+    taken.insert(burst.begin(), burst.end());
+  while (object *const p = pool.get())
+    taken.insert(p);
+
+  REQUIRE( taken.size() == 1000 );
+  REQUIRE( pool.available() == 0 );
+  REQUIRE( !pool.get() );
+  REQUIRE( !pool.get_bulk(std::span{burst.data(), 1}) );
+
+  std::vector<object *> all{taken.begin(), taken.end()};
+  pool.put_bulk(std::span{all.data(), 500});
+  for (std::size_t i = 500; i < all.size(); ++i)
+    pool.put(all[i]);
+  REQUIRE( pool.available() == 1000 );
+
+  // A bulk request that cannot be met in full takes nothing.
+  std::vector<object *> more(1001);
+  REQUIRE( !pool.get_bulk(more) );
+  REQUIRE( pool.available() == 1000 );
+  more.pop_back();
+  REQUIRE( pool.available() == 1000 );
+
+  // A request larger than the cache goes to the ring, so it needs the
+  // objects in this thread's cache back first.
+  pool.flush_cache();
+  REQUIRE( pool.get_bulk(more) );
+  REQUIRE( std::set<object *>(more.begin(), more.end()).size() == 1000 );
+  pool.put_bulk(more);
+}
+
+TEST_CASE("mempool.flush", "[mempool][flush]") {
+  mempool<object> pool{256, {.cache_size = 32}};
+
+  object *const p = pool.get();
+  pool.put(p);
+  REQUIRE( pool.available() == 256 );
+
+  // The cache holds what the refill took beyond the request.
+  std::array<object *, 256> all;
+  REQUIRE( !pool.get_bulk(all) );
+  pool.flush_cache();
+  REQUIRE( pool.get_bulk(all) );
+  pool.put_bulk(all);
+
+  // A thread's cache is flushed to the ring when it exits.
+  std::thread{[&pool] { pool.put(pool.get()); }}.join();
+  pool.flush_cache();
+  REQUIRE( pool.get_bulk(all) );
+  pool.put_bulk(all);
+}
+
+TEST_CASE("mempool.threads", "[mempool][threads]") {
+  constexpr int Threads = 4;
+  constexpr int Rounds = 2000;
+  mempool<object> pool{1024, {.cache_size = 32}};
+
+  // Each thread takes bursts, checks that nobody else owns them, and gives
+  // them back; objects migrate between the threads' caches through the ring.
+  std::atomic<int> errors = 0;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < Threads; ++t) {
+    threads.emplace_back([&pool, &errors, t] {
+      std::array<object *, 40> burst;
+      for (int r = 0; r < Rounds; ++r) {
+        const std::size_t n = 1 + (r * 7 + t) % burst.size();
+        const std::span<object *> objs{burst.data(), n};
+        if (!pool.get_bulk(objs)) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (object *p : objs)
+          p->owner = static_cast<std::uint64_t>(t);
+        if (r % 16 == 0)
+          std::this_thread::yield();
+        for (object *p : objs)
+          errors += p->owner != static_cast<std::uint64_t>(t);
+        pool.put_bulk(objs);
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  REQUIRE( errors == 0 );
+  pool.flush_cache();
+  REQUIRE( pool.available() == 1024 );
+  std::vector<object *> all(1024);
+  REQUIRE( pool.get_bulk(all) );
+  REQUIRE( std::set<object *>(all.begin(), all.end()).size() == 1024 );
+  pool.put_bulk(all);
+}
+
+TEST_CASE("mempool.hugepages", "[mempool][hugepages]") {
+  // Whether or not huge pages are reserved, the pool works.
+  mempool<object> pool{4096, {.hugepages = true}};
+  std::vector<object *> all(4096);
+  REQUIRE( pool.get_bulk(all) );
+  pool.put_bulk(all);
+  REQUIRE( pool.available() == 4096 );
+}
+
+TEST_CASE("mempool.shared_mappings", "[mempool][shared]") {
+  auto a = mempool<object>::create_anonymous(64, {.cache_size = 8});
+  auto b = mempool<object>::attach(::dup(a.fd()), {.cache_size = 4});
+
+  REQUIRE( b.capacity() == 64 );
+  REQUIRE( b.cache_size() == 4 );
+
+  // The two mappings of the pool are at different addresses, and a handle
+  // refers to the same object in both.
+  object *const p = a.get();
+  REQUIRE( !b.contains(p) );
+  p->id = 99;
+  object *const q = b.from_handle(a.handle(p));
+  REQUIRE( b.contains(q) );
+  REQUIRE( q->id == 99 );
+  REQUIRE( b.handle(q) == a.handle(p) );
+  b.put(q);
+
+  // Objects taken through one mapping are gone from the other.
+  a.flush_cache();
+  b.flush_cache();
+  std::vector<object *> all(64);
+  REQUIRE( a.get_bulk(all) );
+  REQUIRE( !b.get() );
+  a.put_bulk(all);
+  a.flush_cache();
+  REQUIRE( b.get_bulk(all) );
+  b.put_bulk(all);
+}
+
+TEST_CASE("mempool.shared_named", "[mempool][shared]") {
+  const std::string name = unique_name();
+  auto pool = mempool<object>::create_shared(name.c_str(), 32);
+
+  // The name is exclusive while it exists.
+  REQUIRE_THROWS_AS( mempool<object>::create_shared(name.c_str(), 32),
+                     std::system_error );
+
+  auto other = mempool<object>::open_shared(name.c_str());
+  REQUIRE( other.capacity() == 32 );
+
+  // Attaching with a different object type is refused.
+  REQUIRE_THROWS_AS( mempool<std::uint64_t>::open_shared(name.c_str()),
+                     std::system_error );
+
+  mempool<object>::unlink_shared(name.c_str());
+  REQUIRE_THROWS_AS( mempool<object>::open_shared(name.c_str()),
+                     std::system_error );
+  REQUIRE( other.get() );
+}
+
+TEST_CASE("mempool.shared_processes", "[mempool][shared]") {
+  constexpr std::size_t Count = 1024;
+  constexpr std::size_t CacheSize = 32;
+  auto pool = mempool<object>::create_anonymous(Count,
+                                                {.cache_size = CacheSize});
+
+  // The get fills this thread's cache, which the child must not inherit.
+  object *const p = pool.get();
+  p->id = 1234;
+  const auto h = pool.handle(p);
+
+  const pid_t child = ::fork();
+  REQUIRE( child != -1 );
+  if (!child) {
+    std::vector<object *> taken;
+    while (object *const q = pool.get())
+      taken.push_back(q);
+    bool ok = taken.size() == Count - 1 - CacheSize;
+    pool.put_bulk(taken);
+    pool.flush_cache();
+
+    // Return the parent's object through a mapping of our own, whose cache
+    // is flushed when it is destroyed.
+    {
+      auto m = mempool<object>::attach(::dup(pool.fd()));
+      object *const q = m.from_handle(h);
+      ok &= q->id == 1234;
+      q->id = 5678;
+      m.put(q);
+    }
+    ::_exit(ok ? 0 : 1);
+  }
+
+  int status;
+  REQUIRE( ::waitpid(child, &status, 0) == child );
+  REQUIRE( WIFEXITED(status) );
+  REQUIRE( WEXITSTATUS(status) == 0 );
+
+  pool.flush_cache();
+  REQUIRE( pool.available() == Count );
+  std::vector<object *> all(Count);
+  REQUIRE( pool.get_bulk(all) );
+  REQUIRE( std::find(all.begin(), all.end(), p) != all.end() );
+  REQUIRE( p->id == 5678 );
+  pool.put_bulk(all);
+}
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/reorder_buffer.h>
+
+using namespace csg;
+
+namespace {
+
+struct packet {
+  std::uint32_t seq;
+  stailq_entry<packet> link;
+};
+
+using packet_rob =
+    reorder_buffer<CSG_STAILQ_HEAD_OFFSET_T(packet, link), &packet::seq>;
+
+std::vector<std::uint32_t> drain_seqs(packet_rob &rob, std::size_t burst) {
+  std::vector<std::uint32_t> seqs;
+  std::vector<packet *> out(burst);
+  while (const std::size_t n = rob.drain(out)) {
+    for (std::size_t i = 0; i < n; ++i)
+      seqs.push_back(out[i]->seq);
+  }
+  return seqs;
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("reorder_buffer.basic", "[reorder_buffer][basic]") {
+  packet_rob rob{8, 100};
+  std::array<packet, 6> p;
+  for (std::uint32_t i = 0; i < p.size(); ++i)
+    p[i].seq = 100 + i;
+
+  REQUIRE( rob.insert(&p[2]) == reorder_status::ordered );
+  REQUIRE( rob.insert(&p[1]) == reorder_status::ordered );
+  REQUIRE( rob.insert(&p[1]) == reorder_status::duplicate );
+  REQUIRE( drain_seqs(rob, 4).empty() );
+
+  REQUIRE( rob.insert(&p[0]) == reorder_status::ordered );
+  REQUIRE( rob.insert(&p[4]) == reorder_status::ordered );
+  REQUIRE( drain_seqs(rob, 2) == std::vector<std::uint32_t>{100, 101, 102} );
+  REQUIRE( rob.next_seq() == 103 );
+  REQUIRE( rob.size() == 1 );
+
+  REQUIRE( rob.insert(&p[0]) == reorder_status::late );
+
+  // 103 is lost.
+  REQUIRE( rob.skip_gap() == 1 );
+  REQUIRE( rob.insert(&p[5]) == reorder_status::ordered );
+  REQUIRE( drain_seqs(rob, 8) == std::vector<std::uint32_t>{104, 105} );
+  REQUIRE( rob.empty() );
+}
+
+TEST_CASE("reorder_buffer.overflow", "[reorder_buffer][overflow]") {
+  packet_rob rob{4};
+  std::array<packet, 12> p;
+  for (std::uint32_t i = 0; i < p.size(); ++i)
+    p[i].seq = i;
+
+  // Everything past the window of 4 waits on the overflow list, and moves
+  // into the window as it is drained.
+  for (std::uint32_t i = 11; i >= 1; --i) {
+    const auto status = rob.insert(&p[i]);
+    REQUIRE( status == (i < 4 ? reorder_status::ordered
+                              : reorder_status::overflow) );
+  }
+  REQUIRE( rob.has_overflow() );
+  REQUIRE( drain_seqs(rob, 4).empty() );
+
+  REQUIRE( rob.insert(&p[0]) == reorder_status::ordered );
+  std::vector<std::uint32_t> expected(12);
+  for (std::uint32_t i = 0; i < 12; ++i)
+    expected[i] = i;
+  REQUIRE( drain_seqs(rob, 3) == expected );
+  REQUIRE( rob.empty() );
+
+  // A gap with only overflowed objects behind it is skipped up to them; an
+  // overflowed duplicate is handed back once it reaches the window.
+  std::array<packet, 3> q{{{40, {}}, {41, {}}, {40, {}}}};
+  REQUIRE( rob.insert(&q[0]) == reorder_status::overflow );
+  REQUIRE( rob.insert(&q[1]) == reorder_status::overflow );
+  REQUIRE( rob.insert(&q[2]) == reorder_status::overflow );
+  REQUIRE( rob.skip_gap() == 28 );
+  REQUIRE( rob.take_rejected() == &q[2] );
+  REQUIRE( rob.take_rejected() == nullptr );
+  REQUIRE( drain_seqs(rob, 8) == std::vector<std::uint32_t>{40, 41} );
+}
+
+TEST_CASE("reorder_buffer.shuffled", "[reorder_buffer][shuffled]") {
+  constexpr std::uint32_t Count = 100000;
+  constexpr std::uint32_t Start = 0xFFFFF000;  // Wraps around.
+  packet_rob rob{256, Start};
+  std::vector<packet> packets(Count);
+  std::mt19937 rng{7};
+
+  // Shuffle within blocks larger than the window, so that some objects
+  // always overflow.
+  std::vector<std::uint32_t> order(Count);
+  for (std::uint32_t i = 0; i < Count; ++i) {
+    packets[i].seq = Start + i;
+    order[i] = i;
+  }
+  for (std::uint32_t i = 0; i < Count; i += 1000)
+    std::shuffle(order.begin() + i, order.begin() + i + 1000, rng);
+
+  std::vector<std::uint32_t> seqs;
+  std::array<packet *, 32> out;
+  for (const std::uint32_t i : order) {
+    REQUIRE( rob.insert(&packets[i]) != reorder_status::late );
+    while (const std::size_t n = rob.drain(out)) {
+      for (std::size_t j = 0; j < n; ++j)
+        seqs.push_back(out[j]->seq);
+    }
+  }
+
+  REQUIRE( seqs.size() == Count );
+  bool ok = true;
+  for (std::uint32_t i = 0; i < Count; ++i)
+    ok &= seqs[i] == Start + i;
+  REQUIRE( ok );
+  REQUIRE( rob.empty() );
+}
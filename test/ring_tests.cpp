@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/ring.h>
+
+using namespace csg;
+
+namespace {
+
+using mpmc_ring = ring<std::uintptr_t *, ring_multi, ring_multi>;
+using mpsc_ring = ring<std::uintptr_t *, ring_multi, ring_single>;
+using spmc_ring = ring<std::uintptr_t *, ring_single, ring_multi>;
+using spsc_ring = ring<std::uintptr_t *, ring_single, ring_single>;
+using rts_ring = ring<std::uintptr_t *, ring_rts, ring_rts>;
+using hts_ring = ring<std::uintptr_t *, ring_hts, ring_hts>;
+using blocking_ring = ring<std::uintptr_t *, ring_blocking<ring_multi>,
+                           ring_blocking<ring_single>>;
+using blocking_rts_ring = ring<std::uintptr_t *, ring_blocking<ring_rts>,
+                               ring_blocking<ring_hts>>;
+
+// Run `Producers` threads enqueueing bursts and `Consumers` threads dequeueing
+// bursts, and check that every element arrives exactly once, and that each
+// producer's elements arrive in order at any one consumer.
+template <typename Ring>
+bool transfer(std::size_t producers, std::size_t consumers) {
+  constexpr std::size_t PerProducer = 20000;
+  Ring r{64};
+
+  // Elements are pointers to "(producer << 32) | seq" values.
+  std::vector<std::uintptr_t> values(producers * PerProducer);
+  for (std::size_t p = 0; p < producers; ++p) {
+    for (std::size_t i = 0; i < PerProducer; ++i)
+      values[p * PerProducer + i] = p << 32 | i;
+  }
+
+  std::vector<std::thread> threads;
+  for (std::size_t p = 0; p < producers; ++p) {
+    threads.emplace_back([&, p] {
+      std::array<std::uintptr_t *, 7> burst;
+      for (std::size_t i = 0; i < PerProducer;) {
+        const std::size_t n = std::min(burst.size(), PerProducer - i);
+        for (std::size_t j = 0; j < n; ++j)
+          burst[j] = &values[p * PerProducer + i + j];
+        std::size_t sent = 0;
+        while (sent < n) {
+          sent += r.enqueue_burst(std::span{burst}.subspan(sent, n - sent));
+          std::this_thread::yield();
+        }
+        i += n;
+      }
+    });
+  }
+
+  std::vector<std::vector<std::uint8_t>> seen(consumers,
+      std::vector<std::uint8_t>(values.size()));
+  std::vector<bool> ordered(consumers, true);
+  std::atomic<std::size_t> received = 0;
+
+  for (std::size_t c = 0; c < consumers; ++c) {
+    threads.emplace_back([&, c] {
+      std::vector<std::uintptr_t> next(producers);
+      std::array<std::uintptr_t *, 5> burst;
+      while (received.load() < values.size()) {
+        const std::size_t n = r.dequeue_burst(burst);
+        for (std::size_t j = 0; j < n; ++j) {
+          const std::uintptr_t v = *burst[j];
+          ++seen[c][static_cast<std::size_t>(burst[j] - values.data())];
+          if ((v & 0xffffffff) < next[v >> 32])
+            ordered[c] = false;
+          next[v >> 32] = (v & 0xffffffff) + 1;
+        }
+        received += n;
+        if (!n)
+          std::this_thread::yield();
+      }
+    });
+  }
+
+  for (auto &t : threads)
+    t.join();
+
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    std::size_t count = 0;
+    for (const auto &s : seen)
+      count += s[i];
+    if (count != 1)
+      return false;
+  }
+
+  for (const bool o : ordered) {
+    if (!o)
+      return false;
+  }
+
+  return r.empty();
+}
+
+} // End of anonymous namespace
+
+TEMPLATE_TEST_CASE("ring.bulk", "[ring][bulk][template]", mpmc_ring,
+                   mpsc_ring, spmc_ring, spsc_ring, rts_ring, hts_ring) {
+  TestType r{8};
+  std::uintptr_t v[10];
+  std::uintptr_t *in[10];
+  std::uintptr_t *out[10] = {};
+
+  for (std::size_t i = 0; i < 10; ++i)
+    in[i] = &v[i];
+
+  REQUIRE( r.capacity() == 8 );
+  REQUIRE( r.empty() );
+  REQUIRE( r.dequeue_bulk(std::span{out, 1}) == 0 );
+
+  REQUIRE( r.enqueue_bulk(std::span{in, 6}) == 6 );
+  REQUIRE( r.size() == 6 );
+  REQUIRE( r.free_count() == 2 );
+
+  // All or nothing.
+  REQUIRE( r.enqueue_bulk(std::span{in + 6, 3}) == 0 );
+  REQUIRE( r.size() == 6 );
+  REQUIRE( r.dequeue_bulk(std::span{out, 7}) == 0 );
+
+  REQUIRE( r.dequeue_bulk(std::span{out, 4}) == 4 );
+  for (std::size_t i = 0; i < 4; ++i)
+    REQUIRE( out[i] == in[i] );
+
+  // This wraps around the end of the slot array.
+  REQUIRE( r.enqueue_bulk(std::span{in + 6, 4}) == 4 );
+  REQUIRE( r.dequeue_bulk(std::span{out, 6}) == 6 );
+  for (std::size_t i = 0; i < 6; ++i)
+    REQUIRE( out[i] == in[i + 4] );
+  REQUIRE( r.empty() );
+}
+
+TEMPLATE_TEST_CASE("ring.burst", "[ring][burst][template]", mpmc_ring,
+                   mpsc_ring, spmc_ring, spsc_ring, rts_ring, hts_ring) {
+  TestType r{8};
+  std::uintptr_t v[10];
+  std::uintptr_t *in[10];
+  std::uintptr_t *out[10] = {};
+
+  for (std::size_t i = 0; i < 10; ++i)
+    in[i] = &v[i];
+
+  REQUIRE( r.enqueue_burst(std::span{in, 5}) == 5 );
+  REQUIRE( r.enqueue_burst(std::span{in + 5, 5}) == 3 );
+  REQUIRE( r.full() );
+  REQUIRE( r.enqueue_burst(std::span{in, 1}) == 0 );
+
+  REQUIRE( r.dequeue_burst(std::span{out, 10}) == 8 );
+  for (std::size_t i = 0; i < 8; ++i)
+    REQUIRE( out[i] == in[i] );
+  REQUIRE( r.dequeue_burst(std::span{out, 10}) == 0 );
+
+  std::uintptr_t *one;
+  REQUIRE( r.enqueue(in[9]) );
+  REQUIRE( r.dequeue(one) );
+  REQUIRE( one == in[9] );
+  REQUIRE( !r.dequeue(one) );
+}
+
+TEST_CASE("ring.threads", "[ring][threads]") {
+  REQUIRE( transfer<spsc_ring>(1, 1) );
+  REQUIRE( transfer<mpsc_ring>(3, 1) );
+  REQUIRE( transfer<spmc_ring>(1, 3) );
+  REQUIRE( transfer<mpmc_ring>(3, 3) );
+  REQUIRE( transfer<rts_ring>(3, 3) );
+  REQUIRE( transfer<hts_ring>(3, 3) );
+
+  // A small head-tail distance makes RTS producers wait for each other.
+  using mixed_ring = ring<std::uintptr_t *, basic_ring_rts<4>, ring_hts>;
+  REQUIRE( transfer<mixed_ring>(4, 2) );
+}
+
+TEST_CASE("ring.zero_copy", "[ring][zero_copy]") {
+  spsc_ring r{8};
+  std::uintptr_t v[8];
+
+  auto region = r.reserve(5);
+  REQUIRE( region.size() == 5 );
+  REQUIRE( region.second.empty() );
+  for (std::size_t i = 0; i < 5; ++i)
+    region[i] = &v[i];
+
+  // Nothing is visible until it is committed, and unused reserved slots
+  // are returned to the ring.
+  REQUIRE( r.empty() );
+  r.commit(3);
+  REQUIRE( r.size() == 3 );
+
+  auto peeked = r.peek(8);
+  REQUIRE( peeked.size() == 3 );
+  REQUIRE( peeked[0] == &v[0] );
+  REQUIRE( peeked[2] == &v[2] );
+  r.release(2);
+  REQUIRE( r.size() == 1 );
+
+  // The free space now wraps around the end of the slot array, so it is
+  // returned as two runs.
+  region = r.reserve(7);
+  REQUIRE( region.size() == 7 );
+  REQUIRE( region.first.size() == 5 );
+  REQUIRE( region.second.size() == 2 );
+  REQUIRE( r.reserve(0).empty() );
+  for (std::size_t i = 0; i < 7; ++i)
+    region[i] = &v[i];
+  r.commit(7);
+  REQUIRE( r.full() );
+  REQUIRE( r.reserve(1).empty() );
+  r.commit(0);
+
+  peeked = r.peek(8);
+  REQUIRE( peeked.size() == 8 );
+  REQUIRE( peeked.first.size() == 6 );
+  REQUIRE( peeked[0] == &v[2] );
+  for (std::size_t i = 1; i < 8; ++i)
+    REQUIRE( peeked[i] == &v[i - 1] );
+  r.release(8);
+  REQUIRE( r.empty() );
+}
+
+TEST_CASE("ring.blocking", "[ring][blocking]") {
+  blocking_ring r{4};
+  std::uintptr_t v[4];
+  std::uintptr_t *out = nullptr;
+
+  // Operations which can proceed immediately do not wait.
+  r.enqueue_wait(&v[0]);
+  r.dequeue_wait(out);
+  REQUIRE( out == &v[0] );
+
+  // A consumer sleeping on an empty ring is woken by a later enqueue.
+  std::thread consumer{[&] { r.dequeue_wait(out); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  REQUIRE( r.enqueue(&v[1]) );
+  consumer.join();
+  REQUIRE( out == &v[1] );
+
+  // And a producer sleeping on a full ring by a later dequeue.
+  const std::array<std::uintptr_t *, 4> all{&v[0], &v[1], &v[2], &v[3]};
+  REQUIRE( r.enqueue_bulk(all) == 4 );
+  std::thread producer{[&] { r.enqueue_wait(&v[3]); }};
+  std::this_thread::sleep_for(std::chrono::milliseconds{20});
+  REQUIRE( r.dequeue(out) );
+  producer.join();
+  REQUIRE( r.full() );
+
+  std::array<std::uintptr_t *, 8> burst;
+  REQUIRE( r.dequeue_burst_wait(burst) == 4 );
+  REQUIRE( burst[3] == &v[3] );
+
+  // An empty bulk enqueue returns at once, even on a full ring.
+  REQUIRE( r.enqueue_bulk(all) == 4 );
+  REQUIRE( r.enqueue_bulk_wait(std::span<std::uintptr_t *const>{}) == 0 );
+}
+
+TEMPLATE_TEST_CASE("ring.blocking_threads",
+                   "[ring][blocking][threads][template]", blocking_ring,
+                   blocking_rts_ring) {
+  constexpr std::size_t PerProducer = 20000;
+  constexpr std::size_t Producers = 3;
+  TestType r{8};
+  std::vector<std::uintptr_t> values(Producers * PerProducer);
+
+  std::vector<std::thread> producers;
+  for (std::size_t p = 0; p < Producers; ++p) {
+    producers.emplace_back([&, p] {
+      for (std::size_t i = 0; i < PerProducer; i += 4) {
+        std::array<std::uintptr_t *, 4> bulk;
+        for (std::size_t j = 0; j < 4; ++j) {
+          std::uintptr_t &v = values[p * PerProducer + i + j];
+          v = p << 32 | (i + j);
+          bulk[j] = &v;
+        }
+        r.enqueue_bulk_wait(bulk);
+      }
+    });
+  }
+
+  std::vector<std::size_t> next(Producers);
+  bool ok = true;
+  std::array<std::uintptr_t *, 5> burst;
+  for (std::size_t n = 0; n < Producers * PerProducer;) {
+    const std::size_t got = r.dequeue_burst_wait(burst);
+    for (std::size_t i = 0; i < got; ++i) {
+      const std::uintptr_t v = *burst[i];
+      ok &= (v & 0xFFFFFFFF) == next[v >> 32]++;
+    }
+    n += got;
+  }
+
+  for (auto &t : producers)
+    t.join();
+
+  REQUIRE( ok );
+  REQUIRE( r.empty() );
+}
@@ -0,0 +1,142 @@
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/rmlock.h>
+
+using namespace csg;
+
+TEST_CASE("rmlock.basic", "[rmlock][basic]") {
+  rmlock l{"test"};
+  REQUIRE( std::string_view{l.name()} == "test" );
+
+  {
+    std::shared_lock r{l};
+    REQUIRE( l.held_shared() );
+    REQUIRE( !l.held() );
+
+    // Read locks are recursive.
+    std::shared_lock r2{l};
+    const auto readers = l.readers();
+    REQUIRE( readers.size() == 1 );
+    REQUIRE( readers[0].thread == std::this_thread::get_id() );
+    REQUIRE( readers[0].depth == 2 );
+  }
+  REQUIRE( !l.held_shared() );
+  REQUIRE( l.readers().empty() );
+
+  {
+    std::unique_lock w{l};
+    REQUIRE( l.held() );
+    REQUIRE( l.writer() == std::this_thread::get_id() );
+  }
+  REQUIRE( l.writer() == std::thread::id{} );
+  REQUIRE( l.try_lock_shared() );
+  l.unlock_shared();
+}
+
+TEST_CASE("rmlock.exclusion", "[rmlock][exclusion]") {
+  rmlock l;
+  std::atomic<bool> readerIn = false;
+  std::atomic<bool> release = false;
+
+  // A reader in another thread blocks writers, but not other readers.
+  std::thread reader{[&] {
+    std::shared_lock r{l};
+    readerIn = true;
+    while (!release)
+      std::this_thread::yield();
+  }};
+  while (!readerIn)
+    std::this_thread::yield();
+
+  REQUIRE( !l.try_lock() );
+  REQUIRE( l.readers().size() == 1 );
+  REQUIRE( l.readers()[0].thread == reader.get_id() );
+  REQUIRE( l.try_lock_shared() );
+  l.unlock_shared();
+
+  // A writer waits for the reader, and new readers wait for the writer.
+  std::atomic<bool> writerIn = false;
+  std::thread writer{[&] {
+    std::unique_lock w{l};
+    writerIn = true;
+  }};
+  while (l.writer() == std::thread::id{})
+    std::this_thread::yield();
+  REQUIRE( l.writer() == writer.get_id() );
+  REQUIRE( !writerIn );
+  REQUIRE( !l.try_lock_shared() );
+  release = true;
+  reader.join();
+  writer.join();
+  REQUIRE( writerIn );
+  REQUIRE( l.try_lock() );
+  l.unlock();
+}
+
+TEST_CASE("rmlock.threads", "[rmlock][threads]") {
+  constexpr int Readers = 4;
+  constexpr int Writes = 200;
+
+  // The writer keeps the two halves of the record equal; readers must never
+  // see them differ.
+  rmlock l;
+  std::uint64_t a = 0, b = 0;
+  std::atomic<bool> done = false;
+  std::atomic<int> torn = 0;
+  std::atomic<std::uint64_t> reads = 0;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < Readers; ++i) {
+    threads.emplace_back([&] {
+      std::uint64_t n = 0;
+      while (!done) {
+        std::shared_lock r{l};
+        torn += a != b;
+        if (++n % 64 == 0)
+          std::this_thread::yield();
+      }
+      reads += n;
+    });
+  }
+
+  for (int i = 0; i < Writes; ++i) {
+    {
+      std::unique_lock w{l};
+      ++a;
+      std::this_thread::yield();
+      ++b;
+    }
+    std::this_thread::yield();
+  }
+  done = true;
+  for (auto &t : threads)
+    t.join();
+
+  REQUIRE( torn == 0 );
+  REQUIRE( reads > 0 );
+  REQUIRE( a == Writes );
+}
+
+TEST_CASE("rmlock.lifetime", "[rmlock][lifetime]") {
+  // A thread's trackers of destroyed locks are reclaimed, and a new lock
+  // (perhaps at the same address) gets a new tracker.
+  for (int i = 0; i < 100; ++i) {
+    auto l = std::make_unique<rmlock>();
+    std::shared_lock r{*l};
+    REQUIRE( l->held_shared() );
+    REQUIRE( l->readers().size() == 1 );
+  }
+
+  rmlock l;
+  std::thread{[&] { std::shared_lock r{l}; }}.join();
+  REQUIRE( l.readers().empty() );
+  std::unique_lock w{l};
+  REQUIRE( l.held() );
+}
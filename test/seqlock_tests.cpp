@@ -0,0 +1,119 @@
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/seqlock.h>
+
+using namespace csg;
+
+namespace {
+
+// All fields of a record written by the tests are equal, so a torn copy is
+// easy to detect; 13 words, so that it spans two cache lines and ends in a
+// partial word.
+struct record {
+  std::uint64_t fields[12];
+  std::uint32_t tail;
+
+  static record of(std::uint64_t v) noexcept {
+    record r;
+    for (auto &f : r.fields)
+      f = v;
+    r.tail = static_cast<std::uint32_t>(v);
+    return r;
+  }
+
+  bool consistent() const noexcept {
+    for (auto f : fields) {
+      if (f != fields[0])
+        return false;
+    }
+    return tail == static_cast<std::uint32_t>(fields[0]);
+  }
+};
+
+} // End of anonymous namespace
+
+TEST_CASE("seqlock.basic", "[seqlock][basic]") {
+  seqlock<record> s{record::of(1)};
+  REQUIRE( s.sequence() == 0 );
+  REQUIRE( s.load().consistent() );
+  REQUIRE( s.load().fields[0] == 1 );
+
+  s.store(record::of(2));
+  REQUIRE( s.sequence() == 2 );
+  record r;
+  REQUIRE( s.try_load(r) );
+  REQUIRE( r.fields[11] == 2 );
+  REQUIRE( r.tail == 2 );
+
+  s.update([](record &v) { v = record::of(v.fields[0] * 10); });
+  REQUIRE( s.sequence() == 4 );
+  REQUIRE( s.load().fields[5] == 20 );
+
+  // A throwing update stores nothing.
+  REQUIRE_THROWS_AS( s.update([](record &v) {
+                       v.fields[0] = 0;
+                       throw std::runtime_error{"no"};
+                     }),
+                     std::runtime_error );
+  REQUIRE( s.sequence() == 4 );
+  REQUIRE( s.load().consistent() );
+
+  seqlock<std::uint16_t> small;
+  REQUIRE( small.load() == 0 );
+  small.store(7);
+  REQUIRE( small.load() == 7 );
+}
+
+TEST_CASE("seqlock.threads", "[seqlock][threads]") {
+  constexpr int Readers = 4;
+  constexpr int Writers = 2;
+  constexpr int Updates = 5000;
+
+  // Readers must never see a torn record, nor one older than they saw
+  // before; writers serialize their updates, so none is lost.
+  seqlock<record> s{record::of(0)};
+  std::atomic<bool> done = false;
+  std::atomic<int> errors = 0;
+  std::atomic<std::uint64_t> reads = 0;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < Readers; ++i) {
+    threads.emplace_back([&] {
+      std::uint64_t last = 0;
+      std::uint64_t n = 0;
+      while (!done) {
+        const record r = s.load();
+        errors += !r.consistent() || r.fields[0] < last;
+        last = r.fields[0];
+        if (++n % 64 == 0)
+          std::this_thread::yield();
+      }
+      reads += n;
+    });
+  }
+  std::vector<std::thread> writers;
+  for (int i = 0; i < Writers; ++i) {
+    writers.emplace_back([&] {
+      for (int u = 0; u < Updates; ++u) {
+        s.update([](record &v) { v = record::of(v.fields[0] + 1); });
+        if (u % 16 == 0)
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &t : writers)
+    t.join();
+  done = true;
+  for (auto &t : threads)
+    t.join();
+
+  REQUIRE( errors == 0 );
+  REQUIRE( reads > 0 );
+  REQUIRE( s.load().fields[0] == Writers * Updates );
+  REQUIRE( s.sequence() == 2 * Writers * Updates );
+}
@@ -0,0 +1,100 @@
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <csg/core/shm_ring.h>
+
+using namespace csg;
+
+namespace {
+
+struct message {
+  std::uint32_t seq;
+  std::uint32_t sum;
+};
+
+using msg_ring = shm_ring<message, ring_blocking<ring_single>,
+                          ring_blocking<ring_single>>;
+
+std::string unique_name() {
+  return "/csg-shm-ring-test-" + std::to_string(::getpid());
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("shm_ring.mappings", "[shm_ring][mappings]") {
+  auto a = msg_ring::create_anonymous(16);
+  auto b = msg_ring::attach(::dup(a.fd()));
+
+  // The two mappings of the same ring are at different addresses, and
+  // elements enqueued through one are dequeued through the other.
+  REQUIRE( a.capacity() == 16 );
+  REQUIRE( b.capacity() == 16 );
+  for (std::uint32_t i = 0; i < 40; ++i) {
+    REQUIRE( a.enqueue({i, i * 3}) );
+    message m;
+    REQUIRE( b.dequeue(m) );
+    REQUIRE( (m.seq == i && m.sum == i * 3) );
+  }
+  REQUIRE( a.empty() );
+
+  // A moved-from ring no longer owns the mapping.
+  msg_ring c = std::move(a);
+  REQUIRE( a.fd() == -1 );
+  REQUIRE( c.enqueue({1, 2}) );
+  REQUIRE( b.size() == 1 );
+}
+
+TEST_CASE("shm_ring.named", "[shm_ring][named]") {
+  const std::string name = unique_name();
+  auto r = msg_ring::create(name.c_str(), 8);
+
+  // The name is exclusive while it exists.
+  REQUIRE_THROWS_AS( msg_ring::create(name.c_str(), 8), std::system_error );
+
+  auto other = msg_ring::open(name.c_str());
+  REQUIRE( r.enqueue({7, 0}) );
+  REQUIRE( other.size() == 1 );
+
+  // Attaching with a different element type is refused.
+  using wide_ring = shm_ring<std::uint64_t[4], ring_single, ring_single>;
+  REQUIRE_THROWS_AS( wide_ring::open(name.c_str()), std::system_error );
+
+  msg_ring::unlink(name.c_str());
+  REQUIRE_THROWS_AS( msg_ring::open(name.c_str()), std::system_error );
+  REQUIRE( other.size() == 1 );
+}
+
+TEST_CASE("shm_ring.processes", "[shm_ring][processes]") {
+  constexpr std::uint32_t Messages = 50000;
+  auto r = msg_ring::create_anonymous(64);
+
+  const pid_t child = ::fork();
+  REQUIRE( child != -1 );
+  if (!child) {
+    // The child maps the ring again, at a new address, and produces.
+    auto w = msg_ring::attach(::dup(r.fd()));
+    for (std::uint32_t i = 0; i < Messages; ++i)
+      w.enqueue_wait({i, i * 7});
+    ::_exit(0);
+  }
+
+  bool ok = true;
+  for (std::uint32_t i = 0; i < Messages; ++i) {
+    message m;
+    r.dequeue_wait(m);
+    ok &= m.seq == i && m.sum == i * 7;
+  }
+
+  int status;
+  REQUIRE( ::waitpid(child, &status, 0) == child );
+  REQUIRE( WIFEXITED(status) );
+  REQUIRE( WEXITSTATUS(status) == 0 );
+  REQUIRE( ok );
+  REQUIRE( r.empty() );
+}
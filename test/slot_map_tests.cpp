@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <ranges>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/slot_map.h>
+#include <csg/core/tailq.h>
+
+using namespace csg;
+
+static_assert(sizeof(slot_handle32) == 4);
+static_assert(sizeof(slot_handle64) == 8);
+static_assert(slot_handle32::index_bits == 20 &&
+              slot_handle32::generation_bits == 12);
+static_assert(std::random_access_iterator<slot_map<int>::iterator>);
+static_assert(std::random_access_iterator<slot_map<int>::const_iterator>);
+static_assert(std::ranges::random_access_range<const slot_map<int>>);
+
+TEST_CASE("slot_handle.basic", "[slot_map][slot_handle]") {
+  constexpr slot_handle32 null;
+  REQUIRE( !null );
+  REQUIRE( null.raw() == 0 );
+
+  constexpr slot_handle32 h{5, 3};
+  REQUIRE( h );
+  REQUIRE( h.index() == 5 );
+  REQUIRE( h.generation() == 3 );
+  REQUIRE( slot_handle32::from_raw(h.raw()) == h );
+
+  // Generation zero is reserved for the null handle.
+  REQUIRE( slot_handle32::next_generation(slot_handle32::generation_mask) == 1 );
+  REQUIRE( slot_handle32::next_generation(1) == 2 );
+}
+
+TEST_CASE("slot_map.basic", "[slot_map][basic]") {
+  slot_map<std::string> m{4};
+
+  REQUIRE( m.empty() );
+  REQUIRE( m.capacity() == 4 );
+  REQUIRE( m.begin() == m.end() );
+
+  const auto a = m.emplace("a");
+  const auto b = m.insert("b");
+  REQUIRE( a != b );
+  REQUIRE( m.size() == 2 );
+  REQUIRE( m.contains(a) );
+  REQUIRE( *m.get(a) == "a" );
+  REQUIRE( m[b] == "b" );
+  REQUIRE( m.get_handle(m[b]) == b );
+
+  // Addresses are stable across further insertions.
+  const std::string *const pa = m.get(a);
+  const auto c = m.emplace("c");
+  const auto d = m.emplace("d");
+  REQUIRE( m.full() );
+  REQUIRE( !m.emplace("e") );
+  REQUIRE( m.get(a) == pa );
+
+  // A stale handle is detected after its slot is reused.
+  REQUIRE( m.erase(a) );
+  REQUIRE( !m.erase(a) );
+  REQUIRE( !m.contains(a) );
+  REQUIRE( m.get(a) == nullptr );
+
+  const auto e = m.emplace("e");
+  REQUIRE( e );
+  REQUIRE( e.index() == a.index() );
+  REQUIRE( e.generation() != a.generation() );
+  REQUIRE( m.get(a) == nullptr );
+  REQUIRE( m[e] == "e" );
+
+  std::vector<std::string> values{m.begin(), m.end()};
+  std::ranges::sort(values);
+  REQUIRE( values == std::vector<std::string>{ "b", "c", "d", "e" } );
+
+  REQUIRE( !m.contains(slot_handle32{}) );
+  REQUIRE( !m.contains(slot_handle32{100, 1}) );
+
+  m.clear();
+  REQUIRE( m.empty() );
+  REQUIRE( !m.contains(b) );
+  REQUIRE( !m.contains(c) );
+  REQUIRE( !m.contains(d) );
+}
+
+TEST_CASE("slot_map.fifo_reuse", "[slot_map][free_list]") {
+  // Free slots are reused in FIFO order, so a slot is not reused until every
+  // other free slot has been.
+  slot_map<int, slot_handle64> m{3};
+  const auto h0 = m.emplace(0);
+  REQUIRE( m.erase(h0) );
+
+  const auto h1 = m.emplace(1);
+  const auto h2 = m.emplace(2);
+  const auto h3 = m.emplace(3);
+  REQUIRE( h1.index() == 1 );
+  REQUIRE( h2.index() == 2 );
+  REQUIRE( h3.index() == 0 );
+  REQUIRE( h3.generation() == h0.generation() + 1 );
+}
+
+TEST_CASE("slot_map.iterate_erase", "[slot_map][iterator]") {
+  slot_map<int> m{100};
+  std::vector<slot_handle32> handles;
+
+  for (int i = 0; i < 100; ++i)
+    handles.push_back(m.emplace(i));
+
+  for (auto i = m.begin(); i != m.end(); ) {
+    REQUIRE( m.get(i.handle()) == std::addressof(*i) );
+    if (*i % 3 == 0)
+      i = m.erase(i);
+    else
+      ++i;
+  }
+
+  REQUIRE( m.size() == 66 );
+  REQUIRE( std::ranges::none_of(m, [](int i) { return i % 3 == 0; }) );
+
+  for (int i = 0; i < 100; ++i)
+    REQUIRE( m.contains(handles[i]) == (i % 3 != 0) );
+}
+
+namespace {
+
+struct list_node {
+  int value;
+  tailq_entry<list_node> link;
+};
+
+struct destroy_counter {
+  explicit destroy_counter(int &n) noexcept : count{&n} {}
+  ~destroy_counter() { ++*count; }
+  int *count;
+};
+
+} // End of anonymous namespace
+
+TEST_CASE("slot_map.intrusive", "[slot_map][intrusive]") {
+  // Objects in a slot map can be linked onto intrusive lists, because they
+  // never move.
+  slot_map<list_node> m{8};
+  CSG_TAILQ_HEAD_OFFSET_T(list_node, link) q;
+
+  for (int i = 0; i < 8; ++i)
+    q.push_back(m.get(m.emplace(i, tailq_entry<list_node>{})));
+
+  int expected = 0;
+  for (const list_node &n : q)
+    REQUIRE( n.value == expected++ );
+
+  const auto h = m.get_handle(q.front());
+  q.pop_front();
+  REQUIRE( m.erase(h) );
+  REQUIRE( q.front().value == 1 );
+  q.clear();
+}
+
+TEST_CASE("slot_map.destroy", "[slot_map][lifetime]") {
+  int destroyed = 0;
+  {
+    slot_map<destroy_counter> m{4};
+    const auto h = m.emplace(destroyed);
+    m.emplace(destroyed);
+    m.emplace(destroyed);
+    m.erase(h);
+    REQUIRE( destroyed == 1 );
+
+    slot_map<destroy_counter> m2{std::move(m)};
+    REQUIRE( m.empty() );
+    REQUIRE( m2.size() == 2 );
+  }
+  REQUIRE( destroyed == 3 );
+}
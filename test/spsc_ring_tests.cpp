@@ -0,0 +1,188 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/spsc_ring.h>
+
+using namespace csg;
+
+TEST_CASE("spsc_ring.basic", "[spsc_ring][basic]") {
+  spsc_ring<std::string> r{4};
+  std::string s;
+
+  REQUIRE( r.capacity() == 4 );
+  REQUIRE( r.empty() );
+  REQUIRE( !r.pop(s) );
+
+  REQUIRE( r.push("a") );
+  REQUIRE( r.push(std::string{"b"}) );
+  REQUIRE( r.push("c") );
+  REQUIRE( r.push("d") );
+  REQUIRE( !r.push("e") );
+  REQUIRE( r.size() == 4 );
+
+  REQUIRE( r.pop(s) );
+  REQUIRE( s == "a" );
+  REQUIRE( r.push("e") );
+
+  for (const char *expected : {"b", "c", "d", "e"}) {
+    REQUIRE( r.pop(s) );
+    REQUIRE( s == expected );
+  }
+  REQUIRE( !r.pop(s) );
+}
+
+TEST_CASE("spsc_ring.move_only", "[spsc_ring][basic]") {
+  spsc_ring<std::unique_ptr<int>> r{2};
+  std::unique_ptr<int> p;
+
+  REQUIRE( r.push(std::make_unique<int>(42)) );
+  REQUIRE( r.pop(p) );
+  REQUIRE( *p == 42 );
+}
+
+TEST_CASE("spsc_ring.burst", "[spsc_ring][burst]") {
+  spsc_ring<int> r{8};
+  const std::array<int, 10> in = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  std::array<int, 10> out = {};
+
+  REQUIRE( r.push_burst(std::span{in}.first(5)) == 5 );
+  REQUIRE( r.pop_burst(std::span{out}.first(3)) == 3 );
+
+  // Wraps around the end of the slots.
+  REQUIRE( r.push_burst(std::span{in}.subspan(5)) == 5 );
+  REQUIRE( r.push_burst(std::span{in}) == 1 );
+  REQUIRE( r.pop_burst(out) == 8 );
+
+  const std::array<int, 8> expected = {3, 4, 5, 6, 7, 8, 9, 0};
+  REQUIRE( std::equal(expected.begin(), expected.end(), out.begin()) );
+}
+
+TEST_CASE("spsc_ring.batch", "[spsc_ring][batch]") {
+  spsc_ring<int> r{8, 4};
+  int v;
+
+  REQUIRE( r.publish_batch() == 4 );
+
+  // Pushes are not visible until a batch completes, or is flushed.
+  for (int i = 0; i < 3; ++i)
+    REQUIRE( r.push(i) );
+  REQUIRE( r.size() == 0 );
+  REQUIRE( !r.pop(v) );
+
+  REQUIRE( r.push(3) );
+  REQUIRE( r.size() == 4 );
+
+  REQUIRE( r.push(4) );
+  r.flush_pushes();
+  REQUIRE( r.size() == 5 );
+
+  // Likewise, pops only free their slots for the producer in batches.
+  REQUIRE( r.pop(v) );
+  REQUIRE( v == 0 );
+  REQUIRE( r.size() == 5 );
+  r.flush_pops();
+  REQUIRE( r.size() == 4 );
+
+  for (int i = 1; i <= 4; ++i) {
+    REQUIRE( r.pop(v) );
+    REQUIRE( v == i );
+  }
+}
+
+TEST_CASE("spsc_ring.batch_full", "[spsc_ring][batch]") {
+  spsc_ring<int> r{8, 3};
+  int v;
+
+  // Batches complete after pushes 3 and 6, leaving 6 and 7 unpublished. A
+  // push which finds the ring full publishes them, so that the consumer can
+  // make progress.
+  for (int i = 0; i < 8; ++i)
+    REQUIRE( r.push(i) );
+  REQUIRE( r.size() == 6 );
+  REQUIRE( !r.push(8) );
+  REQUIRE( r.size() == 8 );
+
+  // Similarly, a pop which finds the ring empty publishes the pending pops.
+  for (int i = 0; i < 8; ++i) {
+    REQUIRE( r.pop(v) );
+    REQUIRE( v == i );
+  }
+  REQUIRE( r.size() == 2 );
+  REQUIRE( !r.pop(v) );
+  REQUIRE( r.size() == 0 );
+}
+
+TEST_CASE("spsc_ring.threads", "[spsc_ring][threads]") {
+  constexpr std::uint64_t Count = 200000;
+
+  for (const std::size_t batch : {1, 16}) {
+    spsc_ring<std::uint64_t> r{64, batch};
+
+    std::thread producer{[&r] {
+      for (std::uint64_t i = 0; i < Count;) {
+        if (r.push(i))
+          ++i;
+        else
+          std::this_thread::yield();
+      }
+      r.flush_pushes();
+    }};
+
+    bool ordered = true;
+    for (std::uint64_t expected = 0; expected < Count;) {
+      std::uint64_t v;
+      if (r.pop(v))
+        ordered &= v == expected++;
+      else
+        std::this_thread::yield();
+    }
+
+    producer.join();
+    REQUIRE( ordered );
+  }
+}
+
+TEST_CASE("spsc_ring.zero_copy", "[spsc_ring][zero_copy]") {
+  struct frame {
+    std::size_t length = 0;
+    std::array<char, 256> data;
+  };
+
+  spsc_ring<frame> r{4};
+
+  auto region = r.reserve(3);
+  REQUIRE( region.size() == 3 );
+  for (std::size_t i = 0; i < region.size(); ++i)
+    region[i].length = i;
+  r.commit(3);
+
+  auto peeked = r.peek(2);
+  REQUIRE( peeked.size() == 2 );
+  REQUIRE( peeked[1].length == 1 );
+  r.release(2);
+
+  // Three free slots: one at the end, two wrapped around to the start.
+  region = r.reserve(4);
+  REQUIRE( region.size() == 3 );
+  REQUIRE( region.first.size() == 1 );
+  REQUIRE( region.second.size() == 2 );
+  for (std::size_t i = 0; i < region.size(); ++i)
+    region[i].length = 10 + i;
+  r.commit(3);
+
+  peeked = r.peek(4);
+  REQUIRE( peeked.size() == 4 );
+  REQUIRE( peeked[0].length == 2 );
+  for (std::size_t i = 1; i < 4; ++i)
+    REQUIRE( peeked[i].length == 9 + i );
+  r.release(4);
+  REQUIRE( r.empty() );
+}
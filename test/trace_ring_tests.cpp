@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+#include <csg/core/trace_ring.h>
+
+using namespace csg;
+
+namespace {
+
+enum class color : std::uint8_t { red = 3 };
+
+std::string message(const trace_entry &e) {
+  char buf[256];
+  const std::size_t n = format_trace_message(e, buf, sizeof buf);
+  return std::string(buf, n);
+}
+
+// The entries recorded by the calling thread, oldest first.
+std::vector<trace_entry> own_entries() {
+  const std::uint32_t self = detail::trace_thread_ring.ring->thread;
+  std::vector<trace_entry> all = trace_snapshot();
+  std::erase_if(all, [self](const trace_entry &e) {
+    return e.thread != self;
+  });
+  return all;
+}
+
+} // End of anonymous namespace
+
+TEST_CASE("trace_ring.format", "[trace_ring][format]") {
+  CSG_TRACE("plain");
+  CSG_TRACE("%d %u %lx %5.2f", -7, 42u, 0xbeefUL, 2.5);
+  CSG_TRACE("%s/%c %zu%% %d", "name", 'x', std::size_t{9}, color::red);
+
+  const auto entries = own_entries();
+  REQUIRE( entries.size() >= 3 );
+  const trace_entry *const last = &entries.back();
+
+  REQUIRE( message(last[-2]) == "plain" );
+  REQUIRE( message(last[-1]) == "-7 42 beef  2.50" );
+  REQUIRE( message(last[0]) == "name/x 9% 3" );
+  REQUIRE( std::strstr(last[0].file, "trace_ring_tests.cpp") );
+
+  // A truncated message is still terminated.
+  char small[6];
+  REQUIRE( format_trace_message(last[-1], small, sizeof small) == 5 );
+  REQUIRE( std::string{small} == "-7 42" );
+}
+
+TEST_CASE("trace_ring.overwrite", "[trace_ring][overwrite]") {
+  constexpr std::size_t Capacity = detail::trace_ring_buffer::capacity;
+
+  for (std::size_t i = 0; i < 3 * Capacity + 5; ++i)
+    CSG_TRACE("event %zu", i);
+
+  // Only the newest `Capacity` events are kept, in order.
+  const auto entries = own_entries();
+  REQUIRE( entries.size() == Capacity );
+  for (std::size_t i = 0; i < Capacity; ++i)
+    REQUIRE( entries[i].args[0] == 2 * Capacity + 5 + i );
+}
+
+TEST_CASE("trace_ring.threads", "[trace_ring][threads]") {
+  constexpr int PerThread = 200;
+  constexpr int Threads = 4;
+
+  const auto before = trace_snapshot().size();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < Threads; ++t) {
+    threads.emplace_back([t] {
+      for (int i = 0; i < PerThread; ++i) {
+        CSG_TRACE("worker %d step %d", t, i);
+        if (i % 16 == 0)
+          std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &t : threads)
+    t.join();
+
+  // The rings of exited threads are kept for the dump, and merged with the
+  // others in timestamp order.
+  const auto entries = trace_snapshot();
+  REQUIRE( entries.size() >= before + Threads * PerThread );
+  REQUIRE( std::is_sorted(entries.begin(), entries.end(),
+                          [](const trace_entry &a, const trace_entry &b) {
+                            return a.timestamp < b.timestamp;
+                          }) );
+
+  std::vector<std::int64_t> next(Threads, 0);
+  for (const trace_entry &e : entries) {
+    if (std::strcmp(e.format, "worker %d step %d") != 0)
+      continue;
+    REQUIRE( e.args[1] == static_cast<std::uint64_t>(next[e.args[0]]) );
+    ++next[e.args[0]];
+  }
+  REQUIRE( std::all_of(next.begin(), next.end(),
+                       [](std::int64_t n) { return n == PerThread; }) );
+
+  // A new thread reuses the ring of an exited one, rather than adding one.
+  const auto rings = detail::trace_registry_instance.ringCount.load();
+  std::thread{[] { CSG_TRACE("reuse"); }}.join();
+  REQUIRE( detail::trace_registry_instance.ringCount.load() == rings );
+}
+
+TEST_CASE("trace_ring.dump", "[trace_ring][dump]") {
+  const std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{std::tmpfile(),
+                                                           &std::fclose};
+  REQUIRE( f );
+
+  CSG_TRACE("dump marker %d", 12345);
+  const std::size_t n = trace_dump(fileno(f.get()));
+  REQUIRE( n == trace_snapshot().size() );
+
+  std::rewind(f.get());
+  std::size_t lines = 0;
+  bool found = false;
+  char line[1024];
+  while (std::fgets(line, sizeof line, f.get())) {
+    ++lines;
+    found |= std::strstr(line, "trace_ring_tests.cpp") &&
+             std::strstr(line, ": dump marker 12345\n");
+  }
+  REQUIRE( lines == n );
+  REQUIRE( found );
+}
@@ -5,6 +5,7 @@ import enum
 import gdb
 import gdb.xmethod
 import re
+import struct
 
 _csd_printer_name = 'csd_pretty_printer'
 _csd_xmethod_name = 'csd_xmethods'
@@ -196,6 +197,75 @@ class CSDPrettyPrinter:
     printer = self.lookup.get(baseName, None)
     return printer(value) if printer else None
 
+_traceConversion = re.compile(r'%([-+ #0-9.]*)[hljztL]*([a-zA-Z%])')
+
+def _format_trace_message(fmt, args):
+  """Format a csg::trace_entry message the way format_trace_message does,
+  reading `%s` arguments from the inferior."""
+  argIter = iter(args)
+
+  def convert(match):
+    flags, conv = match.groups()
+    if conv == '%':
+      return '%'
+    arg = next(argIter, 0)
+    if conv in 'di':
+      arg = arg - (1 << 64) if arg >= 1 << 63 else arg
+      return f'%{flags}d' % arg
+    if conv in 'ouxX':
+      return f'%{flags}{conv}' % arg
+    if conv in 'fFeEgGaA':
+      value = struct.unpack('<d', struct.pack('<Q', arg))[0]
+      return f'%{flags}{"e" if conv in "aA" else conv}' % value
+    if conv == 'c':
+      return f'%{flags}c' % chr(arg & 0xff)
+    if conv == 's':
+      if not arg:
+        return '(null)'
+      charPtr = gdb.lookup_type('char').const().pointer()
+      return f'%{flags}s' % gdb.Value(arg).cast(charPtr).string()
+    return f'{arg:#x}'
+
+  return _traceConversion.sub(convert, fmt)
+
+class TraceDumpCommand(gdb.Command):
+  """Print the csg::trace events of all threads, merged in timestamp order.
+
+Usage: csd-trace [COUNT]
+Print the most recent COUNT events, or all retained events if omitted."""
+
+  def __init__(self):
+    super().__init__('csd-trace', gdb.COMMAND_DATA)
+
+  def invoke(self, arg, from_tty):
+    limit = int(gdb.parse_and_eval(arg)) if arg.strip() else None
+    registry = gdb.parse_and_eval('csg::detail::trace_registry_instance')
+    ringCount = int(registry['ringCount']['_M_i'])
+    rings = registry['rings']
+    maxRings = rings.type.range()[1] + 1
+
+    entries = []
+    for i in range(min(ringCount, maxRings)):
+      ring = rings[i]['_M_b']['_M_p']
+      if not int(ring):
+        continue
+      ring = ring.dereference()
+      head = int(ring['head']['_M_i'])
+      capacity = ring['entries'].type.range()[1] + 1
+      for seq in range(max(0, head - capacity), head):
+        entries.append(ring['entries'][seq % capacity])
+
+    entries.sort(key=lambda e: int(e['timestamp']))
+    if limit is not None:
+      entries = entries[-limit:] if limit else []
+
+    for e in entries:
+      args = [int(a) for a in
+              (e['args'][i] for i in range(e['args'].type.range()[1] + 1))]
+      message = _format_trace_message(e['format'].string(), args)
+      gdb.write(f"{int(e['timestamp']):20} {int(e['thread']):4} "
+                f"{e['file'].string()}:{int(e['line'])}: {message}\n")
+
 def _register_csd_printers(event):
   progspace = event.new_objfile.progspace
 
@@ -216,6 +286,8 @@ def _unregister_csd_printers(event):
         break
 
 def register_csd_pretty_printers():
-  """Register event handlers to load csd pretty-printers."""
+  """Register event handlers to load csd pretty-printers, and the csd-trace
+  command."""
   gdb.events.new_objfile.connect(_register_csd_printers)
   gdb.events.clear_objfiles.connect(_unregister_csd_printers)
+  TraceDumpCommand()